@@ -0,0 +1,530 @@
+#include "fuse_ll_ops.hpp"
+#include "../in_memory/directory_table.hpp"
+#include "../in_memory/node_table.hpp"
+#include "../meta/file_handler.hpp"
+#include "../../lib/logger/logger.hpp"
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+extern std::unique_ptr<directory_table> indexing_table;
+extern std::unique_ptr<file_handler_list> open_context;
+extern std::unique_ptr<node_table> nodes;
+extern struct mount_options nmfs_options;
+
+/* What libfuse gives as the inode number of a name listed without its attributes */
+#define LL_UNKNOWN_INO 0xffffffff
+
+static struct fuse_session *session;
+
+/* op replies by itself and returns 0, or returns the error to reply */
+static void serve(fuse_req_t req, const std::function<int(void)> &op) {
+	int ret;
+	try {
+		ret = op();
+	} catch (inode::no_entry &e) {
+		ret = -ENOENT;
+	} catch (inode::not_directory &e) {
+		ret = -ENOTDIR;
+	} catch (inode::permission_denied &e) {
+		ret = -EACCES;
+	}
+
+	if (ret != 0)
+		fuse_reply_err(req, -ret);
+}
+
+/* The error op returns is replied, 0 included */
+static void serve_status(fuse_req_t req, const std::function<int(void)> &op) {
+	serve(req, [&]() {
+		int ret = op();
+		if (ret == 0)
+			fuse_reply_err(req, 0);
+		return ret;
+	});
+}
+
+/* The inode nodeid stands for, the one of the handler when the request comes with it */
+static shared_ptr<inode> node_inode(fuse_ino_t nodeid, struct fuse_file_info *file_info = nullptr) {
+	if (file_info != nullptr)
+		return open_context->get_file_handler(file_info->fh)->get_open_inode_info();
+
+	node_table::node n;
+	if (!nodes->get(nodeid, n))
+		throw inode::no_entry("No such node: in node_inode");
+	if (nodeid != FUSE_ROOT_ID && n.name.empty())
+		throw inode::no_entry("The name of the node has been removed: in node_inode");
+
+	return indexing_table->get_inode(n.parent_ino, n.name, n.ino, n.mode);
+}
+
+/* How long the kernel keeps the names of a directory or the attributes of an inode, which are at loc */
+static double kernel_ttl(uint64_t loc) {
+	unsigned int ms = nmfs_options.kernel_ttl_ms;
+	if (loc == REMOTE)
+		ms = std::min(ms, nmfs_options.attr_ttl_ms);
+	return ms / 1000.0;
+}
+
+/* Replies the entry of name, the kernel takes a reference on its node. file_info : the handler of a create */
+static int reply_entry(fuse_req_t req, shared_ptr<inode> parent_i, const std::string &name, struct fuse_file_info *file_info = nullptr) {
+	mode_t mode;
+	shared_ptr<inode> i = indexing_table->try_lookup(parent_i->get_ino(), name, mode);
+	if (i == nullptr)
+		return -ENOENT;
+
+	struct fuse_entry_param e{};
+	int ret = fuse_ops::getattr(i, &e.attr);
+	if (ret != 0)
+		return ret;
+
+	e.ino = nodes->add(i->get_ino(), parent_i->get_ino(), name, mode);
+	e.attr_timeout = kernel_ttl(i->get_loc());
+	e.entry_timeout = kernel_ttl(indexing_table->get_dentry_table(parent_i->get_ino())->get_loc());
+
+	/* The kernel didn't get the reference if the request was interrupted */
+	if (file_info != nullptr) {
+		if (fuse_reply_create(req, &e, file_info) != 0) {
+			nodes->forget(e.ino, 1);
+			fuse_ops::release(file_info);
+		}
+	} else if (fuse_reply_entry(req, &e) != 0) {
+		nodes->forget(e.ino, 1);
+	}
+	return 0;
+}
+
+static void init(void *userdata, struct fuse_conn_info *conn) {
+	/* What this client creates is owned by whoever mounted it */
+	fuse_ops::init(std::string(static_cast<const char *>(userdata)), getuid(), getgid(), conn, session);
+}
+
+static void destroy(void *userdata) {
+	fuse_ops::destroy();
+}
+
+static void lookup(fuse_req_t req, fuse_ino_t parent, const char *name) {
+	serve(req, [&]() {
+		return reply_entry(req, node_inode(parent), name);
+	});
+}
+
+static void forget(fuse_req_t req, fuse_ino_t ino, uint64_t nlookup) {
+	nodes->forget(ino, nlookup);
+	fuse_reply_none(req);
+}
+
+static void forget_multi(fuse_req_t req, size_t count, struct fuse_forget_data *forgets) {
+	for (size_t n = 0; n < count; n++)
+		nodes->forget(forgets[n].ino, forgets[n].nlookup);
+	fuse_reply_none(req);
+}
+
+static void getattr(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *file_info) {
+	serve(req, [&]() {
+		shared_ptr<inode> i = node_inode(ino, file_info);
+		struct stat st{};
+		int ret = fuse_ops::getattr(i, &st);
+		if (ret != 0)
+			return ret;
+
+		fuse_reply_attr(req, &st, kernel_ttl(i->get_loc()));
+		return 0;
+	});
+}
+
+static void setattr(fuse_req_t req, fuse_ino_t ino, struct stat *attr, int to_set, struct fuse_file_info *file_info) {
+	serve(req, [&]() {
+		shared_ptr<inode> i = node_inode(ino, file_info);
+		int ret = 0;
+
+		if (to_set & FUSE_SET_ATTR_MODE)
+			ret = fuse_ops::chmod(i, attr->st_mode);
+		if (ret == 0 && (to_set & (FUSE_SET_ATTR_UID | FUSE_SET_ATTR_GID)))
+			ret = fuse_ops::chown(i, (to_set & FUSE_SET_ATTR_UID) ? attr->st_uid : (uid_t) -1,
+					      (to_set & FUSE_SET_ATTR_GID) ? attr->st_gid : (gid_t) -1);
+		if (ret == 0 && (to_set & FUSE_SET_ATTR_SIZE))
+			ret = fuse_ops::truncate(i, attr->st_size);
+		if (ret == 0 && (to_set & (FUSE_SET_ATTR_ATIME | FUSE_SET_ATTR_MTIME | FUSE_SET_ATTR_ATIME_NOW | FUSE_SET_ATTR_MTIME_NOW))) {
+			struct timespec tv[2];
+			tv[0] = (to_set & FUSE_SET_ATTR_ATIME_NOW) ? timespec{0, UTIME_NOW} :
+				(to_set & FUSE_SET_ATTR_ATIME) ? attr->st_atim : timespec{0, UTIME_OMIT};
+			tv[1] = (to_set & FUSE_SET_ATTR_MTIME_NOW) ? timespec{0, UTIME_NOW} :
+				(to_set & FUSE_SET_ATTR_MTIME) ? attr->st_mtim : timespec{0, UTIME_OMIT};
+			ret = fuse_ops::utimens(i, tv);
+		}
+		if (ret != 0)
+			return ret;
+
+		struct stat st{};
+		ret = fuse_ops::getattr(i, &st);
+		if (ret != 0)
+			return ret;
+
+		fuse_reply_attr(req, &st, kernel_ttl(i->get_loc()));
+		return 0;
+	});
+}
+
+static void readlink(fuse_req_t req, fuse_ino_t ino) {
+	serve(req, [&]() {
+		char buf[PATH_MAX + 1];
+		int ret = fuse_ops::readlink(node_inode(ino), buf, sizeof(buf));
+		if (ret != 0)
+			return ret;
+
+		fuse_reply_readlink(req, buf);
+		return 0;
+	});
+}
+
+static void mkdir(fuse_req_t req, fuse_ino_t parent, const char *name, mode_t mode) {
+	serve(req, [&]() {
+		shared_ptr<inode> parent_i = node_inode(parent);
+		int ret = fuse_ops::mkdir(parent_i, name, mode);
+		if (ret != 0)
+			return ret;
+
+		return reply_entry(req, parent_i, name);
+	});
+}
+
+static void unlink(fuse_req_t req, fuse_ino_t parent, const char *name) {
+	serve_status(req, [&]() {
+		shared_ptr<inode> parent_i = node_inode(parent);
+		mode_t mode;
+		shared_ptr<inode> target_i = indexing_table->try_lookup(parent_i->get_ino(), name, mode);
+		if (target_i == nullptr)
+			return -ENOENT;
+
+		int ret = fuse_ops::unlink(parent_i, name);
+		if (ret == 0)
+			nodes->detach(target_i->get_ino());
+		return ret;
+	});
+}
+
+static void rmdir(fuse_req_t req, fuse_ino_t parent, const char *name) {
+	serve_status(req, [&]() {
+		shared_ptr<inode> parent_i = node_inode(parent);
+		mode_t mode;
+		shared_ptr<inode> target_i = indexing_table->try_lookup(parent_i->get_ino(), name, mode);
+		if (target_i == nullptr)
+			return -ENOENT;
+
+		int ret = fuse_ops::rmdir(parent_i, name);
+		if (ret == 0)
+			nodes->detach(target_i->get_ino());
+		return ret;
+	});
+}
+
+static void symlink(fuse_req_t req, const char *link, fuse_ino_t parent, const char *name) {
+	serve(req, [&]() {
+		shared_ptr<inode> parent_i = node_inode(parent);
+		int ret = fuse_ops::symlink(link, parent_i, name);
+		if (ret != 0)
+			return ret;
+
+		return reply_entry(req, parent_i, name);
+	});
+}
+
+static void rename(fuse_req_t req, fuse_ino_t parent, const char *name, fuse_ino_t newparent, const char *newname,
+		   unsigned int flags) {
+	serve_status(req, [&]() {
+		shared_ptr<inode> src_parent_i = node_inode(parent);
+		shared_ptr<inode> dst_parent_i = node_inode(newparent);
+
+		mode_t mode;
+		shared_ptr<inode> target_i = indexing_table->try_lookup(src_parent_i->get_ino(), name, mode);
+		if (target_i == nullptr)
+			return -ENOENT;
+		shared_ptr<inode> replaced_i = indexing_table->try_lookup(dst_parent_i->get_ino(), newname, mode);
+
+		int ret = fuse_ops::rename(src_parent_i, name, dst_parent_i, newname, flags);
+		if (ret != 0)
+			return ret;
+
+		if (replaced_i != nullptr && replaced_i->get_ino() != target_i->get_ino())
+			nodes->detach(replaced_i->get_ino());
+		nodes->move(target_i->get_ino(), dst_parent_i->get_ino(), newname);
+		return 0;
+	});
+}
+
+static void open(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *file_info) {
+	serve(req, [&]() {
+		int ret = fuse_ops::open(node_inode(ino), file_info);
+		if (ret != 0)
+			return ret;
+
+		/* release() doesn't come for an open the kernel didn't get */
+		if (fuse_reply_open(req, file_info) != 0)
+			fuse_ops::release(file_info);
+		return 0;
+	});
+}
+
+static void read(fuse_req_t req, fuse_ino_t ino, size_t size, off_t offset, struct fuse_file_info *file_info) {
+	serve(req, [&]() {
+		struct fuse_bufvec *bufv = nullptr;
+		int ret = fuse_ops::read_buf(&bufv, size, offset, file_info);
+		if (ret != 0)
+			return ret;
+
+		fuse_reply_data(req, bufv, FUSE_BUF_SPLICE_MOVE);
+		for (size_t n = 0; n < bufv->count; n++)
+			free(bufv->buf[n].mem);
+		free(bufv);
+		return 0;
+	});
+}
+
+static void write_buf(fuse_req_t req, fuse_ino_t ino, struct fuse_bufvec *bufv, off_t offset, struct fuse_file_info *file_info) {
+	serve(req, [&]() {
+		int ret = fuse_ops::write_buf(bufv, offset, file_info);
+		if (ret < 0)
+			return ret;
+
+		fuse_reply_write(req, ret);
+		return 0;
+	});
+}
+
+static void flush(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *file_info) {
+	serve_status(req, [&]() {
+		return fuse_ops::flush(file_info);
+	});
+}
+
+static void release(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *file_info) {
+	serve_status(req, [&]() {
+		return fuse_ops::release(file_info);
+	});
+}
+
+static void fsync(fuse_req_t req, fuse_ino_t ino, int datasync, struct fuse_file_info *file_info) {
+	serve_status(req, [&]() {
+		return fuse_ops::fsync(datasync, file_info);
+	});
+}
+
+static void opendir(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *file_info) {
+	serve(req, [&]() {
+		int ret = fuse_ops::opendir(node_inode(ino), file_info);
+		if (ret != 0)
+			return ret;
+
+		if (fuse_reply_open(req, file_info) != 0)
+			fuse_ops::releasedir(file_info);
+		return 0;
+	});
+}
+
+/* The reply of readdir() being filled */
+struct dir_buffer {
+	fuse_req_t req;
+	std::vector<char> buf;
+	size_t used;
+
+	/* readdirplus : the directory, how long the kernel keeps its names and the nodes given to the kernel */
+	uuid dir_ino;
+	double entry_ttl;
+	std::vector<fuse_ino_t> added;
+};
+
+static int fill_dir(void *buffer, const char *name, const struct stat *stbuf, off_t off, const uuid *ino) {
+	dir_buffer *b = static_cast<dir_buffer *>(buffer);
+
+	/* Only the inode number and the type go to the kernel */
+	struct stat st{};
+	if (stbuf != nullptr)
+		st = *stbuf;
+	else
+		st.st_ino = LL_UNKNOWN_INO;
+
+	size_t len = fuse_add_direntry(b->req, b->buf.data() + b->used, b->buf.size() - b->used, name, &st, off);
+	if (len > b->buf.size() - b->used)
+		return 1;
+
+	b->used += len;
+	return 0;
+}
+
+static int fill_dir_plus(void *buffer, const char *name, const struct stat *stbuf, off_t off, const uuid *ino) {
+	dir_buffer *b = static_cast<dir_buffer *>(buffer);
+
+	/* A name without a node is looked up by the kernel when it is used */
+	struct fuse_entry_param e{};
+	if (stbuf != nullptr)
+		e.attr = *stbuf;
+	else
+		e.attr.st_ino = LL_UNKNOWN_INO;
+
+	/* The kernel takes no reference on "." and "..", so they never get a node */
+	bool dot = std::strcmp(name, ".") == 0 || std::strcmp(name, "..") == 0;
+	if (ino != nullptr && !dot) {
+		e.ino = nodes->add(*ino, b->dir_ino, name, stbuf->st_mode);
+		e.entry_timeout = b->entry_ttl;
+		/* a directory may be led by another client than its parent */
+		e.attr_timeout = S_ISDIR(stbuf->st_mode) ? kernel_ttl(REMOTE) : b->entry_ttl;
+	}
+
+	size_t len = fuse_add_direntry_plus(b->req, b->buf.data() + b->used, b->buf.size() - b->used, name, &e, off);
+	if (len > b->buf.size() - b->used) {
+		if (e.ino != 0)
+			nodes->forget(e.ino, 1);
+		return 1;
+	}
+
+	if (e.ino != 0)
+		b->added.push_back(e.ino);
+	b->used += len;
+	return 0;
+}
+
+static void readdir(fuse_req_t req, fuse_ino_t ino, size_t size, off_t offset, struct fuse_file_info *file_info) {
+	serve(req, [&]() {
+		dir_buffer b{req, std::vector<char>(size), 0};
+		int ret = fuse_ops::readdir(node_inode(ino, file_info), &b, fill_dir, offset, false);
+		if (ret != 0)
+			return ret;
+
+		fuse_reply_buf(req, b.buf.data(), b.used);
+		return 0;
+	});
+}
+
+/* Lists the names with their attributes, each one listed with a node counts as a lookup of it */
+static void readdirplus(fuse_req_t req, fuse_ino_t ino, size_t size, off_t offset, struct fuse_file_info *file_info) {
+	serve(req, [&]() {
+		shared_ptr<inode> dir_i = node_inode(ino, file_info);
+		dir_buffer b{req, std::vector<char>(size), 0, dir_i->get_ino(),
+			     kernel_ttl(indexing_table->get_dentry_table(dir_i->get_ino())->get_loc())};
+
+		/* The kernel didn't get the references if the listing failed or the request was interrupted */
+		int ret;
+		bool replied = false;
+		try {
+			ret = fuse_ops::readdir(dir_i, &b, fill_dir_plus, offset, true);
+			if (ret == 0)
+				replied = fuse_reply_buf(req, b.buf.data(), b.used) == 0;
+		} catch (...) {
+			for (fuse_ino_t added : b.added)
+				nodes->forget(added, 1);
+			throw;
+		}
+		if (!replied)
+			for (fuse_ino_t added : b.added)
+				nodes->forget(added, 1);
+		return ret;
+	});
+}
+
+static void releasedir(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *file_info) {
+	serve_status(req, [&]() {
+		return fuse_ops::releasedir(file_info);
+	});
+}
+
+static void access(fuse_req_t req, fuse_ino_t ino, int mask) {
+	serve_status(req, [&]() {
+		return fuse_ops::access(node_inode(ino), mask);
+	});
+}
+
+static void create(fuse_req_t req, fuse_ino_t parent, const char *name, mode_t mode, struct fuse_file_info *file_info) {
+	serve(req, [&]() {
+		shared_ptr<inode> parent_i = node_inode(parent);
+		int ret = fuse_ops::create(parent_i, name, mode, file_info);
+		if (ret != 0)
+			return ret;
+
+		ret = reply_entry(req, parent_i, name, file_info);
+		if (ret != 0)
+			fuse_ops::release(file_info);
+		return ret;
+	});
+}
+
+static void fallocate(fuse_req_t req, fuse_ino_t ino, int mode, off_t offset, off_t length, struct fuse_file_info *file_info) {
+	serve_status(req, [&]() {
+		return fuse_ops::fallocate(node_inode(ino, file_info), mode, offset, length);
+	});
+}
+
+fuse_lowlevel_ops fuse_ll_ops::get_fuse_ll_ops(void) {
+	fuse_lowlevel_ops ops;
+	memset(&ops, 0, sizeof(fuse_lowlevel_ops));
+
+	ops.init = init;
+	ops.destroy = destroy;
+	ops.lookup = lookup;
+	ops.forget = forget;
+	ops.forget_multi = forget_multi;
+	ops.getattr = getattr;
+	ops.setattr = setattr;
+	ops.access = access;
+	ops.symlink = symlink;
+	ops.readlink = readlink;
+
+	ops.opendir = opendir;
+	ops.releasedir = releasedir;
+
+	ops.readdir = readdir;
+	ops.readdirplus = readdirplus;
+	ops.mkdir = mkdir;
+	ops.rmdir = rmdir;
+	ops.rename = rename;
+
+	ops.open = open;
+	ops.release = release;
+
+	ops.create = create;
+	ops.unlink = unlink;
+
+	ops.read = read;
+	ops.write_buf = write_buf;
+	ops.flush = flush;
+	ops.fsync = fsync;
+
+	ops.fallocate = fallocate;
+	return ops;
+}
+
+int fuse_ll_ops::run(struct fuse_args *args, const char *arg) {
+	struct fuse_cmdline_opts opts{};
+	if (fuse_parse_cmdline(args, &opts) != 0)
+		return 1;
+	if (opts.mountpoint == nullptr) {
+		global_logger.log(fuse_op, "No mount point is given");
+		return 1;
+	}
+
+	fuse_lowlevel_ops ops = get_fuse_ll_ops();
+	int ret = 1;
+	session = fuse_session_new(args, &ops, sizeof(ops), const_cast<char *>(arg));
+	if (session != nullptr) {
+		if (fuse_set_signal_handlers(session) == 0) {
+			if (fuse_session_mount(session, opts.mountpoint) == 0) {
+				fuse_daemonize(opts.foreground);
+				if (opts.singlethread)
+					ret = fuse_session_loop(session);
+				else
+					ret = fuse_session_loop_mt(session, opts.clone_fd);
+				fuse_session_unmount(session);
+			}
+			fuse_remove_signal_handlers(session);
+		}
+		fuse_session_destroy(session);
+	}
+
+	free(opts.mountpoint);
+	return ret != 0 ? 1 : 0;
+}
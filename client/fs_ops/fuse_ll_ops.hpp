@@ -0,0 +1,20 @@
+#ifndef _FUSE_LL_OPS_HPP_
+#define _FUSE_LL_OPS_HPP_
+
+#include "fuse_ops.hpp"
+
+/*
+ * The low-level fuse frontend.
+ * Requests come with the nodeids the kernel was given by lookup(), each one standing for a node of
+ * node_table, so an inode is found from its directory instead of resolving its path from "/".
+ */
+namespace fuse_ll_ops {
+
+fuse_lowlevel_ops get_fuse_ll_ops(void);
+
+/* Mounts at the mount point given in args and serves until unmounted, arg : see fuse_ops::init() */
+int run(struct fuse_args *args, const char *arg);
+
+} /* fuse_ll_ops */
+
+#endif /* _FUSE_LL_OPS_HPP_ */
@@ -1,5 +1,10 @@
 #include "fuse_ops.hpp"
 #include "../in_memory/directory_table.hpp"
+#include "../in_memory/attr_cache.hpp"
+#include "../in_memory/data_versions.hpp"
+#include "../in_memory/write_cache.hpp"
+#include "../in_memory/kernel_cache.hpp"
+#include "../in_memory/node_table.hpp"
 #include "local_ops.hpp"
 #include "remote_ops.hpp"
 #include "../rpc/rpc_server.hpp"
@@ -19,35 +24,48 @@ std::unique_ptr<Server> remote_handle;
 std::shared_ptr<lease_client> lc;
 
 std::unique_ptr<directory_table> indexing_table;
+std::unique_ptr<attr_cache> remote_attrs;
+std::unique_ptr<data_versions> file_versions;
 std::unique_ptr<uuid_controller> ino_controller;
 std::unique_ptr<file_handler_list> open_context;
 std::unique_ptr<journal> journalctl;
+std::unique_ptr<write_back> write_buffers;
+std::unique_ptr<kernel_cache> kernel_caches;
+std::unique_ptr<node_table> nodes;
 
 std::unique_ptr<thread> remote_server_thread;
 
 std::unique_ptr<client> this_client;
 unsigned int fuse_capable;
+struct mount_options nmfs_options = {0, DEFAULT_ATTR_TTL_MS, DEFAULT_RPC_CQ_THREADS, DEFAULT_RPC_WORKERS, DEFAULT_ASYNC_CREATES, DEFAULT_RPC_CHANNELS, DEFAULT_WRITE_CACHE_MB,
+				      DEFAULT_KERNEL_TTL_MS};
 
-void *fuse_ops::init(struct fuse_conn_info *info, struct fuse_config *config) {
+void fuse_ops::init(const std::string &arg, uid_t uid, gid_t gid, struct fuse_conn_info *info, struct fuse_session *se) {
 	global_logger.log(fuse_op, "Called init()");
 
 	/* argument parsing */
-	fuse_context *fuse_ctx = fuse_get_context();
-	std::string arg((char *) fuse_ctx->private_data);
 	size_t dot_pos = arg.find(',');
 	std::string manager_ip = arg.substr(0, dot_pos);
 	std::string remote_handle_ip = arg.substr(dot_pos + 1);
-	global_logger.log(fuse_op, "manager IP: " + manager_ip + " remote_handle IP: " + remote_handle_ip);
+
+	/* The object store backend is optional */
+	std::string backend = DEFAULT_BACKEND;
+	size_t backend_pos = remote_handle_ip.find(',');
+	if (backend_pos != std::string::npos) {
+		backend = remote_handle_ip.substr(backend_pos + 1);
+		remote_handle_ip = remote_handle_ip.substr(0, backend_pos);
+	}
+	global_logger.log(fuse_op, "manager IP: " + manager_ip + " remote_handle IP: " + remote_handle_ip + " backend: " + backend);
 
 	rados_io::conn_info ci = {"client.admin", "ceph", 0};
-	meta_pool = std::make_shared<rados_io>(ci, META_POOL);
-	data_pool = std::make_shared<rados_io>(ci, DATA_POOL);
+	meta_pool = rados_io::create(backend, ci, META_POOL);
+	data_pool = rados_io::create(backend, ci, DATA_POOL);
 
 	auto channel = grpc::CreateChannel(manager_ip, grpc::InsecureChannelCredentials());
 	lc = std::make_shared<lease_client>(channel, remote_handle_ip);
 	this_client = std::make_unique<client>(channel);
-	this_client->set_client_uid(fuse_ctx->uid);
-	this_client->set_client_gid(fuse_ctx->gid);
+	this_client->set_client_uid(uid);
+	this_client->set_client_gid(gid);
 
 	global_logger.log(fuse_op, "Client(ID=" + std::to_string(this_client->get_client_id()) + ") is mounted");
 
@@ -62,41 +80,51 @@ void *fuse_ops::init(struct fuse_conn_info *info, struct fuse_config *config) {
 		d.sync();
 	}
 
+	remote_attrs = std::make_unique<attr_cache>(milliseconds(nmfs_options.attr_ttl_ms));
+	file_versions = std::make_unique<data_versions>();
+	/* A directory is leased with its journal replayed, from the root on */
+	journalctl = std::make_unique<journal>(meta_pool, lc);
+	lc->keep_while([](const uuid &ino) { return journalctl->has_pending(ino); });
 	indexing_table = std::make_unique<directory_table>();
 	ino_controller = std::make_unique<uuid_controller>();
 	open_context = std::make_unique<file_handler_list>();
-	journalctl = std::make_unique<journal>(meta_pool, lc);
+	lc->on_lost([](const uuid &ino, const std::string &leader) {
+		/* The clients which still send requests here are told where the directory went */
+		if (!leader.empty())
+			indexing_table->hint_leader(ino, leader);
+		indexing_table->drop_dentry_table(ino);
+	});
+	write_buffers = std::make_unique<write_back>(static_cast<size_t>(nmfs_options.write_cache_mb) << 20);
+
+	nodes = std::make_unique<node_table>(get_root_ino());
+	kernel_caches = std::make_unique<kernel_cache>(nmfs_options.kernel_ttl_ms > 0 ? se : nullptr);
 
-	config->nullpath_ok = 0;
 	fuse_capable = info->capable;
 
+	/* Data moves through pipes between /dev/fuse and read_buf/write_buf when the kernel allows it */
+	info->want |= info->capable & (FUSE_CAP_SPLICE_READ | FUSE_CAP_SPLICE_WRITE | FUSE_CAP_SPLICE_MOVE);
+
 	remote_server_thread = std::make_unique<thread>(run_rpc_server, remote_handle_ip);
-	return nullptr;
 }
 
-void fuse_ops::destroy(void *private_data) {
+void fuse_ops::destroy(void) {
 	global_logger.log(fuse_op, "Called destroy()");
 
 	remote_handle->Shutdown();
 }
 
-int fuse_ops::getattr(const char *path, struct stat *stat, struct fuse_file_info *file_info) {
+int fuse_ops::getattr(shared_ptr<inode> i, struct stat *stat) {
 	global_logger.log(fuse_op, "Called getattr()");
-	global_logger.log(fuse_op, "path : " + std::string(path));
 
 	int ret = 0;
 	try {
-		shared_ptr<inode> i;
-		if(file_info){
-			shared_ptr<file_handler> handler = open_context->get_file_handler(file_info->fh);
-			i = handler->get_open_inode_info();
-		} else {
-			i = indexing_table->path_traversal(path);
-		}
-
 		if (i->get_loc() == LOCAL) {
 			local_getattr(i, stat);
 		} else if (i->get_loc() == REMOTE) {
+			/* the leader knows the size once the cached writes are sent */
+			ret = write_buffers->flush(i->get_ino());
+			if (ret != 0)
+				return ret;
 			while(true){
 				ret = remote_getattr(std::dynamic_pointer_cast<remote_inode>(i), stat);
 				if(ret == -ENOTLEADER) {
@@ -110,6 +138,8 @@ int fuse_ops::getattr(const char *path, struct stat *stat, struct fuse_file_info
 		}
 	} catch (inode::no_entry &e) {
 		return -ENOENT;
+	} catch (inode::not_directory &e) {
+		return -ENOTDIR;
 	} catch (inode::permission_denied &e) {
 		return -EACCES;
 	}
@@ -117,14 +147,11 @@ int fuse_ops::getattr(const char *path, struct stat *stat, struct fuse_file_info
 	return ret;
 }
 
-int fuse_ops::access(const char *path, int mask) {
+int fuse_ops::access(shared_ptr<inode> i, int mask) {
 	global_logger.log(fuse_op, "Called access()");
-	global_logger.log(fuse_op, "path : " + std::string(path));
 
 	int ret = 0;
 	try {
-		shared_ptr<inode> i = indexing_table->path_traversal(path);
-
 		if (i->get_loc() == LOCAL) {
 			local_access(i, mask);
 		} else if (i->get_loc() == REMOTE) {
@@ -142,6 +169,8 @@ int fuse_ops::access(const char *path, int mask) {
 
 	} catch (inode::no_entry &e) {
 		return -ENOENT;
+	} catch (inode::not_directory &e) {
+		return -ENOTDIR;
 	} catch (inode::permission_denied &e) {
 		/* from inode constructor */
 		return -EACCES;
@@ -150,26 +179,26 @@ int fuse_ops::access(const char *path, int mask) {
 	return ret;
 }
 
-int fuse_ops::symlink(const char *src, const char *dst) {
+int fuse_ops::symlink(const char *src, shared_ptr<inode> dst_parent_i, const std::string &name) {
 	global_logger.log(fuse_op, "Called symlink()");
-	global_logger.log(fuse_op, "src : " + std::string(src) + " dst : " + std::string(dst));
+	global_logger.log(fuse_op, "src : " + std::string(src) + " name : " + name);
 
+	/* local_symlink() and the leader take the name from a path */
+	std::string dst = "/" + name;
 	int ret = 0;
 	try {
-		unique_ptr<std::string> dst_parent_name = get_parent_dir_path(dst);
-		shared_ptr<inode> dst_parent_i = indexing_table->path_traversal(*dst_parent_name);
 		shared_ptr<dentry_table> dst_parent_dentry_table = indexing_table->get_dentry_table(
 			dst_parent_i->get_ino());
 
 		if (dst_parent_dentry_table->get_loc() == LOCAL) {
-			ret = local_symlink(dst_parent_i, src, dst);
+			ret = local_symlink(dst_parent_i, src, dst.c_str());
 		} else if (dst_parent_dentry_table->get_loc() == REMOTE) {
 			shared_ptr<remote_inode> remote_i = std::make_shared<remote_inode>(
 				dst_parent_dentry_table->get_leader_ip(),
 				dst_parent_dentry_table->get_dir_ino(),
-				*dst_parent_name);
+				name);
 			while(true){
-				ret = remote_symlink(remote_i, src, dst);
+				ret = remote_symlink(remote_i, src, dst.c_str());
 				if(ret == -ENOTLEADER) {
 					indexing_table->find_remote_dentry_table_again(remote_i);
 					continue;
@@ -178,10 +207,13 @@ int fuse_ops::symlink(const char *src, const char *dst) {
 				} else
 					break;
 			}
+			indexing_table->invalidate_negative_lookup(dst_parent_dentry_table->get_dir_ino(), name);
 		}
 
 	} catch (inode::no_entry &e) {
 		return -ENOENT;
+	} catch (inode::not_directory &e) {
+		return -ENOTDIR;
 	} catch (inode::permission_denied &e) {
 		return -EACCES;
 	}
@@ -189,14 +221,11 @@ int fuse_ops::symlink(const char *src, const char *dst) {
 	return ret;
 }
 
-int fuse_ops::readlink(const char *path, char *buf, size_t size) {
+int fuse_ops::readlink(shared_ptr<inode> i, char *buf, size_t size) {
 	global_logger.log(fuse_op, "Called readlink()");
-	global_logger.log(fuse_op, "path : " + std::string(path));
 
 	int ret = 0;
 	try {
-		shared_ptr<inode> i = indexing_table->path_traversal(path);
-
 		if (i->get_loc() == LOCAL) {
 			ret = local_readlink(i, buf, size);
 		} else if (i->get_loc() == REMOTE) {
@@ -214,6 +243,8 @@ int fuse_ops::readlink(const char *path, char *buf, size_t size) {
 
 	} catch (inode::no_entry &e) {
 		return -ENOENT;
+	} catch (inode::not_directory &e) {
+		return -ENOTDIR;
 	} catch (inode::permission_denied &e) {
 		return -EACCES;
 	}
@@ -221,15 +252,12 @@ int fuse_ops::readlink(const char *path, char *buf, size_t size) {
 	return ret;
 }
 
-int fuse_ops::opendir(const char *path, struct fuse_file_info *file_info) {
+int fuse_ops::opendir(shared_ptr<inode> i, struct fuse_file_info *file_info) {
 	global_logger.log(fuse_op, "Called opendir()");
-	global_logger.log(fuse_op, "path : " + std::string(path));
 
 	int ret = 0;
 
 	try {
-		shared_ptr<inode> i = indexing_table->path_traversal(path);
-
 		if (i->get_loc() == LOCAL) {
 			ret = local_opendir(i, file_info);
 		} else if (i->get_loc() == REMOTE) {
@@ -247,6 +275,8 @@ int fuse_ops::opendir(const char *path, struct fuse_file_info *file_info) {
 
 	} catch (inode::no_entry &e) {
 		return -ENOENT;
+	} catch (inode::not_directory &e) {
+		return -ENOTDIR;
 	} catch (inode::permission_denied &e) {
 		return -EACCES;
 	}
@@ -254,50 +284,31 @@ int fuse_ops::opendir(const char *path, struct fuse_file_info *file_info) {
 	return ret;
 }
 
-int fuse_ops::releasedir(const char *path, struct fuse_file_info *file_info) {
+int fuse_ops::releasedir(struct fuse_file_info *file_info) {
 	global_logger.log(fuse_op, "Called releasedir()");
-	if (path != nullptr) {
-		global_logger.log(fuse_op, "path : " + std::string(path));
-	} else {
-		global_logger.log(fuse_op, "path : nullpath");
-	}
 
 	int ret = 0;
-	shared_ptr<inode> i;
-	if(file_info){
-		shared_ptr<file_handler> handler = open_context->get_file_handler(file_info->fh);
-		i = handler->get_open_inode_info();
-	} else {
-		i = indexing_table->path_traversal(path);
-	}
+	shared_ptr<file_handler> handler = open_context->get_file_handler(file_info->fh);
+	shared_ptr<inode> i = handler->get_open_inode_info();
 	ret = local_releasedir(i, file_info);
 
 	return ret;
 }
 
-int fuse_ops::readdir(const char *path, void *buffer, fuse_fill_dir_t filler, off_t offset,
-		      struct fuse_file_info *file_info, enum fuse_readdir_flags readdir_flags) {
+int fuse_ops::readdir(shared_ptr<inode> i, void *buffer, fill_dir_t filler, off_t offset, bool plus) {
 	global_logger.log(fuse_op, "Called readdir()");
-	global_logger.log(fuse_op, "path : " + std::string(path));
 
 	int ret = 0;
-	shared_ptr<inode> i;
-	if(file_info){
-		shared_ptr<file_handler> handler = open_context->get_file_handler(file_info->fh);
-		i = handler->get_open_inode_info();
-	} else {
-		i = indexing_table->path_traversal(path);
-	}
 	shared_ptr<dentry_table> target_dentry_table = indexing_table->get_dentry_table(i->get_ino());
 
 	if (target_dentry_table->get_loc() == LOCAL) {
-		local_readdir(i, buffer, filler);
+		local_readdir(i, buffer, filler, offset, plus);
 	} else if (target_dentry_table->get_loc() == REMOTE) {
 		shared_ptr<remote_inode> remote_i = std::make_shared<remote_inode>(target_dentry_table->get_leader_ip(),
 										   target_dentry_table->get_dir_ino(),
-										   *(get_filename_from_path(path)));
+										   "");
 		while(true) {
-			ret = remote_readdir(remote_i, buffer, filler);
+			ret = remote_readdir(remote_i, buffer, filler, offset, plus);
 			if(ret == -ENOTLEADER) {
 				indexing_table->find_remote_dentry_table_again(remote_i);
 				continue;
@@ -311,29 +322,26 @@ int fuse_ops::readdir(const char *path, void *buffer, fuse_fill_dir_t filler, of
 	return ret;
 }
 
-int fuse_ops::mkdir(const char *path, mode_t mode) {
+int fuse_ops::mkdir(shared_ptr<inode> parent_i, const std::string &name, mode_t mode) {
 	global_logger.log(fuse_op, "Called mkdir()");
-	global_logger.log(fuse_op, "path : " + std::string(path));
+	global_logger.log(fuse_op, "name : " + name);
 
 	std::shared_ptr<inode> new_dir_inode;
 	std::shared_ptr<dentry> new_dir_dentry;
 	try {
-		std::unique_ptr<std::string> target_name = get_filename_from_path(path);
-
-		shared_ptr<inode> parent_i = indexing_table->path_traversal(*(get_parent_dir_path(path).get()));
 		shared_ptr<dentry_table> parent_dentry_table = indexing_table->get_dentry_table(parent_i->get_ino());
 
 		int ret = 0;
 		if (parent_dentry_table->get_loc() == LOCAL) {
-			ret = local_mkdir(parent_i, *target_name, mode, new_dir_inode, new_dir_dentry);
+			ret = local_mkdir(parent_i, name, mode, new_dir_inode, new_dir_dentry);
 			indexing_table->lease_dentry_table_mkdir(new_dir_inode, new_dir_dentry);
 		} else if (parent_dentry_table->get_loc() == REMOTE) {
 			shared_ptr<remote_inode> remote_i = std::make_shared<remote_inode>(
 				parent_dentry_table->get_leader_ip(),
 				parent_dentry_table->get_dir_ino(),
-				*target_name);
+				name);
 			while(true) {
-				ret = remote_mkdir(remote_i, *target_name, mode, new_dir_inode, new_dir_dentry);
+				ret = remote_mkdir(remote_i, name, mode, new_dir_inode, new_dir_dentry);
 				if (ret == -ENOTLEADER) {
 					indexing_table->find_remote_dentry_table_again(remote_i);
 					continue;
@@ -342,10 +350,13 @@ int fuse_ops::mkdir(const char *path, mode_t mode) {
 				} else
 					break;
 			}
+			indexing_table->invalidate_negative_lookup(parent_dentry_table->get_dir_ino(), name);
 			indexing_table->lease_dentry_table_mkdir(new_dir_inode, new_dir_dentry);
 		}
 	} catch (inode::no_entry &e) {
 		return -ENOENT;
+	} catch (inode::not_directory &e) {
+		return -ENOTDIR;
 	} catch (inode::permission_denied &e) {
 		return -EACCES;
 	}
@@ -353,19 +364,16 @@ int fuse_ops::mkdir(const char *path, mode_t mode) {
 	return 0;
 }
 
-int fuse_ops::rmdir(const char *path) {
+int fuse_ops::rmdir(shared_ptr<inode> parent_i, const std::string &name) {
 	global_logger.log(fuse_op, "Called rmdir()");
-	global_logger.log(fuse_op, "path : " + std::string(path));
+	global_logger.log(fuse_op, "name : " + name);
 
 	int ret = 0;
 	try {
-		std::unique_ptr<std::string> target_name = get_filename_from_path(path);
-
-		shared_ptr<inode> parent_i = indexing_table->path_traversal(*(get_parent_dir_path(path).get()));
 		shared_ptr<dentry_table> parent_dentry_table = indexing_table->get_dentry_table(parent_i->get_ino());
 
-		uuid target_ino = parent_dentry_table->check_child_inode(*target_name);
-		shared_ptr<inode> target_i = parent_dentry_table->get_child_inode(*(get_filename_from_path(path).get()));
+		uuid target_ino = parent_dentry_table->check_child_inode(name);
+		shared_ptr<inode> target_i = parent_dentry_table->get_child_inode(name);
 		if(!S_ISDIR(target_i->get_mode()))
 			return -ENOTDIR;
 
@@ -374,12 +382,12 @@ int fuse_ops::rmdir(const char *path) {
 		if ((parent_dentry_table->get_loc() == LOCAL) && (target_dentry_table->get_loc() == LOCAL)) {
 			ret = local_rmdir_top(target_i, target_ino);
 			if(ret == 0)
-				local_rmdir_down(parent_i, target_ino, *target_name);
+				local_rmdir_down(parent_i, target_ino, name);
 		} else if ((parent_dentry_table->get_loc() == LOCAL) && (target_dentry_table->get_loc() == REMOTE)) {
 			shared_ptr<remote_inode> target_remote_i = std::make_shared<remote_inode>(
 				target_dentry_table->get_leader_ip(),
 				target_dentry_table->get_dir_ino(),
-				*target_name);
+				name);
 			while(true) {
 				ret = remote_rmdir_top(target_remote_i, target_ino);
 				if(ret == -ENOTLEADER) {
@@ -391,16 +399,16 @@ int fuse_ops::rmdir(const char *path) {
 					break;
 			}
 			if(ret == 0)
-				local_rmdir_down(parent_i, target_ino, *target_name);
+				local_rmdir_down(parent_i, target_ino, name);
 		} else if ((parent_dentry_table->get_loc() == REMOTE) && (target_dentry_table->get_loc() == LOCAL)) {
 			ret = local_rmdir_top(target_i, target_ino);
 			if(ret == 0) {
 				shared_ptr<remote_inode> parent_remote_i = std::make_shared<remote_inode>(
 					parent_dentry_table->get_leader_ip(),
 					parent_dentry_table->get_dir_ino(),
-					*target_name);
+					name);
 				while(true) {
-					ret = remote_rmdir_down(parent_remote_i, target_ino, *target_name);
+					ret = remote_rmdir_down(parent_remote_i, target_ino, name);
 					if(ret == -ENOTLEADER) {
 						indexing_table->find_remote_dentry_table_again(parent_remote_i);
 						continue;
@@ -414,7 +422,7 @@ int fuse_ops::rmdir(const char *path) {
 			shared_ptr<remote_inode> target_remote_i = std::make_shared<remote_inode>(
 				target_dentry_table->get_leader_ip(),
 				target_dentry_table->get_dir_ino(),
-				*target_name);
+				name);
 			while(true) {
 				ret = remote_rmdir_top(target_remote_i, target_ino);
 				if(ret == -ENOTLEADER) {
@@ -429,9 +437,9 @@ int fuse_ops::rmdir(const char *path) {
 				shared_ptr<remote_inode> parent_remote_i = std::make_shared<remote_inode>(
 					parent_dentry_table->get_leader_ip(),
 					parent_dentry_table->get_dir_ino(),
-					*target_name);
+					name);
 				while(true) {
-					ret = remote_rmdir_down(parent_remote_i, target_ino, *target_name);
+					ret = remote_rmdir_down(parent_remote_i, target_ino, name);
 					if(ret == -ENOTLEADER) {
 						indexing_table->find_remote_dentry_table_again(parent_remote_i);
 						continue;
@@ -442,8 +450,11 @@ int fuse_ops::rmdir(const char *path) {
 				}
 			}
 		}
+		indexing_table->invalidate_lookup(parent_i->get_ino(), name);
 	} catch (inode::no_entry &e) {
 		return -ENOENT;
+	} catch (inode::not_directory &e) {
+		return -ENOTDIR;
 	} catch (inode::permission_denied &e) {
 		return -EACCES;
 	}
@@ -451,21 +462,26 @@ int fuse_ops::rmdir(const char *path) {
 	return ret;
 }
 
-int fuse_ops::rename(const char *old_path, const char *new_path, unsigned int flags) {
+int fuse_ops::rename(shared_ptr<inode> src_parent_i, const std::string &name, shared_ptr<inode> dst_parent_i,
+		     const std::string &new_name, unsigned int flags) {
 	global_logger.log(fuse_op, "Called rename()");
-	global_logger.log(fuse_op, "src : " + std::string(old_path) + " dst : " + std::string(new_path));
+	global_logger.log(fuse_op, "src : " + name + " dst : " + new_name);
 
 	int ret = 0;
 
-	if (std::string(old_path) == std::string(new_path))
+	bool same_parent = src_parent_i->get_ino() == dst_parent_i->get_ino();
+	if (same_parent && name == new_name)
 		return -EEXIST;
 
-	try {
-		unique_ptr<std::string> src_parent_path = get_parent_dir_path(old_path);
-		unique_ptr<std::string> dst_parent_path = get_parent_dir_path(new_path);
+	/* The rename ops and the leader take the names from paths */
+	std::string old_path_str = "/" + name;
+	std::string new_path_str = "/" + new_name;
+	const char *old_path = old_path_str.c_str();
+	const char *new_path = new_path_str.c_str();
 
-		if (*src_parent_path == *dst_parent_path) {
-			shared_ptr<inode> parent_i = indexing_table->path_traversal(*src_parent_path);
+	try {
+		if (same_parent) {
+			shared_ptr<inode> parent_i = src_parent_i;
 			shared_ptr<dentry_table> parent_dentry_table = indexing_table->get_dentry_table(
 				parent_i->get_ino());
 
@@ -487,14 +503,13 @@ int fuse_ops::rename(const char *old_path, const char *new_path, unsigned int fl
 						break;
 				}
 			}
+			indexing_table->invalidate_lookup(parent_i->get_ino(), name);
+			indexing_table->invalidate_lookup(parent_i->get_ino(), new_name);
 		} else {
-			shared_ptr<inode> src_parent_i = indexing_table->path_traversal(*src_parent_path);
 			shared_ptr<dentry_table> src_dentry_table = indexing_table->get_dentry_table(src_parent_i->get_ino());
-
-			shared_ptr<inode> dst_parent_i = indexing_table->path_traversal(*dst_parent_path);
 			shared_ptr<dentry_table> dst_dentry_table = indexing_table->get_dentry_table(dst_parent_i->get_ino());
 
-			uuid check_dst_ino = dst_dentry_table->check_child_inode(*get_filename_from_path(new_path));
+			uuid check_dst_ino = dst_dentry_table->check_child_inode(new_name);
 			if ((src_dentry_table->get_loc() == LOCAL) && (dst_dentry_table->get_loc() == LOCAL)) {
 				std::shared_ptr<inode> target_inode = local_rename_not_same_parent_src(src_parent_i, old_path, flags);
 				ret = local_rename_not_same_parent_dst(dst_parent_i, target_inode, check_dst_ino, new_path, flags);
@@ -563,10 +578,13 @@ int fuse_ops::rename(const char *old_path, const char *new_path, unsigned int fl
 						break;
 				}
 			}
-
+			indexing_table->invalidate_lookup(src_parent_i->get_ino(), name);
+			indexing_table->invalidate_lookup(dst_parent_i->get_ino(), new_name);
 		}
 	} catch (inode::no_entry &e) {
 		return -ENOENT;
+	} catch (inode::not_directory &e) {
+		return -ENOTDIR;
 	} catch (inode::permission_denied &e) {
 		return -EACCES;
 	} catch (std::runtime_error &e) {
@@ -600,9 +618,8 @@ int fuse_ops::rename(const char *old_path, const char *new_path, unsigned int fl
 // O_SYNC	- To be implemented
 
 
-int fuse_ops::open(const char *path, struct fuse_file_info *file_info) {
+int fuse_ops::open(shared_ptr<inode> i, struct fuse_file_info *file_info) {
 	global_logger.log(fuse_op, "Called open()");
-	global_logger.log(fuse_op, "path : " + std::string(path));
 
 	/* flags which are unimplemented and to be implemented */
 
@@ -611,10 +628,16 @@ int fuse_ops::open(const char *path, struct fuse_file_info *file_info) {
 
 	int ret = 0;
 	try {
-		shared_ptr<inode> i = indexing_table->path_traversal(path);
+		/* an O_TRUNC open mustn't be followed by older cached writes */
+		ret = write_buffers->flush(i->get_ino());
+		if (ret != 0)
+			return ret;
 
 		if (i->get_loc() == LOCAL) {
 			ret = local_open(i, file_info);
+			/* The pages of a file in a directory this client leads stay valid until kernel_caches drops them */
+			if (ret == 0 && !(file_info->flags & O_TRUNC) && kernel_caches->track(i->get_ino(), i->get_p_ino()))
+				file_info->keep_cache = 1;
 		} else if (i->get_loc() == REMOTE) {
 			while(true) {
 				ret = remote_open(std::dynamic_pointer_cast<remote_inode>(i), file_info);
@@ -627,9 +650,14 @@ int fuse_ops::open(const char *path, struct fuse_file_info *file_info) {
 					break;
 			}
 		}
+		/* the read-ahead of the other handlers of the file is dropped */
+		if (file_info->flags & O_TRUNC)
+			i->bump_data_version();
 
 	} catch (inode::no_entry &e) {
 		return -ENOENT;
+	} catch (inode::not_directory &e) {
+		return -ENOTDIR;
 	} catch (inode::permission_denied &e) {
 		return -EACCES;
 	}
@@ -637,50 +665,51 @@ int fuse_ops::open(const char *path, struct fuse_file_info *file_info) {
 	return ret;
 }
 
-int fuse_ops::release(const char *path, struct fuse_file_info *file_info) {
+int fuse_ops::release(struct fuse_file_info *file_info) {
 	global_logger.log(fuse_op, "Called release()");
-	if (path != nullptr) {
-		global_logger.log(fuse_op, "path : " + std::string(path));
-	} else {
-		global_logger.log(fuse_op, "path : nullpath");
-	}
 
 	int ret = 0;
-	shared_ptr<inode> i;
-	if(file_info){
-		shared_ptr<file_handler> handler = open_context->get_file_handler(file_info->fh);
-		i = handler->get_open_inode_info();
-	} else {
-		i = indexing_table->path_traversal(path);
-	}
+	shared_ptr<file_handler> handler = open_context->get_file_handler(file_info->fh);
+	shared_ptr<inode> i = handler->get_open_inode_info();
+
+	/* The data written through the handler goes out before it is closed */
+	int flush_ret = handler->flush_write_cache();
 
 	ret = local_release(i, file_info);
+	if (flush_ret != 0)
+		ret = flush_ret;
+
+	/* A create the leader refused after it was answered is reported here the last time */
+	if (i->get_loc() == REMOTE) {
+		int create_ret = remote_create_error(std::dynamic_pointer_cast<remote_inode>(i), true);
+		if (create_ret != 0)
+			ret = create_ret;
+	}
 
 	return ret;
 }
 
-int fuse_ops::create(const char *path, mode_t mode, struct fuse_file_info *file_info) {
+int fuse_ops::create(shared_ptr<inode> parent_i, const std::string &name, mode_t mode, struct fuse_file_info *file_info) {
 	global_logger.log(fuse_op, "Called create()");
-	global_logger.log(fuse_op, "path : " + std::string(path));
+	global_logger.log(fuse_op, "name : " + name);
 
 	if (S_ISDIR(mode))
 		return -EISDIR;
 	int ret = 0;
 	try {
-		std::unique_ptr<std::string> target_name = get_filename_from_path(path);
-
-		shared_ptr<inode> parent_i = indexing_table->path_traversal(*(get_parent_dir_path(path).get()));
 		shared_ptr<dentry_table> parent_dentry_table = indexing_table->get_dentry_table(parent_i->get_ino());
 
 		if (parent_dentry_table->get_loc() == LOCAL) {
-			local_create(parent_i, *target_name, mode, file_info);
+			local_create(parent_i, name, mode, file_info);
+			shared_ptr<inode> i = open_context->get_file_handler(file_info->fh)->get_open_inode_info();
+			kernel_caches->track(i->get_ino(), parent_i->get_ino());
 		} else if (parent_dentry_table->get_loc() == REMOTE) {
 			shared_ptr<remote_inode> remote_i = std::make_shared<remote_inode>(
 				parent_dentry_table->get_leader_ip(),
 				parent_dentry_table->get_dir_ino(),
-				*target_name);
+				name);
 			while(true) {
-				ret = remote_create(remote_i, *target_name, mode, file_info);
+				ret = remote_create(remote_i, name, mode, file_info);
 				if(ret == -ENOTLEADER) {
 					indexing_table->find_remote_dentry_table_again(remote_i);
 					continue;
@@ -689,9 +718,12 @@ int fuse_ops::create(const char *path, mode_t mode, struct fuse_file_info *file_
 				} else
 					break;
 			}
+			indexing_table->invalidate_negative_lookup(parent_dentry_table->get_dir_ino(), name);
 		}
 	} catch (inode::no_entry &e) {
 		return -ENOENT;
+	} catch (inode::not_directory &e) {
+		return -ENOTDIR;
 	} catch (inode::permission_denied &e) {
 		return -EACCES;
 	}
@@ -699,26 +731,23 @@ int fuse_ops::create(const char *path, mode_t mode, struct fuse_file_info *file_
 	return ret;
 }
 
-int fuse_ops::unlink(const char *path) {
+int fuse_ops::unlink(shared_ptr<inode> parent_i, const std::string &name) {
 	global_logger.log(fuse_op, "Called unlink()");
-	global_logger.log(fuse_op, "path : " + std::string(path));
+	global_logger.log(fuse_op, "name : " + name);
 
 	int ret = 0;
 	try {
-		std::unique_ptr<std::string> target_name = get_filename_from_path(path);
-
-		shared_ptr<inode> parent_i = indexing_table->path_traversal(*(get_parent_dir_path(path).get()));
 		shared_ptr<dentry_table> parent_dentry_table = indexing_table->get_dentry_table(parent_i->get_ino());
 
 		if (parent_dentry_table->get_loc() == LOCAL) {
-			local_unlink(parent_i, *target_name);
+			local_unlink(parent_i, name);
 		} else if (parent_dentry_table->get_loc() == REMOTE) {
 			shared_ptr<remote_inode> remote_i = std::make_shared<remote_inode>(
 				parent_dentry_table->get_leader_ip(),
 				parent_dentry_table->get_dir_ino(),
-				*target_name);
+				name);
 			while(true) {
-				ret = remote_unlink(remote_i, *target_name);
+				ret = remote_unlink(remote_i, name);
 				if(ret == -ENOTLEADER) {
 					indexing_table->find_remote_dentry_table_again(remote_i);
 					continue;
@@ -728,56 +757,73 @@ int fuse_ops::unlink(const char *path) {
 					break;
 			}
 		}
+		indexing_table->invalidate_lookup(parent_i->get_ino(), name);
 	} catch (inode::no_entry &e) {
 		return -ENOENT;
+	} catch (inode::not_directory &e) {
+		return -ENOTDIR;
 	} catch (inode::permission_denied &e) {
 		return -EACCES;
 	}
 	return ret;
 }
 
-int fuse_ops::read(const char *path, char *buffer, size_t size, off_t offset, struct fuse_file_info *file_info) {
-	global_logger.log(fuse_op, "Called read()");
-	global_logger.log(fuse_op, "path : " + std::string(path) + " size : " + std::to_string(size) + " offset : " +
-				   std::to_string(offset));
+/* The inode and handler a read goes to, with the cached writes sent */
+static int prepare_read(struct fuse_file_info *file_info, shared_ptr<inode> &i, shared_ptr<file_handler> &handler) {
+	handler = open_context->get_file_handler(file_info->fh);
+	i = handler->get_open_inode_info();
+
+	return write_buffers->flush(i->get_ino());
+}
+
+int fuse_ops::read_buf(struct fuse_bufvec **bufp, size_t size, off_t offset, struct fuse_file_info *file_info) {
+	global_logger.log(fuse_op, "Called read_buf()");
+	global_logger.log(fuse_op, "size : " + std::to_string(size) + " offset : " + std::to_string(offset));
 
-	ssize_t read_len = 0;
 	try {
 		shared_ptr<inode> i;
-		if(file_info){
-			shared_ptr<file_handler> handler = open_context->get_file_handler(file_info->fh);
-			i = handler->get_open_inode_info();
-		} else {
-			i = indexing_table->path_traversal(path);
-		}
+		shared_ptr<file_handler> handler;
+		int flush_ret = prepare_read(file_info, i, handler);
+		if (flush_ret != 0)
+			return flush_ret;
 
-		read_len = local_read(i, buffer, size, offset);
+		/* The chunks read ahead go to the kernel without being copied again */
+		handler->get_read_ahead().read_buf(i, bufp, size, offset);
 	} catch (inode::no_entry &e) {
 		return -ENOENT;
+	} catch (inode::not_directory &e) {
+		return -ENOTDIR;
 	} catch (inode::permission_denied &e) {
 		return -EACCES;
 	} catch (rados_io::no_such_object &e) {
-		return (int) e.num_bytes;
+		return -EIO;
 	}
 
-	return (int) read_len;
+	return 0;
 }
 
-int fuse_ops::write(const char *path, const char *buffer, size_t size, off_t offset, struct fuse_file_info *file_info) {
+int fuse_ops::write(const char *buffer, size_t size, off_t offset, struct fuse_file_info *file_info) {
 	global_logger.log(fuse_op, "Called write()");
-	global_logger.log(fuse_op, "path : " + std::string(path) + " size : " + std::to_string(size) + " offset : " +
-				   std::to_string(offset));
+	global_logger.log(fuse_op, "size : " + std::to_string(size) + " offset : " + std::to_string(offset));
 
 	ssize_t written_len = 0;
 	try {
-		shared_ptr<inode> i;
-		if(file_info){
-			shared_ptr<file_handler> handler = open_context->get_file_handler(file_info->fh);
-			i = handler->get_open_inode_info();
-		} else {
-			i = indexing_table->path_traversal(path);
+		shared_ptr<file_handler> handler = open_context->get_file_handler(file_info->fh);
+		shared_ptr<inode> i = handler->get_open_inode_info();
+
+		/* Only the leader knows where a remote O_APPEND write goes, it is sent at once */
+		bool remote_append = i->get_loc() == REMOTE && (file_info->flags & O_APPEND);
+		if (write_buffers->enabled() && !remote_append) {
+			written_len = handler->get_write_cache()->write(buffer, size, offset, file_info->flags);
+			i->bump_data_version();
+			return (int) written_len;
 		}
 
+		/* a write sent at once goes after the cached ones */
+		int flush_ret = write_buffers->flush(i->get_ino());
+		if (flush_ret != 0)
+			return flush_ret;
+
 		if (i->get_loc() == LOCAL) {
 			written_len = local_write(i, buffer, size, offset, file_info->flags);
 		} else if (i->get_loc() == REMOTE) {
@@ -792,8 +838,11 @@ int fuse_ops::write(const char *path, const char *buffer, size_t size, off_t off
 					break;
 			}
 		}
+		i->bump_data_version();
 	} catch (inode::no_entry &e) {
 		return -ENOENT;
+	} catch (inode::not_directory &e) {
+		return -ENOTDIR;
 	} catch (inode::permission_denied &e) {
 		return -EACCES;
 	}
@@ -801,20 +850,75 @@ int fuse_ops::write(const char *path, const char *buffer, size_t size, off_t off
 	return (int) written_len;
 }
 
-int fuse_ops::chmod(const char *path, mode_t mode, struct fuse_file_info *file_info) {
-	global_logger.log(fuse_op, "Called chmod()");
-	global_logger.log(fuse_op, "path : " + std::string(path));
+int fuse_ops::write_buf(struct fuse_bufvec *buf, off_t offset, struct fuse_file_info *file_info) {
+	global_logger.log(fuse_op, "Called write_buf()");
 
-	int ret = 0;
-	try {
-		shared_ptr<inode> i;
-		if(file_info){
+	size_t size = fuse_buf_size(buf);
+
+	/* A single buffer in memory is written from where it is */
+	if (buf->count == 1 && buf->idx == 0 && buf->off == 0 && !(buf->buf[0].flags & FUSE_BUF_IS_FD))
+		return write(static_cast<const char *>(buf->buf[0].mem), size, offset, file_info);
+
+	/* A buffer spliced from the kernel is copied once, into the write cache if it is used */
+	if (write_buffers->enabled()) {
+		try {
 			shared_ptr<file_handler> handler = open_context->get_file_handler(file_info->fh);
-			i = handler->get_open_inode_info();
-		} else {
-			i = indexing_table->path_traversal(path);
+			shared_ptr<inode> i = handler->get_open_inode_info();
+			if (!(i->get_loc() == REMOTE && (file_info->flags & O_APPEND))) {
+				ssize_t written_len = handler->get_write_cache()->write(buf, offset, file_info->flags);
+				i->bump_data_version();
+				return (int) written_len;
+			}
+		} catch (inode::no_entry &e) {
+			return -ENOENT;
+		} catch (inode::not_directory &e) {
+			return -ENOTDIR;
+		} catch (inode::permission_denied &e) {
+			return -EACCES;
 		}
+	}
+
+	std::unique_ptr<char[]> mem(new char[size]);
+	struct fuse_bufvec dst = FUSE_BUFVEC_INIT(size);
+	dst.buf[0].mem = mem.get();
+	ssize_t copied = fuse_buf_copy(&dst, buf, static_cast<fuse_buf_copy_flags>(0));
+	if (copied < 0)
+		return (int) copied;
 
+	return write(mem.get(), copied, offset, file_info);
+}
+
+/* Flushes the write cache and the create of the file if the leader hasn't seen it yet */
+static int flush_file(struct fuse_file_info *file_info) {
+	shared_ptr<file_handler> handler = open_context->get_file_handler(file_info->fh);
+	shared_ptr<inode> i = handler->get_open_inode_info();
+
+	int ret = handler->flush_write_cache();
+	if (i->get_loc() == REMOTE) {
+		int create_ret = remote_create_error(std::dynamic_pointer_cast<remote_inode>(i));
+		if (create_ret != 0)
+			ret = create_ret;
+	}
+	return ret;
+}
+
+int fuse_ops::flush(struct fuse_file_info *file_info) {
+	global_logger.log(fuse_op, "Called flush()");
+	return flush_file(file_info);
+}
+
+int fuse_ops::fsync(int datasync, struct fuse_file_info *file_info) {
+	global_logger.log(fuse_op, "Called fsync()");
+
+	/* A flushed write is in the data pool and its size in the journal or with the leader */
+	return flush_file(file_info);
+}
+
+int fuse_ops::chmod(shared_ptr<inode> i, mode_t mode) {
+	global_logger.log(fuse_op, "Called chmod()");
+
+	int ret = 0;
+	try {
 		if (i->get_loc() == LOCAL) {
 			local_chmod(i, mode);
 		} else if (i->get_loc() == REMOTE) {
@@ -829,8 +933,11 @@ int fuse_ops::chmod(const char *path, mode_t mode, struct fuse_file_info *file_i
 					break;
 			}
 		}
+		indexing_table->invalidate_lookups();
 	} catch (inode::no_entry &e) {
 		return -ENOENT;
+	} catch (inode::not_directory &e) {
+		return -ENOTDIR;
 	} catch (inode::permission_denied &e) {
 		return -EACCES;
 	}
@@ -838,20 +945,11 @@ int fuse_ops::chmod(const char *path, mode_t mode, struct fuse_file_info *file_i
 	return ret;
 }
 
-int fuse_ops::chown(const char *path, uid_t uid, gid_t gid, struct fuse_file_info *file_info) {
+int fuse_ops::chown(shared_ptr<inode> i, uid_t uid, gid_t gid) {
 	global_logger.log(fuse_op, "Called chown()");
-	global_logger.log(fuse_op, "path : " + std::string(path));
 
 	int ret = 0;
 	try {
-		shared_ptr<inode> i;
-		if(file_info){
-			shared_ptr<file_handler> handler = open_context->get_file_handler(file_info->fh);
-			i = handler->get_open_inode_info();
-		} else {
-			i = indexing_table->path_traversal(path);
-		}
-
 		if (i->get_loc() == LOCAL) {
 			local_chown(i, uid, gid);
 		} else if (i->get_loc() == REMOTE) {
@@ -866,9 +964,12 @@ int fuse_ops::chown(const char *path, uid_t uid, gid_t gid, struct fuse_file_inf
 					break;
 			}
 		}
+		indexing_table->invalidate_lookups();
 
 	} catch (inode::no_entry &e) {
 		return -ENOENT;
+	} catch (inode::not_directory &e) {
+		return -ENOTDIR;
 	} catch (inode::permission_denied &e) {
 		return -EACCES;
 	}
@@ -876,20 +977,11 @@ int fuse_ops::chown(const char *path, uid_t uid, gid_t gid, struct fuse_file_inf
 	return 0;
 }
 
-int fuse_ops::utimens(const char *path, const struct timespec tv[2], struct fuse_file_info *file_info) {
+int fuse_ops::utimens(shared_ptr<inode> i, const struct timespec tv[2]) {
 	global_logger.log(fuse_op, "Called utimens()");
-	global_logger.log(fuse_op, "path : " + std::string(path));
 
 	int ret = 0;
 	try {
-		shared_ptr<inode> i;
-		if(file_info){
-			shared_ptr<file_handler> handler = open_context->get_file_handler(file_info->fh);
-			i = handler->get_open_inode_info();
-		} else {
-			i = indexing_table->path_traversal(path);
-		}
-
 		if (i->get_loc() == LOCAL) {
 			local_utimens(i, tv);
 		} else if (i->get_loc() == REMOTE) {
@@ -907,6 +999,8 @@ int fuse_ops::utimens(const char *path, const struct timespec tv[2], struct fuse
 
 	} catch (inode::no_entry &e) {
 		return -ENOENT;
+	} catch (inode::not_directory &e) {
+		return -ENOTDIR;
 	} catch (inode::permission_denied &e) {
 		return -EACCES;
 	}
@@ -914,19 +1008,16 @@ int fuse_ops::utimens(const char *path, const struct timespec tv[2], struct fuse
 	return 0;
 }
 
-int fuse_ops::truncate(const char *path, off_t offset, struct fuse_file_info *file_info) {
+int fuse_ops::truncate(shared_ptr<inode> i, off_t offset) {
 	global_logger.log(fuse_op, "Called truncate()");
-	global_logger.log(fuse_op, "path : " + std::string(path) + " offset : " + std::to_string(offset));
+	global_logger.log(fuse_op, "offset : " + std::to_string(offset));
 
 	int ret = 0;
 	try {
-		shared_ptr<inode> i;
-		if(file_info){
-			shared_ptr<file_handler> handler = open_context->get_file_handler(file_info->fh);
-			i = handler->get_open_inode_info();
-		} else {
-			i = indexing_table->path_traversal(path);
-		}
+		/* the cached writes land before the size changes under them */
+		ret = write_buffers->flush(i->get_ino());
+		if (ret != 0)
+			return ret;
 
 		if (i->get_loc() == LOCAL) {
 			ret = local_truncate(i, offset);
@@ -942,8 +1033,11 @@ int fuse_ops::truncate(const char *path, off_t offset, struct fuse_file_info *fi
 					break;
 			}
 		}
+		i->bump_data_version();
 	} catch (inode::no_entry &e) {
 		return -ENOENT;
+	} catch (inode::not_directory &e) {
+		return -ENOTDIR;
 	} catch (inode::permission_denied &e) {
 		return -EACCES;
 	}
@@ -951,38 +1045,48 @@ int fuse_ops::truncate(const char *path, off_t offset, struct fuse_file_info *fi
 	return ret;
 }
 
-fuse_operations fuse_ops::get_fuse_ops(void) {
-	fuse_operations fops;
-	memset(&fops, 0, sizeof(fuse_operations));
-
-	fops.init = init;
-	fops.destroy = destroy;
-	fops.getattr = getattr;
-	fops.access = access;
-	fops.symlink = symlink;
-	fops.readlink = readlink;
-
-	fops.opendir = opendir;
-	fops.releasedir = releasedir;
-
-	fops.readdir = readdir;
-	fops.mkdir = mkdir;
-	fops.rmdir = rmdir;
-	fops.rename = rename;
-
-	fops.open = open;
-	fops.release = release;
+int fuse_ops::fallocate(shared_ptr<inode> i, int mode, off_t offset, off_t length) {
+	global_logger.log(fuse_op, "Called fallocate()");
+	global_logger.log(fuse_op, "mode : " + std::to_string(mode) + " offset : " + std::to_string(offset) +
+				   " length : " + std::to_string(length));
 
-	fops.create = create;
-	fops.unlink = unlink;
+	/* Only plain allocation and punching holes are supported */
+	if (mode & ~(FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE))
+		return -EOPNOTSUPP;
+	if ((mode & FALLOC_FL_PUNCH_HOLE) && !(mode & FALLOC_FL_KEEP_SIZE))
+		return -EOPNOTSUPP;
+	if (offset < 0 || length <= 0)
+		return -EINVAL;
 
-	fops.read = read;
-	fops.write = write;
+	int ret = 0;
+	try {
+		/* the cached writes land before the size changes under them */
+		ret = write_buffers->flush(i->get_ino());
+		if (ret != 0)
+			return ret;
 
-	fops.chmod = chmod;
-	fops.chown = chown;
-	fops.utimens = utimens;
+		if (i->get_loc() == LOCAL) {
+			ret = local_fallocate(i, mode, offset, length);
+		} else if (i->get_loc() == REMOTE) {
+			while(true) {
+				ret = remote_fallocate(std::dynamic_pointer_cast<remote_inode>(i), mode, offset, length);
+				if(ret == -ENOTLEADER) {
+					indexing_table->find_remote_dentry_table_again(std::dynamic_pointer_cast<remote_inode>(i));
+					continue;
+				} else if(ret == -ENEEDRECOV) {
+					throw std::runtime_error("Need Recovery of remote dentry_table");
+				} else
+					break;
+			}
+		}
+		i->bump_data_version();
+	} catch (inode::no_entry &e) {
+		return -ENOENT;
+	} catch (inode::not_directory &e) {
+		return -ENOTDIR;
+	} catch (inode::permission_denied &e) {
+		return -EACCES;
+	}
 
-	fops.truncate = truncate;
-	return fops;
+	return ret;
 }
@@ -3,34 +3,74 @@
 
 #define FUSE_USE_VERSION 30
 
+#include <memory>
+#include <string>
+
 #include <fuse.h>
+#include <fuse_lowlevel.h>
+
+#include <boost/uuid/uuid.hpp>
+
+/* options given with -o at mount time */
+struct mount_options {
+	/* child inodes read at once when a directory lease is acquired, 0 reads each one on its first lookup */
+	unsigned int prefetch_batch;
+	/* milliseconds the attributes of an inode led by another client are cached, 0 turns it off */
+	unsigned int attr_ttl_ms;
+	/* threads polling the completion queues of the rpc server */
+	unsigned int rpc_cq_threads;
+	/* threads running the rpc handlers */
+	unsigned int rpc_workers;
+	/* creations asked of a leader at once to be answered without waiting for it, 0 turns it off */
+	unsigned int async_creates;
+	/* connections kept to each leader */
+	unsigned int rpc_channels;
+	/* megabytes of written data kept before it is sent to the data pool, 0 writes through */
+	unsigned int write_cache_mb;
+	/* milliseconds the kernel keeps names and attributes, 0 also stops it keeping pages across opens */
+	unsigned int kernel_ttl_ms;
+};
+
+class inode;
+
+/* Fills the reply of readdir like fuse_fill_dir_t. With readdirplus stbuf comes with the names listed
+   with their attributes, and ino with those the kernel may keep a node of, "." and ".." having none */
+typedef int (*fill_dir_t)(void *buffer, const char *name, const struct stat *stbuf, off_t off, const boost::uuids::uuid *ino);
 
+/*
+ * The file system operations, called by fuse_ll_ops with the inodes its nodes stand for.
+ * The names created or removed come with their parent inode.
+ */
 namespace fuse_ops {
 
-void* init(struct fuse_conn_info* info, struct fuse_config *config);
-void destroy(void* private_data);
-int getattr(const char* path, struct stat* stat, struct fuse_file_info* file_info);
-int access(const char* path, int mask);
-int opendir(const char* path, struct fuse_file_info* file_info);
-int releasedir(const char* path, struct fuse_file_info* file_info);
-int readdir(const char* path, void* buffer, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info* file_info, enum fuse_readdir_flags readdir_flags);
-int mkdir(const char* path, mode_t mode);
-int rmdir(const char* path);
-int symlink(const char *src, const char *dst);
-int readlink(const char *path, char *buf, size_t size);
-int rename(const char* old_path, const char* new_path, unsigned int flags);
-int open(const char* path, struct fuse_file_info* file_info);
-int release(const char* path, struct fuse_file_info* file_info);
-int create(const char* path, mode_t mode, struct fuse_file_info* file_info);
-int unlink(const char* path);
-int read(const char* path, char* buffer, size_t size, off_t offset, struct fuse_file_info* file_info);
-int write(const char* path, const char* buffer, size_t size, off_t offset, struct fuse_file_info* file_info);
-int chmod(const char* path, mode_t mode, struct fuse_file_info* file_info);
-int chown(const char* path, uid_t uid, gid_t gid, struct fuse_file_info* file_info);
-int utimens(const char *path, const struct timespec tv[2], struct fuse_file_info *fi);
-int truncate (const char *path, off_t, struct fuse_file_info *fi);
-
-fuse_operations get_fuse_ops(void);
+/* arg : MANAGE_IP:PORT,REMOTE_IP:PORT[,BACKEND], uid and gid : the owner of what this client creates */
+void init(const std::string &arg, uid_t uid, gid_t gid, struct fuse_conn_info *info, struct fuse_session *se);
+void destroy(void);
+int getattr(std::shared_ptr<inode> i, struct stat *stat);
+int access(std::shared_ptr<inode> i, int mask);
+int opendir(std::shared_ptr<inode> i, struct fuse_file_info *file_info);
+int releasedir(struct fuse_file_info *file_info);
+int readdir(std::shared_ptr<inode> i, void *buffer, fill_dir_t filler, off_t offset, bool plus);
+int mkdir(std::shared_ptr<inode> parent_i, const std::string &name, mode_t mode);
+int rmdir(std::shared_ptr<inode> parent_i, const std::string &name);
+int symlink(const char *src, std::shared_ptr<inode> dst_parent_i, const std::string &name);
+int readlink(std::shared_ptr<inode> i, char *buf, size_t size);
+int rename(std::shared_ptr<inode> src_parent_i, const std::string &name, std::shared_ptr<inode> dst_parent_i,
+	   const std::string &new_name, unsigned int flags);
+int open(std::shared_ptr<inode> i, struct fuse_file_info *file_info);
+int release(struct fuse_file_info *file_info);
+int create(std::shared_ptr<inode> parent_i, const std::string &name, mode_t mode, struct fuse_file_info *file_info);
+int unlink(std::shared_ptr<inode> parent_i, const std::string &name);
+int read_buf(struct fuse_bufvec **bufp, size_t size, off_t offset, struct fuse_file_info *file_info);
+int write(const char *buffer, size_t size, off_t offset, struct fuse_file_info *file_info);
+int write_buf(struct fuse_bufvec *buf, off_t offset, struct fuse_file_info *file_info);
+int flush(struct fuse_file_info *file_info);
+int fsync(int datasync, struct fuse_file_info *file_info);
+int chmod(std::shared_ptr<inode> i, mode_t mode);
+int chown(std::shared_ptr<inode> i, uid_t uid, gid_t gid);
+int utimens(std::shared_ptr<inode> i, const struct timespec tv[2]);
+int truncate(std::shared_ptr<inode> i, off_t offset);
+int fallocate(std::shared_ptr<inode> i, int mode, off_t offset, off_t length);
 
 } /* fuse_ops */
 
@@ -1,4 +1,7 @@
 #include "local_ops.hpp"
+#include "../rpc/rpc_server.hpp"
+
+#include <sys/param.h>
 
 extern std::shared_ptr<rados_io> meta_pool;
 extern std::shared_ptr<rados_io> data_pool;
@@ -49,12 +52,44 @@ int local_releasedir(shared_ptr<inode> i, struct fuse_file_info *file_info) {
 	return ret;
 }
 
-void local_readdir(shared_ptr<inode> i, void *buffer, fuse_fill_dir_t filler) {
+void local_readdir(shared_ptr<inode> i, void *buffer, fill_dir_t filler, off_t offset, bool plus) {
 	global_logger.log(local_fs_op, "Called readdir()");
 	shared_ptr<dentry_table> parent_dentry_table = indexing_table->get_dentry_table(i->get_ino());
-	{
-		std::scoped_lock scl{parent_dentry_table->dentry_table_mutex};
-		parent_dentry_table->fill_filler(buffer, filler);
+
+	/* "." and ".." take the offsets 1 and 2 */
+	if (offset < 1) {
+		struct stat st{};
+		{
+			std::scoped_lock scl{i->inode_mutex};
+			i->fill_stat(&st);
+		}
+		if (filler(buffer, ".", plus ? &st : nullptr, 1, nullptr))
+			return;
+	}
+	if (offset < 2 && filler(buffer, "..", nullptr, 2, nullptr))
+		return;
+
+	/* The dentry table isn't held while the buffer is filled */
+	bool more = true;
+	while (more) {
+		std::vector<readdir_entry> entries;
+		{
+			std::scoped_lock scl{parent_dentry_table->dentry_table_mutex};
+			more = parent_dentry_table->list_children(offset, READDIR_BATCH, plus, entries);
+		}
+
+		for (auto &e : entries) {
+			struct stat st{};
+			uuid ino;
+			if (e.i != nullptr) {
+				std::scoped_lock scl{e.i->inode_mutex};
+				e.i->fill_stat(&st);
+				ino = e.i->get_ino();
+			}
+			if (filler(buffer, e.name.c_str(), e.i != nullptr ? &st : nullptr, e.offset, e.i != nullptr ? &ino : nullptr))
+				return;
+			offset = e.offset;
+		}
 	}
 }
 
@@ -66,6 +101,7 @@ int local_mkdir(shared_ptr<inode> parent_i, std::string new_child_name, mode_t m
 	{
 		std::scoped_lock scl{parent_dentry_table->dentry_table_mutex};
 		parent_dentry_table->create_child_inode(new_child_name, new_i);
+		revoke_create_grants(parent_i->get_ino());
 
 		struct timespec ts{};
 		timespec_get(&ts, TIME_UTC);
@@ -92,7 +128,7 @@ int local_rmdir_top(shared_ptr<inode> target_i, uuid target_ino) {
 
 	{
 		std::scoped_lock scl{target_dentry_table->dentry_table_mutex};
-		if (target_dentry_table->get_child_num() > 0)
+		if (!target_dentry_table->is_empty())
 			return -ENOTEMPTY;
 		journalctl->rmself(target_ino);
 		/* TODO : is it okay to delete dentry_table which is locked? */
@@ -145,6 +181,7 @@ int local_symlink(shared_ptr<inode> dst_parent_i, const char *src, const char *d
 		symlink_i->set_size(static_cast<off_t>(std::string(src).length()));
 
 		dst_parent_dentry_table->create_child_inode(*symlink_name, symlink_i);
+		revoke_create_grants(dst_parent_i->get_ino());
 
 		struct timespec ts{};
 		timespec_get(&ts, TIME_UTC);
@@ -203,6 +240,7 @@ int local_rename_same_parent(shared_ptr<inode> parent_i, const char *old_path, c
 			parent_dentry_table->delete_child_inode(*old_name);
 			journalctl->rmreg(parent_i, *old_name, target_i);
 			parent_dentry_table->create_child_inode(*new_name, target_i);
+			revoke_create_grants(parent_i->get_ino());
 			journalctl->mkreg(parent_i, *new_name, target_i);
 		} else {
 			return -ENOSYS;
@@ -254,6 +292,7 @@ int local_rename_not_same_parent_dst(shared_ptr<inode> dst_parent_i, std::shared
 				/* TODO : is it okay to delete inode which is locked? */
 			}
 			dst_dentry_table->create_child_inode(*new_name, target_inode);
+			revoke_create_grants(dst_parent_i->get_ino());
 			journalctl->mkreg(dst_parent_i, *new_name, target_inode);
 		} else {
 			throw std::runtime_error("NOT IMPLEMENTED");
@@ -304,6 +343,7 @@ void local_create(shared_ptr<inode> parent_i, std::string new_child_name, mode_t
 		std::scoped_lock scl{parent_dentry_table->dentry_table_mutex};
 
 		parent_dentry_table->create_child_inode(new_child_name, i);
+		revoke_create_grants(parent_i->get_ino());
 
 		struct timespec ts{};
 		timespec_get(&ts, TIME_UTC);
@@ -330,7 +370,7 @@ void local_unlink(shared_ptr<inode> parent_i, std::string child_name) {
 		nlink_t nlink = target_i->get_nlink() - 1;
 		if (nlink == 0) {
 			/* data */
-			data_pool->remove(obj_category::DATA, uuid_to_string(target_i->get_ino()));
+			data_pool->remove(obj_category::DATA, uuid_to_string(target_i->get_ino()), target_i->get_size());
 
 			/* parent dentry */
 			parent_dentry_table->delete_child_inode(child_name);
@@ -351,7 +391,7 @@ ssize_t local_read(shared_ptr<inode> i, char *buffer, size_t size, off_t offset)
 	global_logger.log(local_fs_op, "Called read()");
 	size_t read_len = 0;
 
-	read_len = data_pool->read(obj_category::DATA, uuid_to_string(i->get_ino()), buffer, size, offset);
+	read_len = data_pool->read(obj_category::DATA, uuid_to_string(i->get_ino()), buffer, size, offset, i->get_size());
 	return read_len;
 }
 
@@ -448,7 +488,7 @@ int local_truncate(const shared_ptr<inode> i, off_t offset) {
 		if (S_ISDIR(i->get_mode()))
 			return -EISDIR;
 
-		ret = data_pool->truncate(obj_category::DATA, uuid_to_string(i->get_ino()), offset);
+		ret = data_pool->truncate(obj_category::DATA, uuid_to_string(i->get_ino()), offset, i->get_size());
 
 		i->set_size(offset);
 		struct timespec ts{};
@@ -463,3 +503,29 @@ int local_truncate(const shared_ptr<inode> i, off_t offset) {
 	}
 	return ret;
 }
+
+int local_fallocate(shared_ptr<inode> i, int mode, off_t offset, off_t length) {
+	global_logger.log(local_fs_op, "Called fallocate()");
+	{
+		std::scoped_lock scl{i->inode_mutex};
+		if (S_ISDIR(i->get_mode()))
+			return -EISDIR;
+
+		if (mode & FALLOC_FL_PUNCH_HOLE) {
+			if (offset < i->get_size())
+				data_pool->punch_hole(obj_category::DATA, uuid_to_string(i->get_ino()), offset, MIN(length, i->get_size() - offset));
+			return 0;
+		}
+
+		/* Data objects are sparse, so allocating only moves the size */
+		if (!(mode & FALLOC_FL_KEEP_SIZE) && i->get_size() < offset + length) {
+			i->set_size(offset + length);
+			struct timespec ts{};
+			timespec_get(&ts, TIME_UTC);
+			i->set_ctime(ts);
+
+			journalctl->chreg(i->get_p_ino(), i);
+		}
+	}
+	return 0;
+}
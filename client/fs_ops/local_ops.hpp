@@ -9,7 +9,7 @@ void local_getattr(shared_ptr<inode> i, struct stat* stat);
 void local_access(shared_ptr<inode> i, int mask);
 int local_opendir(shared_ptr<inode> i, struct fuse_file_info* file_info);
 int local_releasedir(shared_ptr<inode> i, struct fuse_file_info* file_info);
-void local_readdir(shared_ptr<inode> i, void* buffer, fuse_fill_dir_t filler);
+void local_readdir(shared_ptr<inode> i, void* buffer, fill_dir_t filler, off_t offset = 0, bool plus = false);
 int local_mkdir(shared_ptr<inode> parent_i, std::string new_child_name, mode_t mode, std::shared_ptr<inode>& new_dir_inode, std::shared_ptr<dentry>& new_dir_dentry);
 int local_rmdir_top(shared_ptr<inode> target_i, uuid target_ino);
 int local_rmdir_down(shared_ptr<inode> parent_i, uuid target_ino, std::string target_name);
@@ -28,4 +28,5 @@ void local_chmod(shared_ptr<inode> i, mode_t mode);
 void local_chown(shared_ptr<inode> i, uid_t uid, gid_t gid);
 void local_utimens(shared_ptr<inode> i, const struct timespec tv[2]);
 int local_truncate (shared_ptr<inode> i, off_t offset);
+int local_fallocate(shared_ptr<inode> i, int mode, off_t offset, off_t length);
 #endif //NMFS0_LOCAL_OPS_HPP
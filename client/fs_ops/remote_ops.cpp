@@ -1,13 +1,14 @@
 #include "remote_ops.hpp"
+#include "../in_memory/attr_cache.hpp"
+
+extern std::unique_ptr<attr_cache> remote_attrs;
 
 int remote_getattr(shared_ptr<remote_inode> i, struct stat* stat) {
 	global_logger.log(remote_fs_op, "Called remote_getattr()");
 	if(i == nullptr)
 		throw std::runtime_error("inode casting is failed");
-	std::string remote_address(i->get_address());
-	std::shared_ptr<rpc_client> rc = get_rpc_client(remote_address);
 
-	int ret = rc->getattr(i, stat);
+	int ret = i->fetch_attr(*stat);
 	return ret;
 }
 
@@ -15,11 +16,16 @@ int remote_access(shared_ptr<remote_inode> i, int mask) {
 	global_logger.log(remote_fs_op, "Called remote_access()");
 	if(i == nullptr)
 		throw std::runtime_error("inode casting is failed");
-	std::string remote_address(i->get_address());
-	std::shared_ptr<rpc_client> rc = get_rpc_client(remote_address);
 
-	int ret = rc->access(i, mask);
-	return ret;
+	/* answered from the attributes, which are cached */
+	struct stat attr{};
+	int ret = i->fetch_attr(attr);
+	if (ret != 0)
+		return ret;
+
+	i->set_attr(attr);
+	i->inode::permission_check(mask);
+	return 0;
 }
 
 int remote_opendir(shared_ptr<remote_inode> i, struct fuse_file_info* file_info) {
@@ -33,14 +39,14 @@ int remote_opendir(shared_ptr<remote_inode> i, struct fuse_file_info* file_info)
 	return ret;
 }
 
-int remote_readdir(shared_ptr<remote_inode> i, void* buffer, fuse_fill_dir_t filler) {
+int remote_readdir(shared_ptr<remote_inode> i, void* buffer, fill_dir_t filler, off_t offset, bool plus) {
 	global_logger.log(remote_fs_op, "Called remote_readdir()");
 	if(i == nullptr)
 		throw std::runtime_error("inode casting is failed");
 	std::string remote_address(i->get_address());
 	std::shared_ptr<rpc_client> rc = get_rpc_client(remote_address);
 
-	int ret = rc->readdir(i, buffer, filler);
+	int ret = rc->readdir(i, buffer, filler, offset, plus);
 	return ret;
 }
 
@@ -52,6 +58,7 @@ int remote_mkdir(shared_ptr<remote_inode> parent_i, std::string new_child_name,
 	std::shared_ptr<rpc_client> rc = get_rpc_client(remote_address);
 
 	int ret = rc->mkdir(parent_i, new_child_name, mode, new_dir_inode, new_dir_dentry);
+	remote_attrs->invalidate(parent_i->get_dentry_table_ino());
 	return ret;
 }
 
@@ -63,6 +70,7 @@ int remote_rmdir_top(shared_ptr<remote_inode> target_i, uuid target_ino) {
 	std::shared_ptr<rpc_client> rc = get_rpc_client(remote_address);
 
 	int ret = rc->rmdir_top(target_i, target_ino);
+	remote_attrs->invalidate(target_ino);
 	return ret;
 }
 
@@ -74,6 +82,8 @@ int remote_rmdir_down(shared_ptr<remote_inode> parent_i, uuid target_ino, std::s
 	std::shared_ptr<rpc_client> rc = get_rpc_client(remote_address);
 
 	int ret = rc->rmdir_down(parent_i, target_ino, target_name);
+	remote_attrs->invalidate(parent_i->get_dentry_table_ino());
+	remote_attrs->invalidate(target_ino);
 	return ret;
 }
 
@@ -85,6 +95,7 @@ int remote_symlink(shared_ptr<remote_inode> dst_parent_i, const char *src, const
 	std::shared_ptr<rpc_client> rc = get_rpc_client(remote_address);
 
 	int ret = rc->symlink(dst_parent_i, src, dst);
+	remote_attrs->invalidate(dst_parent_i->get_dentry_table_ino());
 	return ret;
 }
 
@@ -107,6 +118,7 @@ int remote_rename_same_parent(shared_ptr<remote_inode> parent_i, const char* old
 	std::shared_ptr<rpc_client> rc = get_rpc_client(remote_address);
 
 	int ret = rc->rename_same_parent(parent_i, old_path, new_path, flags);
+	remote_attrs->invalidate(parent_i->get_dentry_table_ino());
 	return ret;
 }
 
@@ -118,6 +130,9 @@ int remote_rename_not_same_parent_src(shared_ptr<remote_inode> src_parent_i, con
 	std::shared_ptr<rpc_client> rc = get_rpc_client(remote_address);
 
 	int ret = rc->rename_not_same_parent_src(src_parent_i, old_path, flags, target_inode);
+	remote_attrs->invalidate(src_parent_i->get_dentry_table_ino());
+	if (target_inode != nullptr)
+		remote_attrs->invalidate(target_inode->get_ino());
 	return ret;
 }
 
@@ -129,6 +144,7 @@ int remote_rename_not_same_parent_dst(shared_ptr<remote_inode> dst_parent_i, std
 	std::shared_ptr<rpc_client> rc = get_rpc_client(remote_address);
 
 	int ret = rc->rename_not_same_parent_dst(dst_parent_i, target_inode, check_dst_ino, new_path, flags);
+	remote_attrs->invalidate(dst_parent_i->get_dentry_table_ino());
 	return ret;
 }
 
@@ -151,6 +167,7 @@ int remote_create(shared_ptr<remote_inode> parent_i, std::string new_child_name,
 	std::shared_ptr<rpc_client> rc = get_rpc_client(remote_address);
 
 	int ret = rc->create(parent_i, new_child_name, mode, file_info);
+	remote_attrs->invalidate(parent_i->get_dentry_table_ino());
 	return ret;
 }
 
@@ -162,17 +179,19 @@ int remote_unlink(shared_ptr<remote_inode> parent_i, std::string child_name) {
 	std::shared_ptr<rpc_client> rc = get_rpc_client(remote_address);
 
 	int ret = rc->unlink(parent_i, child_name);
+	remote_attrs->invalidate(parent_i->get_dentry_table_ino());
 	return ret;
 }
 
-ssize_t remote_write(shared_ptr<remote_inode> i, const char* buffer, size_t size, off_t offset, int flags) {
+ssize_t remote_write(shared_ptr<remote_inode> i, const char* buffer, size_t size, off_t offset, int flags, bool *leader_caches) {
 	global_logger.log(remote_fs_op, "Called remote_write()");
 	if(i == nullptr)
 		throw std::runtime_error("inode casting is failed");
 	std::string remote_address(i->get_address());
 	std::shared_ptr<rpc_client> rc = get_rpc_client(remote_address);
 
-	ssize_t written_len = rc->write(i, buffer, size, offset, flags);
+	ssize_t written_len = rc->write(i, buffer, size, offset, flags, leader_caches);
+	remote_attrs->invalidate(i->get_ino());
 	return written_len;
 }
 
@@ -184,6 +203,7 @@ int remote_chmod(shared_ptr<remote_inode> i, mode_t mode) {
 	std::shared_ptr<rpc_client> rc = get_rpc_client(remote_address);
 
 	int ret = rc->chmod(i, mode);
+	remote_attrs->invalidate(i->get_ino());
 	return ret;
 }
 
@@ -195,6 +215,7 @@ int remote_chown(shared_ptr<remote_inode> i, uid_t uid, gid_t gid) {
 	std::shared_ptr<rpc_client> rc = get_rpc_client(remote_address);
 
 	int ret = rc->chown(i, uid, gid);
+	remote_attrs->invalidate(i->get_ino());
 	return ret;
 }
 
@@ -206,6 +227,7 @@ int remote_utimens(shared_ptr<remote_inode> i, const struct timespec tv[2]) {
 	std::shared_ptr<rpc_client> rc = get_rpc_client(remote_address);
 
 	int ret = rc->utimens(i, tv);
+	remote_attrs->invalidate(i->get_ino());
 	return ret;
 }
 
@@ -217,5 +239,28 @@ int remote_truncate (shared_ptr<remote_inode> i, off_t offset) {
 	std::shared_ptr<rpc_client> rc = get_rpc_client(remote_address);
 
 	int ret = rc->truncate(i, offset);
+	remote_attrs->invalidate(i->get_ino());
 	return ret;
-}
\ No newline at end of file
+}
+
+int remote_fallocate(shared_ptr<remote_inode> i, int mode, off_t offset, off_t length) {
+	global_logger.log(remote_fs_op, "Called remote_fallocate()");
+	if(i == nullptr)
+		throw std::runtime_error("inode casting is failed");
+	std::string remote_address(i->get_address());
+	std::shared_ptr<rpc_client> rc = get_rpc_client(remote_address);
+
+	int ret = rc->fallocate(i, mode, offset, length);
+	remote_attrs->invalidate(i->get_ino());
+	return ret;
+}
+
+int remote_create_error(shared_ptr<remote_inode> i, bool forget) {
+	global_logger.log(remote_fs_op, "Called remote_create_error()");
+	if(i == nullptr)
+		throw std::runtime_error("inode casting is failed");
+	std::string remote_address(i->get_address());
+	std::shared_ptr<rpc_client> rc = get_rpc_client(remote_address);
+
+	return rc->create_error(i->get_dentry_table_ino(), i->get_ino(), forget);
+}
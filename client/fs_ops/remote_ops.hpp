@@ -10,7 +10,7 @@
 int remote_getattr(shared_ptr<remote_inode> i, struct stat* stat);
 int remote_access(shared_ptr<remote_inode> i, int mask);
 int remote_opendir(shared_ptr<remote_inode> i, struct fuse_file_info* file_info);
-int remote_readdir(shared_ptr<remote_inode> i, void* buffer, fuse_fill_dir_t filler);
+int remote_readdir(shared_ptr<remote_inode> i, void* buffer, fill_dir_t filler, off_t offset = 0, bool plus = false);
 int remote_mkdir(shared_ptr<remote_inode> parent_i, std::string new_child_name, mode_t mode, std::shared_ptr<inode>& new_dir_inode, std::shared_ptr<dentry>& new_dir_dentry);
 int remote_rmdir_top(shared_ptr<remote_inode> target_i, uuid target_ino);
 int remote_rmdir_down(shared_ptr<remote_inode> parent_i, uuid target_ino, std::string target_name);
@@ -22,10 +22,14 @@ int remote_rename_not_same_parent_dst(shared_ptr<remote_inode> dst_parent_i, std
 int remote_open(shared_ptr<remote_inode> i, struct fuse_file_info* file_info);
 int remote_create(shared_ptr<remote_inode> parent_i, std::string new_child_name, mode_t mode, struct fuse_file_info* file_info);
 int remote_unlink(shared_ptr<remote_inode> parent_i, std::string child_name);
-ssize_t remote_write(shared_ptr<remote_inode>i, const char* buffer, size_t size, off_t offset, int flags);
+ssize_t remote_write(shared_ptr<remote_inode>i, const char* buffer, size_t size, off_t offset, int flags, bool *leader_caches = nullptr);
 int remote_chmod(shared_ptr<remote_inode> i, mode_t mode);
 int remote_chown(shared_ptr<remote_inode> i, uid_t uid, gid_t gid);
 int remote_utimens(shared_ptr<remote_inode> i, const struct timespec tv[2]);
 int remote_truncate (shared_ptr<remote_inode> i, off_t offset);
+int remote_fallocate(shared_ptr<remote_inode> i, int mode, off_t offset, off_t length);
+/* The error of a create answered without the leader (-o async_creates), 0 if it went through,
+   reported until it is forgotten on release */
+int remote_create_error(shared_ptr<remote_inode> i, bool forget = false);
 
 #endif //NMFS0_REMOTE_OPS_HPP
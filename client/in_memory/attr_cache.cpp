@@ -0,0 +1,57 @@
+#include "attr_cache.hpp"
+#include "../../lib/logger/logger.hpp"
+
+attr_cache::attr_cache(milliseconds ttl) : ttl(ttl), gen(0)
+{
+}
+
+uint64_t attr_cache::get_gen(void)
+{
+	std::shared_lock lock(sm);
+	return gen;
+}
+
+bool attr_cache::get(const uuid &ino, struct stat &attr)
+{
+	std::shared_lock lock(sm);
+
+	auto it = attrs.find(ino);
+	if (it == attrs.end() || system_clock::now() >= it->second.due)
+		return false;
+
+	attr = it->second.attr;
+	return true;
+}
+
+void attr_cache::put(const uuid &ino, const struct stat &attr, milliseconds lease_left, uint64_t fetched_gen)
+{
+	if (ino.is_nil() || ttl.count() == 0 || lease_left.count() <= 0)
+		return;
+
+	std::unique_lock lock(sm);
+
+	if (fetched_gen != gen)
+		return;
+
+	if (attrs.size() >= ATTR_CACHE_MAX_ENTRIES) {
+		global_logger.log(remote_fs_op, "attr cache is full, drop every entry");
+		attrs.clear();
+	}
+	attrs[ino] = {attr, system_clock::now() + std::min(ttl, lease_left)};
+}
+
+void attr_cache::invalidate(const uuid &ino)
+{
+	std::unique_lock lock(sm);
+
+	attrs.erase(ino);
+	gen++;
+}
+
+void attr_cache::invalidate_all(void)
+{
+	std::unique_lock lock(sm);
+
+	attrs.clear();
+	gen++;
+}
@@ -0,0 +1,57 @@
+#ifndef NMFS0_ATTR_CACHE_HPP
+#define NMFS0_ATTR_CACHE_HPP
+
+#include <chrono>
+#include <shared_mutex>
+
+#include <sys/stat.h>
+
+#include <boost/functional/hash.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <tsl/robin_map.h>
+
+using namespace std::chrono;
+using namespace boost::uuids;
+
+/* The whole table is dropped when it grows past this */
+#define ATTR_CACHE_MAX_ENTRIES 65536
+
+/* -o attr_ttl when it isn't given, in milliseconds */
+#define DEFAULT_ATTR_TTL_MS 1000
+
+/*
+ * Attributes of the inodes in directories led by other clients, by ino.
+ * An entry is good for the TTL or until the lease of the leader which sent it expires,
+ * whichever comes first. Changes made through this client invalidate it,
+ * the ones made by others are seen once it expires.
+ */
+class attr_cache {
+private:
+	struct entry {
+		struct stat attr;
+		system_clock::time_point due;
+	};
+
+	std::shared_mutex sm;
+	tsl::robin_map<uuid, entry, boost::hash<uuid>> attrs;
+	milliseconds ttl;
+
+	/* Bumped by every invalidation, attributes fetched under an older one aren't cached */
+	uint64_t gen;
+
+public:
+	/* a zero ttl turns the cache off */
+	explicit attr_cache(milliseconds ttl);
+	~attr_cache(void) = default;
+
+	uint64_t get_gen(void);
+
+	bool get(const uuid &ino, struct stat &attr);
+	/* lease_left : how long the lease of the leader lasts */
+	void put(const uuid &ino, const struct stat &attr, milliseconds lease_left, uint64_t fetched_gen);
+
+	void invalidate(const uuid &ino);
+	void invalidate_all(void);
+};
+
+#endif //NMFS0_ATTR_CACHE_HPP
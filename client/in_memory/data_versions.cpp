@@ -0,0 +1,24 @@
+#include "data_versions.hpp"
+
+#include <boost/functional/hash.hpp>
+
+data_versions::data_versions(void)
+{
+	for (auto &v : versions)
+		v.store(0);
+}
+
+std::atomic<uint64_t> &data_versions::slot(const uuid &ino)
+{
+	return versions[boost::hash<uuid>()(ino) % DATA_VERSION_SLOTS];
+}
+
+uint64_t data_versions::get(const uuid &ino)
+{
+	return slot(ino).load();
+}
+
+void data_versions::bump(const uuid &ino)
+{
+	slot(ino).fetch_add(1);
+}
@@ -0,0 +1,35 @@
+#ifndef NMFS0_DATA_VERSIONS_HPP
+#define NMFS0_DATA_VERSIONS_HPP
+
+#include <atomic>
+#include <cstdint>
+
+#include <boost/uuid/uuid.hpp>
+
+using namespace boost::uuids;
+
+/* Number of counters the inos are spread over */
+#define DATA_VERSION_SLOTS 4096
+
+/*
+ * The version of the data of the files on this client, by ino, shared by every inode
+ * instance of a file so a write through one is seen by the read ahead of another.
+ * The inos hash onto a fixed number of counters, so a write may also drop the read ahead
+ * of an unrelated file, which costs a read but never serves stale data.
+ */
+class data_versions {
+private:
+	std::atomic<uint64_t> versions[DATA_VERSION_SLOTS];
+
+	std::atomic<uint64_t> &slot(const uuid &ino);
+
+public:
+	data_versions(void);
+	~data_versions(void) = default;
+
+	uint64_t get(const uuid &ino);
+	/* Called on every write, truncate or hole punched in ino */
+	void bump(const uuid &ino);
+};
+
+#endif //NMFS0_DATA_VERSIONS_HPP
@@ -1,4 +1,8 @@
 #include "dentry_table.hpp"
+#include "directory_table.hpp"
+
+extern struct mount_options nmfs_options;
+extern std::unique_ptr<directory_table> indexing_table;
 
 dentry_table::not_leader::not_leader(const string &msg) : runtime_error(msg) {
 
@@ -37,11 +41,17 @@ dentry_table::~dentry_table() {
 int dentry_table::create_child_inode(std::string filename, shared_ptr<inode> inode){
 	global_logger.log(dentry_table_ops, "Called create_child_ino(" + filename + ")");
 
+	if (!this->dentries->get_child_ino(filename).is_nil()) {
+		global_logger.log(dentry_table_ops, "Already added file is tried to inserted");
+		return -1;
+	}
+
 	auto ret = this->child_inodes.insert(std::make_pair(filename, nullptr));
 	if (ret.second) {
 		ret.first->second = inode;
 
 		this->dentries->add_child(filename, inode->get_ino());
+		indexing_table->invalidate_negative_lookup(this->dir_ino, filename);
 		//this->dentries->sync();
 	} else {
 		global_logger.log(dentry_table_ops, "Already added file is tried to inserted");
@@ -67,13 +77,13 @@ int dentry_table::add_child_inode(std::string filename, shared_ptr<inode> inode)
 int dentry_table::delete_child_inode(std::string filename) {
 	global_logger.log(dentry_table_ops, "Called delete_child_inode(" + filename + ")");
 
-	auto it = this->child_inodes.find(filename);
-	if (it == this->child_inodes.end()) {
+	if (this->dentries->get_child_ino(filename).is_nil()) {
 		global_logger.log(dentry_table_ops, "Non-existing file is tried to deleted");
 		return -1;
 	}
 	/* TODO : get a lock of delete child inode */
-	this->child_inodes.erase(it);
+	this->child_inodes.erase(filename);
+	indexing_table->invalidate_lookup(this->dir_ino, filename);
 
 	this->dentries->delete_child(filename);
 	//this->dentries->sync();
@@ -87,7 +97,14 @@ shared_ptr<inode> dentry_table::get_child_inode(std::string filename, uuid targe
 	if(this->get_loc() == LOCAL) {
 		auto it = this->child_inodes.find(filename);
 		if(it == this->child_inodes.end()) {
-			throw inode::no_entry("No such file or directory : get_child_inode");
+			/* The fragment holding the name is loaded if it hasn't been */
+			uuid child_ino = this->dentries->get_child_ino(filename);
+			if (child_ino.is_nil())
+				throw inode::no_entry("No such file or directory : get_child_inode");
+
+			shared_ptr<inode> child_i = std::make_shared<inode>(child_ino);
+			child_i->set_p_ino(this->dir_ino);
+			it = this->child_inodes.insert(std::make_pair(filename, child_i)).first;
 		}
 		it->second->set_loc(LOCAL);
 		return it->second;
@@ -120,25 +137,60 @@ uuid dentry_table::check_child_inode(std::string filename){
 	return nil_uuid();
 }
 
+int dentry_table::resolve_path(const std::vector<std::string> &names, std::vector<resolved_component> &components){
+	global_logger.log(dentry_table_ops, "Called resolve_path(" + names.front() + ", ...)");
+
+	if (this->loc != REMOTE)
+		throw std::runtime_error("resolve_path() is called on a LOCAL dentry table");
+
+	std::string remote_address(this->leader_ip);
+	std::shared_ptr<rpc_client> rc = get_rpc_client(remote_address);
+
+	return rc->resolve_path(this->dir_ino, names, components);
+}
+
 int dentry_table::pull_child_metadata() {
 	global_logger.log(dentry_table_ops, "Called pull_child_metadata()");
 
+	/* The fragments and the child inodes are loaded when they are looked up */
 	this->dentries = std::make_shared<dentry>(this->dir_ino);
 
-	for(auto it = this->dentries->child_list.begin(); it != this->dentries->child_list.end(); it++) {
-		shared_ptr<inode> child_i = std::make_shared<inode>(it->second);
-		child_i->set_p_ino(this->dir_ino);
-		if(S_ISDIR(child_i->get_mode())){
-			child_i->set_loc(UNKNOWN);
-		} else {
-			child_i->set_loc(LOCAL);
-		}
-		this->add_child_inode(it->first, child_i);
-	}
+	if (nmfs_options.prefetch_batch > 0)
+		this->prefetch_child_inodes(nmfs_options.prefetch_batch);
 
 	return 0;
 }
 
+void dentry_table::prefetch_child_inodes(size_t batch_size) {
+	global_logger.log(dentry_table_ops, "Called prefetch_child_inodes(" + std::to_string(batch_size) + ")");
+
+	std::vector<std::string> names;
+	std::vector<uuid> inos;
+	this->dentries->for_each_child([this, &names, &inos](const std::string &name, const uuid &ino) {
+		if (this->child_inodes.find(name) == this->child_inodes.end()) {
+			names.push_back(name);
+			inos.push_back(ino);
+		}
+	});
+
+	this->load_child_inodes(names, inos, batch_size);
+}
+
+void dentry_table::load_child_inodes(const std::vector<std::string> &names, const std::vector<uuid> &inos, size_t batch_size) {
+	for (size_t start = 0; start < inos.size(); start += batch_size) {
+		size_t end = std::min(start + batch_size, inos.size());
+		std::vector<uuid> batch(inos.begin() + start, inos.begin() + end);
+
+		std::vector<shared_ptr<inode>> child_inodes = inode::load_batch(batch);
+		for (size_t n = 0; n < child_inodes.size(); n++) {
+			if (child_inodes[n] == nullptr)
+				continue;
+
+			child_inodes[n]->set_p_ino(this->dir_ino);
+			this->add_child_inode(names[start + n], child_inodes[n]);
+		}
+	}
+}
 
 enum meta_location dentry_table::get_loc() {
 	return this->loc;
@@ -148,20 +200,54 @@ void dentry_table::set_leader_ip(std::string new_leader_ip) {
 	this->leader_ip = new_leader_ip;
 }
 
-void dentry_table::fill_filler(void *buffer, fuse_fill_dir_t filler) {
-	this->dentries->fill_filler(buffer, filler);
+bool dentry_table::list_children(off_t offset, size_t max, bool plus, std::vector<readdir_entry> &entries) {
+	global_logger.log(dentry_table_ops, "Called list_children(" + std::to_string(offset) + ")");
+
+	std::vector<uuid> inos;
+	bool more = this->dentries->for_each_child_from(offset, max, [&entries, &inos](const std::string &name, const uuid &ino, off_t child_offset) {
+		entries.push_back({name, child_offset, nullptr});
+		inos.push_back(ino);
+	});
+
+	if (!plus)
+		return more;
+
+	/* The child inodes which haven't been looked up are read in batches rather than one by one */
+	std::vector<std::string> missing_names;
+	std::vector<uuid> missing_inos;
+	for (size_t n = 0; n < entries.size(); n++) {
+		if (this->child_inodes.find(entries[n].name) == this->child_inodes.end()) {
+			missing_names.push_back(entries[n].name);
+			missing_inos.push_back(inos[n]);
+		}
+	}
+	this->load_child_inodes(missing_names, missing_inos, nmfs_options.prefetch_batch > 0 ? nmfs_options.prefetch_batch : READDIRPLUS_PREFETCH_BATCH);
+
+	for (size_t n = 0; n < entries.size(); n++) {
+		try {
+			entries[n].i = this->get_child_inode(entries[n].name, inos[n]);
+		} catch (inode::no_entry &e) {
+			entries[n].i = nullptr;
+		}
+	}
+
+	return more;
+}
+
+void dentry_table::for_each_child(const std::function<void(const std::string &, const uuid &)> &fn) {
+	this->dentries->for_each_child(fn);
 }
 
 uint64_t dentry_table::get_child_num() {
 	return this->dentries->get_child_num();
 }
 
-std::map<std::string, shared_ptr<inode>>::iterator dentry_table::get_child_inode_begin() {
-	return this->child_inodes.begin();
+uint64_t dentry_table::count_upto(uint64_t limit) {
+	return this->dentries->count_upto(limit);
 }
 
-std::map<std::string, shared_ptr<inode>>::iterator dentry_table::get_child_inode_end() {
-	return this->child_inodes.end();
+bool dentry_table::is_empty() {
+	return this->dentries->is_empty();
 }
 
 uuid dentry_table::get_dir_ino(){
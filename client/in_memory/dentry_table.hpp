@@ -4,23 +4,40 @@
 #include <map>
 #include <utility>
 #include <memory>
+#include <vector>
 #include "../meta/inode.hpp"
 #include "../meta/dentry.hpp"
 #include "../rpc/rpc_client.hpp"
 
 using std::shared_ptr;
 
+/* child inodes read at once for a readdirplus */
+#define READDIRPLUS_PREFETCH_BATCH 128
+
+/* Entries listed under one hold of dentry_table_mutex by a readdir */
+#define READDIR_BATCH 256
+
+struct readdir_entry {
+	std::string name;
+	off_t offset;
+	/* only for readdirplus, nullptr if the inode couldn't be read */
+	shared_ptr<inode> i;
+};
+
 class dentry_table {
 private:
 	uuid dir_ino;
 	shared_ptr<inode> this_dir_inode;
 
 	shared_ptr<dentry> dentries;
+	/* the child inodes looked up so far */
 	std::map<std::string, shared_ptr<inode>> child_inodes;
 
 	enum meta_location loc;
 	std::string leader_ip;
 
+	void load_child_inodes(const std::vector<std::string> &names, const std::vector<uuid> &inos, size_t batch_size);
+
 public:
 	std::recursive_mutex dentry_table_mutex;
 
@@ -35,13 +52,17 @@ public:
 	~dentry_table();
 
 	int create_child_inode(std::string filename, shared_ptr<inode> inode);
-	/* Just used in pull_child_metadata */
+	/* Just used in prefetch_child_inodes */
  	int add_child_inode(std::string filename, shared_ptr<inode> inode);
 	int delete_child_inode(std::string filename);
 
 	shared_ptr<inode> get_child_inode(std::string filename, uuid target_ino = nil_uuid());
 	uuid check_child_inode(std::string filename);
+	/* REMOTE only, see rpc_client::resolve_path() */
+	int resolve_path(const std::vector<std::string> &names, std::vector<resolved_component> &components);
 	int pull_child_metadata();
+	/* Reads the child inodes which haven't been looked up, batch_size of them at a time */
+	void prefetch_child_inodes(size_t batch_size);
 
 	enum meta_location get_loc();
 
@@ -51,13 +72,15 @@ public:
 
 	void set_leader_ip(std::string new_leader_ip);
 
+	/* Lists at most max children after offset (see dentry::for_each_child_from),
+	   with their inodes for readdirplus, and returns whether there are more */
+	bool list_children(off_t offset, size_t max, bool plus, std::vector<readdir_entry> &entries);
+
 	/* wrapper of dentry class member functions */
-	void fill_filler(void *buffer, fuse_fill_dir_t filler);
+	void for_each_child(const std::function<void(const std::string &, const uuid &)> &fn);
 	uint64_t get_child_num();
-
-	/* only used in rpc_readdir */
-	std::map<std::string, shared_ptr<inode>>::iterator get_child_inode_begin();
-	std::map<std::string, shared_ptr<inode>>::iterator get_child_inode_end();
+	uint64_t count_upto(uint64_t limit);
+	bool is_empty();
 };
 
 #endif //NMFS0_DENTRY_TABLE_HPP
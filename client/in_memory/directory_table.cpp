@@ -1,7 +1,11 @@
 #include "directory_table.hpp"
+#include "kernel_cache.hpp"
 
-extern std::unique_ptr<lease_client> lc;
+extern std::shared_ptr<lease_client> lc;
+extern std::unique_ptr<attr_cache> remote_attrs;
 extern std::unique_ptr<journal> journalctl;
+extern std::unique_ptr<kernel_cache> kernel_caches;
+extern struct mount_options nmfs_options;
 
 static int set_name_bound(int &start_name, int &end_name, const std::string &path, int path_len){
 	start_name = end_name + 2;
@@ -21,6 +25,21 @@ static int set_name_bound(int &start_name, int &end_name, const std::string &pat
 	return 0;
 }
 
+/* A table is good while the lease is valid, a local one only while this client is the leader */
+static bool holds_lease(const shared_ptr<dentry_table> &dtable) {
+	uuid ino = dtable->get_dir_ino();
+	return lc->is_valid(ino) && (dtable->get_loc() != LOCAL || lc->is_mine(ino));
+}
+
+/* A lookup in a directory is cached while the lease is valid, and attr_ttl_ms at most
+   when another client leads it since that one changes it without telling */
+static system_clock::time_point lookup_due(const shared_ptr<dentry_table> &dtable) {
+	system_clock::time_point due = lc->get_due(dtable->get_dir_ino());
+	if (dtable->get_loc() == REMOTE)
+		due = std::min(due, system_clock::now() + milliseconds(nmfs_options.attr_ttl_ms));
+	return due;
+}
+
 directory_table::directory_table() {
 	shared_ptr<dentry_table> root_dentry_table = this->get_dentry_table(get_root_ino());
 }
@@ -34,11 +53,79 @@ directory_table::~directory_table() {
 }
 
 shared_ptr<inode> directory_table::path_traversal(const std::string &path) {
+	shared_ptr<inode> target_inode = this->try_path_traversal(path);
+	if (target_inode == nullptr)
+		throw inode::no_entry("No such file or Directory: in path traversal");
+
+	return target_inode;
+}
+
+shared_ptr<inode> directory_table::try_path_traversal(const std::string &path) {
 	global_logger.log(directory_table_ops, "Called path_traverse(" + path + ")");
 
-	shared_ptr<dentry_table> parent_dentry_table = this->get_dentry_table(get_root_ino());
-	shared_ptr<inode> target_inode = parent_dentry_table->get_this_dir_inode();;
-	uuid check_target_ino;
+	uint64_t gen, entry_gen;
+	std::tie(gen, entry_gen) = this->lookups.get_gen();
+
+	lookup_cache::path_entry cached_path;
+	if (this->lookups.get_path(path, cached_path)) {
+		global_logger.log(directory_table_ops, "path cache : HIT");
+		return this->get_inode(cached_path.parent_ino, cached_path.name, cached_path.ino, cached_path.mode);
+	}
+
+	lookup_cache::path_entry found;
+	shared_ptr<inode> target_inode = this->walk(this->get_dentry_table(get_root_ino()), path, entry_gen, found);
+	if (target_inode != nullptr && !found.parent_ino.is_nil()) {
+		found.gen = gen;
+		this->lookups.put_path(path, found);
+	}
+
+	return target_inode;
+}
+
+shared_ptr<inode> directory_table::try_lookup(uuid parent_ino, const std::string &name, mode_t &mode) {
+	global_logger.log(directory_table_ops, "Called try_lookup(" + uuid_to_string(parent_ino) + ", " + name + ")");
+
+	uint64_t entry_gen;
+	std::tie(std::ignore, entry_gen) = this->lookups.get_gen();
+
+	lookup_cache::path_entry found;
+	shared_ptr<inode> target_inode = this->walk(this->get_dentry_table(parent_ino), "/" + name, entry_gen, found);
+	if (target_inode != nullptr)
+		mode = found.mode;
+
+	return target_inode;
+}
+
+shared_ptr<inode> directory_table::get_inode(uuid parent_ino, const std::string &name, uuid ino, mode_t mode) {
+	if (S_ISDIR(mode))
+		return this->get_dentry_table(ino)->get_this_dir_inode();
+
+	shared_ptr<dentry_table> parent_dentry_table = this->get_dentry_table(parent_ino);
+	std::scoped_lock scl{parent_dentry_table->dentry_table_mutex};
+	shared_ptr<inode> target_inode = parent_dentry_table->get_child_inode(name, ino);
+	/* the name has been given to another inode since */
+	if (target_inode->get_ino() != ino)
+		throw inode::no_entry("No such file or Directory: in get_inode");
+	if (parent_dentry_table->get_loc() == REMOTE)
+		target_inode->set_mode(mode);
+	return target_inode;
+}
+
+shared_ptr<inode> directory_table::walk(shared_ptr<dentry_table> parent_dentry_table, const std::string &path, uint64_t entry_gen,
+					lookup_cache::path_entry &found) {
+	shared_ptr<inode> target_inode = parent_dentry_table->get_this_dir_inode();
+	uuid &check_target_ino = found.ino;
+
+	/* what goes into the path cache */
+	uuid &last_parent_ino = found.parent_ino;
+	std::string &target_name = found.name;
+	mode_t &target_mode = found.mode;
+	system_clock::time_point &path_due = found.due;
+	check_target_ino = nil_uuid();
+	last_parent_ino = nil_uuid();
+	target_mode = 0;
+	path_due = system_clock::time_point::max();
+	found.via.clear();
 
 	int start_name, end_name = -1;
 	int path_len = static_cast<int>(path.length());
@@ -48,15 +135,119 @@ shared_ptr<inode> directory_table::path_traversal(const std::string &path) {
 		if(set_name_bound(start_name, end_name, path, path_len) == -1)
 			break;
 
-		std::string target_name = path.substr(start_name, end_name - start_name + 1);
+		/* a name follows one which is not a directory */
+		if (!check_target_ino.is_nil() && !S_ISDIR(target_mode))
+			throw inode::not_directory("Not a directory: in path traversal");
+
+		target_name = path.substr(start_name, end_name - start_name + 1);
 		global_logger.log(directory_table_ops, "Check target: " + target_name);
 		{
-			std::scoped_lock scl{parent_dentry_table->dentry_table_mutex};
+			/* held only while the table is read here, never across an RPC */
+			std::unique_lock lock{parent_dentry_table->dentry_table_mutex};
+			last_parent_ino = parent_dentry_table->get_dir_ino();
+			system_clock::time_point parent_due = lookup_due(parent_dentry_table);
+			path_due = std::min(path_due, parent_due);
+
+			lookup_cache::entry cached;
+			if (this->lookups.get(last_parent_ino, target_name, cached)) {
+				global_logger.log(directory_table_ops, "lookup cache : HIT");
+				if (cached.ino.is_nil())
+					return nullptr;
+
+				check_target_ino = cached.ino;
+				target_mode = cached.mode;
+				path_due = std::min(path_due, cached.due);
+				found.via.emplace_back(last_parent_ino, target_name);
+
+				/* The permission has been checked when the entry was cached. */
+				if (S_ISDIR(target_mode)) {
+					lock.unlock();
+					if (!this->has_dentry_table(check_target_ino)) {
+						this->lease_predicted_dentry_tables(check_target_ino, path, end_name);
+					}
+					parent_dentry_table = this->get_dentry_table(check_target_ino);
+					target_inode = parent_dentry_table->get_this_dir_inode();
+				} else {
+					target_inode = parent_dentry_table->get_child_inode(target_name, check_target_ino);
+					if (parent_dentry_table->get_loc() == REMOTE)
+						target_inode->set_mode(target_mode);
+				}
+				continue;
+			}
+
+			if (parent_dentry_table->get_loc() == REMOTE) {
+				lock.unlock();
+				/* The leader resolves as many names as it leads in one RPC */
+				std::vector<std::string> names{target_name};
+				std::vector<int> name_ends{end_name};
+				int next_start = start_name, next_end = end_name;
+				while (set_name_bound(next_start, next_end, path, path_len) != -1) {
+					names.push_back(path.substr(next_start, next_end - next_start + 1));
+					name_ends.push_back(next_end);
+				}
+
+				std::vector<resolved_component> components;
+				uint64_t attr_gen = remote_attrs->get_gen();
+				int ret = parent_dentry_table->resolve_path(names, components);
+				if (ret == 0 && components.empty())
+					throw std::runtime_error("Leader resolved nothing in path_traversal()");
+
+				/* The directories on the way are leased together */
+				std::vector<uuid> dir_inos;
+				for (const resolved_component &c : components)
+					if (S_ISDIR(c.attr.st_mode))
+						dir_inos.push_back(c.ino);
+				this->lease_dentry_tables(dir_inos);
+
+				for (size_t k = 0; k < components.size(); k++) {
+					const resolved_component &c = components[k];
+					if (k > 0) {
+						last_parent_ino = check_target_ino;
+						parent_due = lookup_due(parent_dentry_table);
+						path_due = std::min(path_due, parent_due);
+					}
+
+					target_name = names[k];
+					end_name = name_ends[k];
+					check_target_ino = c.ino;
+					target_mode = c.attr.st_mode;
+					remote_attrs->put(check_target_ino, c.attr, c.lease_left, attr_gen);
+					if (S_ISDIR(target_mode)) {
+						parent_dentry_table = this->get_dentry_table(check_target_ino);
+						target_inode = parent_dentry_table->get_this_dir_inode();
+						if (parent_dentry_table->get_loc() == REMOTE)
+							std::dynamic_pointer_cast<remote_inode>(target_inode)->set_attr(c.attr);
+						if (!c.searchable)
+							target_inode->permission_check(X_OK);
+					} else {
+						target_inode = parent_dentry_table->get_child_inode(target_name, check_target_ino);
+						if (parent_dentry_table->get_loc() == REMOTE)
+							std::dynamic_pointer_cast<remote_inode>(target_inode)->set_attr(c.attr);
+					}
+
+					this->lookups.put(last_parent_ino, target_name, {check_target_ino, target_mode, parent_due}, entry_gen);
+					found.via.emplace_back(last_parent_ino, target_name);
+				}
+
+				if (ret == -ENOENT) {
+					if (!components.empty())
+						last_parent_ino = check_target_ino;
+					this->lookups.put(last_parent_ino, names[components.size()], {nil_uuid(), 0, lookup_due(parent_dentry_table)}, entry_gen);
+					return nullptr;
+				} else if (ret == -ENOTDIR) {
+					throw inode::not_directory("Not a directory: in path traversal");
+				} else if (ret == -EACCES) {
+					throw inode::permission_denied("Permission Denied: in path traversal");
+				}
+				continue;
+			}
+
 			check_target_ino = parent_dentry_table->check_child_inode(target_name);
 
-			if (check_target_ino.is_nil())
-				throw inode::no_entry("No such file or Directory: in path traversal");
-			else
+			if (check_target_ino.is_nil()) {
+				this->lookups.put(last_parent_ino, target_name, {nil_uuid(), 0, lookup_due(parent_dentry_table)}, entry_gen);
+				return nullptr;
+			} else
 				/* if target is dir, this child is just for checking mode.
 				 * if target is reg, this child is actual inode */
 				target_inode = parent_dentry_table->get_child_inode(target_name, check_target_ino);
@@ -64,11 +255,16 @@ shared_ptr<inode> directory_table::path_traversal(const std::string &path) {
 			if(target_inode == nullptr)
 				throw std::runtime_error("Failed to make remote_inode in path_traversal()");
 
-			if (S_ISDIR(target_inode->get_mode())) {
+			target_mode = target_inode->get_mode();
+			if (S_ISDIR(target_mode)) {
+				lock.unlock();
 				parent_dentry_table = this->get_dentry_table(check_target_ino);
 				target_inode = parent_dentry_table->get_this_dir_inode();
 				target_inode->permission_check(X_OK);
 			}
+
+			this->lookups.put(last_parent_ino, target_name, {check_target_ino, target_mode, parent_due}, entry_gen);
+			found.via.emplace_back(last_parent_ino, target_name);
 		}
 	}
 
@@ -81,17 +277,50 @@ shared_ptr<dentry_table> directory_table::lease_dentry_table(uuid ino){
 
 	std::string temp_address;
 	int ret = lc->acquire(ino, temp_address);
+	return this->set_up_dentry_table(ino, ret, temp_address);
+}
+
+void directory_table::lease_dentry_tables(const std::vector<uuid> &inos){
+	global_logger.log(directory_table_ops, "Called lease_dentry_tables(" + std::to_string(inos.size()) + " dirs)");
+	std::scoped_lock scl{this->directory_table_mutex};
+
+	std::vector<uuid> missing;
+	for (const uuid &ino : inos) {
+		auto it = this->dentry_tables.find(ino);
+		if (it != this->dentry_tables.end()) {
+			if (holds_lease(it->second))
+				continue;
+			this->dentry_tables.erase(it);
+			kernel_caches->invalidate_dir(ino);
+		}
+		if (std::find(missing.begin(), missing.end(), ino) == missing.end())
+			missing.push_back(ino);
+	}
+
+	/* A single one is leased when it is reached */
+	if (missing.size() < 2)
+		return;
+
+	std::vector<int> rets;
+	std::vector<std::string> temp_addresses;
+	lc->acquire_all(missing, rets, temp_addresses);
+	for (size_t n = 0; n < missing.size(); n++)
+		this->set_up_dentry_table(missing[n], rets[n], temp_addresses[n]);
+}
+
+shared_ptr<dentry_table> directory_table::set_up_dentry_table(uuid ino, int ret, const std::string &temp_address){
 	shared_ptr<dentry_table> new_dentry_table = nullptr;
 	if(ret == 0) {
 		global_logger.log(directory_table_ops, "Success to acquire lease");
-		/* Check whether the directory needs recovery */
-		//journalctl->check(ino);
+		/* What the last leader committed but didn't checkpoint goes in before the directory is loaded */
+		journalctl->check(ino);
 
 		/* Success to acquire lease */
 		new_dentry_table = std::make_shared<dentry_table>(ino, LOCAL);
 		new_dentry_table->set_leader_ip(temp_address);
 		new_dentry_table->pull_child_metadata();
 		this->add_dentry_table(ino, new_dentry_table);
+		this->hints.put(ino, temp_address);
 	} else if(ret == -1) {
 		global_logger.log(directory_table_ops, "Fail to acquire lease, this dir already has the leader");
 		global_logger.log(directory_table_ops, "Leader Address: " + temp_address);
@@ -99,11 +328,38 @@ shared_ptr<dentry_table> directory_table::lease_dentry_table(uuid ino){
 		new_dentry_table = std::make_shared<dentry_table>(ino, REMOTE);
 		new_dentry_table->set_leader_ip(temp_address);
 		this->add_dentry_table(ino, new_dentry_table);
+		this->hints.put(ino, temp_address);
 	}
 
 	return new_dentry_table;
 }
 
+bool directory_table::has_dentry_table(uuid ino){
+	std::scoped_lock scl{this->directory_table_mutex};
+	auto it = this->dentry_tables.find(ino);
+	return it != this->dentry_tables.end() && holds_lease(it->second);
+}
+
+void directory_table::lease_predicted_dentry_tables(uuid dir_ino, const std::string &path, int end_name){
+	std::vector<uuid> inos{dir_ino};
+	uuid parent_ino = dir_ino;
+	int start_name, path_len = static_cast<int>(path.length());
+	lookup_cache::entry cached;
+
+	/* The directories the lookup cache still knows on the rest of the path */
+	while (set_name_bound(start_name, end_name, path, path_len) != -1) {
+		if (!this->lookups.get(parent_ino, path.substr(start_name, end_name - start_name + 1), cached))
+			break;
+		if (cached.ino.is_nil() || !S_ISDIR(cached.mode))
+			break;
+
+		inos.push_back(cached.ino);
+		parent_ino = cached.ino;
+	}
+
+	this->lease_dentry_tables(inos);
+}
+
 shared_ptr<dentry_table> directory_table::lease_dentry_table_mkdir(std::shared_ptr<inode> new_dir_inode, std::shared_ptr<dentry> new_dir_dentry) {
 	global_logger.log(directory_table_ops, "Called lease_dentry_table_mkdir(" + uuid_to_string(new_dir_inode->get_ino()) + ")");
 	std::scoped_lock scl{this->directory_table_mutex};
@@ -135,11 +391,12 @@ shared_ptr<dentry_table> directory_table::get_dentry_table(uuid ino, bool remote
 	if (remote) {
 		if (it != this->dentry_tables.end()) { /* LOCAL, REMOTE */
 			global_logger.log(directory_table_ops, "dentry_table : HIT");
-			bool valid = lc->is_valid(ino);
+			bool valid = holds_lease(it->second);
 			if (valid) {
 				return it->second;
 			} else {
 				this->dentry_tables.erase(it);
+				kernel_caches->invalidate_dir(ino);
 				throw dentry_table::not_leader("Lease is expired at remote side");
 			}
 		} else { /* UNKNOWN */
@@ -149,11 +406,12 @@ shared_ptr<dentry_table> directory_table::get_dentry_table(uuid ino, bool remote
 	} else {
 		if (it != this->dentry_tables.end()) { /* LOCAL, REMOTE */
 			global_logger.log(directory_table_ops, "dentry_table : HIT");
-			bool valid = lc->is_valid(ino);
+			bool valid = holds_lease(it->second);
 			if (valid) {
 				return it->second;
 			} else {
 				this->dentry_tables.erase(it);
+				kernel_caches->invalidate_dir(ino);
 				shared_ptr<dentry_table> new_dentry_table = lease_dentry_table(ino);
 				return new_dentry_table;
 			}
@@ -194,16 +452,83 @@ int directory_table::delete_dentry_table(uuid ino){
 	return 0;
 }
 
+void directory_table::drop_dentry_table(uuid ino) {
+	global_logger.log(directory_table_ops, "Called drop_dentry_table(" + uuid_to_string(ino) + ")");
+	std::scoped_lock scl{this->directory_table_mutex};
+
+	auto it = this->dentry_tables.find(ino);
+	if (it == this->dentry_tables.end() || it->second->get_loc() != LOCAL)
+		return;
+
+	this->dentry_tables.erase(it);
+	kernel_caches->invalidate_dir(ino);
+	this->lookups.invalidate_dir(ino);
+}
+
+void directory_table::invalidate_lookup(uuid parent_ino, const std::string &name) {
+	global_logger.log(directory_table_ops, "Called invalidate_lookup(" + uuid_to_string(parent_ino) + ", " + name + ")");
+
+	this->lookups.invalidate(parent_ino, name);
+}
+
+void directory_table::invalidate_negative_lookup(uuid parent_ino, const std::string &name) {
+	global_logger.log(directory_table_ops, "Called invalidate_negative_lookup(" + uuid_to_string(parent_ino) + ", " + name + ")");
+
+	this->lookups.invalidate_negative(parent_ino, name);
+}
+
+void directory_table::invalidate_lookups() {
+	global_logger.log(directory_table_ops, "Called invalidate_lookups()");
+
+	this->lookups.invalidate_all();
+}
+
 void directory_table::find_remote_dentry_table_again(const std::shared_ptr<remote_inode>& remote_i) {
 	global_logger.log(directory_table_ops, "Called find_remote_dentry_table_again()");
+	remote_i->set_leader_ip(this->find_leader_again(remote_i->get_dentry_table_ino(), remote_i->get_address()));
+}
+
+void directory_table::hint_leader(uuid ino, const std::string &address) {
+	this->hints.put(ino, address);
+}
+
+bool directory_table::known_leader(uuid ino, const std::string &self_address, std::string &address) {
+	if (this->hints.get(ino, self_address, address))
+		return true;
+
+	std::scoped_lock scl{this->directory_table_mutex};
+	auto it = this->dentry_tables.find(ino);
+	if (it == this->dentry_tables.end() || it->second->get_loc() != REMOTE || !holds_lease(it->second))
+		return false;
+
+	address = it->second->get_leader_ip();
+	return address != self_address;
+}
+
+std::string directory_table::find_leader_again(uuid dir_ino, const std::string &refused_address) {
+	std::string hinted_address;
+	if (this->hints.get(dir_ino, refused_address, hinted_address)) {
+		global_logger.log(directory_table_ops, "Remote dentry table is redirected to " + hinted_address);
+		/* Later requests for the directory go to the hinted leader too, not to the one which refused */
+		std::scoped_lock scl{this->directory_table_mutex};
+		auto it = this->dentry_tables.find(dir_ino);
+		if (it != this->dentry_tables.end() && it->second->get_loc() == REMOTE && it->second->get_leader_ip() == refused_address) {
+			shared_ptr<dentry_table> redirected_dentry_table = std::make_shared<dentry_table>(dir_ino, REMOTE);
+			redirected_dentry_table->set_leader_ip(hinted_address);
+			it.value() = redirected_dentry_table;
+		}
+		return hinted_address;
+	}
 
-	shared_ptr<dentry_table> target_dentry_table = this->get_dentry_table(remote_i->get_dentry_table_ino());
+	/* The hint is the leader which has just refused, if there is one */
+	this->hints.invalidate(dir_ino);
+	shared_ptr<dentry_table> target_dentry_table = this->get_dentry_table(dir_ino);
 	if(target_dentry_table->get_loc() == REMOTE) {
 		global_logger.log(directory_table_ops, "Remote dentry table moves to other leader");
 	} else if (target_dentry_table->get_loc() == LOCAL) {
 		global_logger.log(directory_table_ops, "Remote dentry table becomes Local dentry table");
 	}
 
-	remote_i->set_leader_ip(target_dentry_table->get_leader_ip());
+	return target_dentry_table->get_leader_ip();
 }
 
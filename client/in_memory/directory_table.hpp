@@ -1,8 +1,10 @@
 #ifndef NMFS0_DIRECTORY_TABLE_HPP
 #define NMFS0_DIRECTORY_TABLE_HPP
 
+#include <algorithm>
 #include <map>
 #include <utility>
+#include <vector>
 #include <memory>
 #include <mutex>
 
@@ -12,6 +14,9 @@
 #include <tsl/robin_map.h>
 
 #include "dentry_table.hpp"
+#include "lookup_cache.hpp"
+#include "attr_cache.hpp"
+#include "leader_hints.hpp"
 #include "../meta/inode.hpp"
 #include "../meta/dentry.hpp"
 #include "../logger/logger.hpp"
@@ -25,6 +30,18 @@ using namespace boost::uuids;
 class directory_table {
 private:
 	tsl::robin_map<uuid, shared_ptr<dentry_table>, boost::hash<uuid>> dentry_tables;
+	lookup_cache lookups;
+	leader_hints hints;
+
+	/* Resolves the names of path one by one from parent_dentry_table, found is what the path cache keeps */
+	shared_ptr<inode> walk(shared_ptr<dentry_table> parent_dentry_table, const std::string &path, uint64_t entry_gen,
+			       lookup_cache::path_entry &found);
+	/* Sets up the dentry_table of ino as lc->acquire() answered, ret and temp_address */
+	shared_ptr<dentry_table> set_up_dentry_table(uuid ino, int ret, const std::string &temp_address);
+	/* Whether the dentry_table of ino is there with a valid lease */
+	bool has_dentry_table(uuid ino);
+	/* Leases dir_ino with the directories the lookup cache knows on the path after end_name */
+	void lease_predicted_dentry_tables(uuid dir_ino, const std::string &path, int end_name);
 
 public:
 	std::recursive_mutex directory_table_mutex;
@@ -35,10 +52,35 @@ public:
 	int delete_dentry_table(uuid ino);
 
 	shared_ptr<inode> path_traversal(const std::string &path);
+	/* Returns nullptr instead of throwing inode::no_entry when a name on the path doesn't exist */
+	shared_ptr<inode> try_path_traversal(const std::string &path);
+	/* The child name of the directory parent_ino and its mode, nullptr when it doesn't exist */
+	shared_ptr<inode> try_lookup(uuid parent_ino, const std::string &name, mode_t &mode);
+	/* The inode found before by a lookup, without resolving its name again */
+	shared_ptr<inode> get_inode(uuid parent_ino, const std::string &name, uuid ino, mode_t mode);
 	shared_ptr<dentry_table> lease_dentry_table(uuid ino);
+	/* Leases the directories of inos which have no dentry_table in one call to the manager */
+	void lease_dentry_tables(const std::vector<uuid> &inos);
 	shared_ptr<dentry_table> lease_dentry_table_mkdir(std::shared_ptr<inode> new_dir_inode, std::shared_ptr<dentry> new_dir_dentry);
 	shared_ptr<dentry_table> get_dentry_table(uuid ino, bool remote = false);
+	/* Points remote_i to the leader of its directory after its address answered -ENOTLEADER */
 	void find_remote_dentry_table_again(const std::shared_ptr<remote_inode>& remote_i);
+	/* The same for a request on dir_ino which refused_address answered, returns the address to send it to */
+	std::string find_leader_again(uuid dir_ino, const std::string &refused_address);
+	/* Where a request on ino goes after a refusal, see leader_hints */
+	void hint_leader(uuid ino, const std::string &address);
+	/* The leader of ino as far as this client knows, if it isn't self_address */
+	bool known_leader(uuid ino, const std::string &self_address, std::string &address);
+
+	/* Called when the lease of a directory this client led has gone to another one */
+	void drop_dentry_table(uuid ino);
+
+	/* Called when a name is removed or replaced */
+	void invalidate_lookup(uuid parent_ino, const std::string &name);
+	/* Called when a name is created */
+	void invalidate_negative_lookup(uuid parent_ino, const std::string &name);
+	/* Called when a mode or an owner changes, the cached lookups skip the permission checks */
+	void invalidate_lookups();
 };
 
 #endif //NMFS0_DIRECTORY_TABLE_HPP
@@ -0,0 +1,153 @@
+#include "kernel_cache.hpp"
+#include "node_table.hpp"
+#include "../lease/lease_client.hpp"
+#include "../../lib/logger/logger.hpp"
+
+extern std::shared_ptr<lease_client> lc;
+extern std::unique_ptr<node_table> nodes;
+
+kernel_cache::kernel_cache(struct fuse_session *se) : se(se), stopping(false)
+{
+	if (se != nullptr)
+		notifier = std::thread(&kernel_cache::notify_loop, this);
+}
+
+kernel_cache::~kernel_cache(void)
+{
+	{
+		std::unique_lock lock(m);
+		stopping = true;
+	}
+	cv.notify_all();
+	if (notifier.joinable())
+		notifier.join();
+}
+
+void kernel_cache::forget(const uuid &ino)
+{
+	auto it = files.find(ino);
+	if (it == files.end())
+		return;
+
+	auto dit = dirs.find(it->second);
+	if (dit != dirs.end()) {
+		dit.value().erase(ino);
+		if (dit->second.empty())
+			dirs.erase(dit);
+	}
+	files.erase(it);
+}
+
+bool kernel_cache::track(const uuid &ino, const uuid &dir_ino)
+{
+	if (se == nullptr)
+		return false;
+
+	std::unique_lock lock(m);
+
+	auto it = files.find(ino);
+	if (it != files.end() && it->second == dir_ino)
+		return true;
+	if (it != files.end()) {
+		forget(ino);
+		pending_inodes.push_back(ino);
+	}
+
+	if (files.size() >= KERNEL_CACHE_MAX_FILES)
+		return false;
+
+	files.insert({ino, dir_ino});
+	dirs[dir_ino].insert(ino);
+	return false;
+}
+
+bool kernel_cache::may_cache(const uuid &ino)
+{
+	return se != nullptr && nodes->find(ino) != 0;
+}
+
+void kernel_cache::invalidate(const uuid &ino)
+{
+	if (se == nullptr)
+		return;
+
+	std::unique_lock lock(m);
+	global_logger.log(fuse_op, "kernel_cache: invalidate " + uuid_to_string(ino));
+	forget(ino);
+	pending_inodes.push_back(ino);
+	cv.notify_all();
+}
+
+void kernel_cache::invalidate_entry(const uuid &dir_ino, const std::string &name)
+{
+	if (se == nullptr)
+		return;
+
+	std::unique_lock lock(m);
+	global_logger.log(fuse_op, "kernel_cache: invalidate " + name + " in " + uuid_to_string(dir_ino));
+	pending_entries.emplace_back(dir_ino, name);
+	cv.notify_all();
+}
+
+void kernel_cache::invalidate_dir(const uuid &dir_ino)
+{
+	if (se == nullptr)
+		return;
+
+	std::unique_lock lock(m);
+	auto dit = dirs.find(dir_ino);
+	if (dit == dirs.end())
+		return;
+
+	global_logger.log(fuse_op, "kernel_cache: invalidate the files in " + uuid_to_string(dir_ino));
+	std::vector<uuid> inos(dit->second.begin(), dit->second.end());
+	for (auto &ino : inos) {
+		forget(ino);
+		pending_inodes.push_back(ino);
+	}
+	cv.notify_all();
+}
+
+void kernel_cache::notify_loop(void)
+{
+	std::unique_lock lock(m);
+	while (!stopping) {
+		cv.wait_for(lock, milliseconds(KERNEL_CACHE_CHECK_MS),
+			    [this] { return stopping || !pending_inodes.empty() || !pending_entries.empty(); });
+		if (stopping)
+			break;
+
+		/* The directories whose lease expired or went to another client */
+		std::vector<uuid> lost;
+		for (auto &d : dirs)
+			if (!lc->is_mine(d.first))
+				lost.push_back(d.first);
+		for (auto &dir_ino : lost) {
+			std::vector<uuid> inos(dirs[dir_ino].begin(), dirs[dir_ino].end());
+			for (auto &ino : inos) {
+				forget(ino);
+				pending_inodes.push_back(ino);
+			}
+		}
+
+		std::vector<uuid> inodes;
+		std::vector<std::pair<uuid, std::string>> entries;
+		inodes.swap(pending_inodes);
+		entries.swap(pending_entries);
+		lock.unlock();
+
+		/* Only what the kernel has a node for is cached there, -ENOENT means it has just been forgotten */
+		for (auto &e : entries) {
+			fuse_ino_t parent = nodes->find(e.first);
+			if (parent != 0)
+				fuse_lowlevel_notify_inval_entry(se, parent, e.second.c_str(), e.second.length());
+		}
+		for (auto &ino : inodes) {
+			fuse_ino_t nodeid = nodes->find(ino);
+			if (nodeid != 0)
+				fuse_lowlevel_notify_inval_inode(se, nodeid, 0, 0);
+		}
+
+		lock.lock();
+	}
+}
@@ -0,0 +1,80 @@
+#ifndef NMFS0_KERNEL_CACHE_HPP
+#define NMFS0_KERNEL_CACHE_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <tsl/robin_map.h>
+
+#include "../fs_ops/fuse_ops.hpp"
+
+using namespace std::chrono;
+using namespace boost::uuids;
+
+/* -o kernel_ttl when it isn't given : milliseconds the kernel keeps attributes and names, 0 turns kernel caching off.
+   The ones of a directory led by another client are kept for attr_ttl at most. */
+#define DEFAULT_KERNEL_TTL_MS 1000
+
+/* Files kept in the page cache across opens, the ones past this are opened without keep_cache */
+#define KERNEL_CACHE_MAX_FILES 65536
+/* How often the leases of the directories the tracked files are in are checked */
+#define KERNEL_CACHE_CHECK_MS 100
+
+/*
+ * The files whose pages the kernel keeps across opens, and the invalidation of what the kernel caches.
+ * Only files in directories this client leads are kept: nobody else changes them
+ * without the leader knowing, so rpc_server invalidates what other clients change
+ * and the whole directory is invalidated when its lease is lost.
+ * The kernel is notified from a thread of its own, never from inside a fuse request.
+ */
+class kernel_cache {
+private:
+	struct fuse_session *se;
+
+	std::mutex m;
+	std::condition_variable cv;
+	/* the directory of each tracked file */
+	tsl::robin_map<uuid, uuid, boost::hash<uuid>> files;
+	/* the tracked files of each directory */
+	tsl::robin_map<uuid, std::set<uuid>, boost::hash<uuid>> dirs;
+	/* inodes and names to invalidate */
+	std::vector<uuid> pending_inodes;
+	std::vector<std::pair<uuid, std::string>> pending_entries;
+
+	bool stopping;
+	std::thread notifier;
+
+	/* m is held */
+	void forget(const uuid &ino);
+	void notify_loop(void);
+
+public:
+	/* se : the session to notify, nullptr keeps nothing */
+	explicit kernel_cache(struct fuse_session *se);
+	~kernel_cache(void);
+
+	/*
+	 * Called when a file of a directory this client leads is opened.
+	 * Returns whether the open may keep the pages cached before it, which holds from the second open on
+	 * as long as the file hasn't been invalidated since, so the first one drops what an older open left.
+	 */
+	bool track(const uuid &ino, const uuid &dir_ino);
+	/* Whether the kernel may hold pages of ino, which it can't without a node for it */
+	bool may_cache(const uuid &ino);
+	/* Called when another client changes ino through the leader */
+	void invalidate(const uuid &ino);
+	/* Called when another client removes or replaces name in dir_ino through the leader */
+	void invalidate_entry(const uuid &dir_ino, const std::string &name);
+	/* Called when the lease on dir_ino is lost */
+	void invalidate_dir(const uuid &dir_ino);
+};
+
+#endif //NMFS0_KERNEL_CACHE_HPP
@@ -0,0 +1,32 @@
+#include "leader_hints.hpp"
+#include "../../lib/logger/logger.hpp"
+
+bool leader_hints::get(const uuid &ino, const std::string &refused_address, std::string &address)
+{
+	std::shared_lock lock(sm);
+
+	auto it = hints.find(ino);
+	if (it == hints.end() || system_clock::now() >= it->second.due || it->second.address == refused_address)
+		return false;
+
+	address = it->second.address;
+	return true;
+}
+
+void leader_hints::put(const uuid &ino, const std::string &address)
+{
+	std::unique_lock lock(sm);
+
+	if (hints.size() >= LEADER_HINTS_MAX_ENTRIES) {
+		global_logger.log(directory_table_ops, "leader hints are full, drop every entry");
+		hints.clear();
+	}
+	hints[ino] = {address, system_clock::now() + milliseconds(LEADER_HINT_TTL_MS)};
+}
+
+void leader_hints::invalidate(const uuid &ino)
+{
+	std::unique_lock lock(sm);
+
+	hints.erase(ino);
+}
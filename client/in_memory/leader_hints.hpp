@@ -0,0 +1,51 @@
+#ifndef NMFS0_LEADER_HINTS_HPP
+#define NMFS0_LEADER_HINTS_HPP
+
+#include <chrono>
+#include <shared_mutex>
+#include <string>
+
+#include <boost/functional/hash.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <tsl/robin_map.h>
+
+using namespace std::chrono;
+using namespace boost::uuids;
+
+/* How long the leader learned for a directory is trusted */
+#define LEADER_HINT_TTL_MS 1000
+
+/* The whole table is dropped when it grows past this */
+#define LEADER_HINTS_MAX_ENTRIES 65536
+
+/* The trailing metadata of an -ENOTLEADER reply which names the leader, when the one refusing knows it */
+#define LEADER_METADATA_KEY "nmfs-leader"
+
+/*
+ * Where the directories were last found to be led, by ino.
+ * The hints come from the replies of the leaders which refused a request,
+ * and from the manager when this client loses the lease of a directory.
+ * When a leader answers -ENOTLEADER the request is sent to the hinted leader,
+ * without asking the manager again, unless the hint is the leader which has just refused it.
+ */
+class leader_hints {
+private:
+	struct entry {
+		std::string address;
+		system_clock::time_point due;
+	};
+
+	std::shared_mutex sm;
+	tsl::robin_map<uuid, entry, boost::hash<uuid>> hints;
+
+public:
+	leader_hints(void) = default;
+	~leader_hints(void) = default;
+
+	/* Returns the leader of ino unless it is unknown, expired or refused_address */
+	bool get(const uuid &ino, const std::string &refused_address, std::string &address);
+	void put(const uuid &ino, const std::string &address);
+	void invalidate(const uuid &ino);
+};
+
+#endif //NMFS0_LEADER_HINTS_HPP
@@ -0,0 +1,134 @@
+#include "lookup_cache.hpp"
+#include "../../lib/logger/logger.hpp"
+
+lookup_cache::lookup_cache(void) : gen(0), entry_gen(0)
+{
+}
+
+std::pair<uint64_t, uint64_t> lookup_cache::get_gen(void)
+{
+	std::shared_lock lock(sm);
+	return std::make_pair(gen, entry_gen);
+}
+
+bool lookup_cache::get(const uuid &parent_ino, const std::string &name, entry &e)
+{
+	std::shared_lock lock(sm);
+
+	auto it = dentries.find(std::make_pair(parent_ino, name));
+	if (it == dentries.end() || system_clock::now() >= it->second.due)
+		return false;
+
+	e = it->second;
+	return true;
+}
+
+void lookup_cache::put(const uuid &parent_ino, const std::string &name, const entry &e, uint64_t looked_up_gen)
+{
+	std::unique_lock lock(sm);
+
+	if (looked_up_gen != entry_gen)
+		return;
+
+	if (dentries.size() >= LOOKUP_CACHE_MAX_ENTRIES) {
+		global_logger.log(directory_table_ops, "lookup cache is full, drop every entry");
+		dentries.clear();
+	}
+	dentries[std::make_pair(parent_ino, name)] = e;
+}
+
+bool lookup_cache::get_path(const std::string &path, path_entry &e)
+{
+	std::shared_lock lock(sm);
+
+	auto it = paths.find(path);
+	if (it == paths.end() || system_clock::now() >= it->second.due)
+		return false;
+
+	e = it->second;
+	return true;
+}
+
+void lookup_cache::put_path(const std::string &path, const path_entry &e)
+{
+	std::unique_lock lock(sm);
+
+	if (e.gen != gen)
+		return;
+
+	if (paths.size() >= LOOKUP_CACHE_MAX_PATHS || path_index.size() >= LOOKUP_CACHE_MAX_ENTRIES) {
+		global_logger.log(directory_table_ops, "path cache is full, drop every path");
+		paths.clear();
+		path_index.clear();
+	}
+
+	for (const auto &name : e.via)
+		path_index[name].insert(path);
+	path_entry &stored = paths[path];
+	stored = e;
+	stored.via.clear();
+}
+
+void lookup_cache::drop_paths(const std::pair<uuid, std::string> &name)
+{
+	auto it = path_index.find(name);
+	if (it == path_index.end())
+		return;
+
+	for (const auto &path : it->second)
+		paths.erase(path);
+	path_index.erase(it);
+}
+
+void lookup_cache::invalidate(const uuid &parent_ino, const std::string &name)
+{
+	std::unique_lock lock(sm);
+
+	dentries.erase(std::make_pair(parent_ino, name));
+	drop_paths(std::make_pair(parent_ino, name));
+	gen++;
+	entry_gen++;
+}
+
+void lookup_cache::invalidate_dir(const uuid &dir_ino)
+{
+	std::unique_lock lock(sm);
+
+	for (auto it = dentries.begin(); it != dentries.end();) {
+		if (it->first.first == dir_ino)
+			it = dentries.erase(it);
+		else
+			++it;
+	}
+
+	std::vector<std::pair<uuid, std::string>> names;
+	for (const auto &p : path_index)
+		if (p.first.first == dir_ino)
+			names.push_back(p.first);
+	for (const auto &name : names)
+		drop_paths(name);
+
+	gen++;
+	entry_gen++;
+}
+
+void lookup_cache::invalidate_negative(const uuid &parent_ino, const std::string &name)
+{
+	std::unique_lock lock(sm);
+
+	auto it = dentries.find(std::make_pair(parent_ino, name));
+	if (it != dentries.end() && it->second.ino.is_nil())
+		dentries.erase(it);
+	entry_gen++;
+}
+
+void lookup_cache::invalidate_all(void)
+{
+	std::unique_lock lock(sm);
+
+	dentries.clear();
+	paths.clear();
+	path_index.clear();
+	gen++;
+	entry_gen++;
+}
@@ -0,0 +1,89 @@
+#ifndef NMFS0_LOOKUP_CACHE_HPP
+#define NMFS0_LOOKUP_CACHE_HPP
+
+#include <chrono>
+#include <shared_mutex>
+#include <string>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include <boost/functional/hash.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <tsl/robin_map.h>
+
+using namespace std::chrono;
+using namespace boost::uuids;
+
+/* The whole table is dropped when it grows past these */
+#define LOOKUP_CACHE_MAX_ENTRIES 65536
+#define LOOKUP_CACHE_MAX_PATHS 65536
+
+/*
+ * Lookup results cached by (parent ino, name) and by full path.
+ * An entry is good until the lease of the directory it was found in expires
+ * (for a path, the earliest lease on the way) or until it is invalidated.
+ * Another client may change a directory it leads meanwhile, so under one that lasts attr_ttl_ms at most.
+ * An entry with a nil ino records a name which doesn't exist, paths are cached only when found.
+ * A path is dropped with any of the names on its way.
+ */
+class lookup_cache {
+public:
+	struct entry {
+		uuid ino;
+		mode_t mode;
+		system_clock::time_point due;
+	};
+
+	struct path_entry {
+		uuid parent_ino;
+		std::string name;
+		uuid ino;
+		mode_t mode;
+		system_clock::time_point due;
+		uint64_t gen;
+		/* the (parent ino, name) on the way, not kept in the cache */
+		std::vector<std::pair<uuid, std::string>> via;
+	};
+
+private:
+	std::shared_mutex sm;
+	tsl::robin_map<std::pair<uuid, std::string>, entry, boost::hash<std::pair<uuid, std::string>>> dentries;
+	tsl::robin_map<std::string, path_entry> paths;
+	/* the paths going through each name, some of them may be gone already */
+	tsl::robin_map<std::pair<uuid, std::string>, std::unordered_set<std::string>, boost::hash<std::pair<uuid, std::string>>> path_index;
+
+	void drop_paths(const std::pair<uuid, std::string> &name);
+
+	/* Bumped by every invalidation, a result looked up under an older one isn't cached */
+	uint64_t gen;
+	/* Also bumped when a name is created, for the entries only */
+	uint64_t entry_gen;
+
+public:
+	lookup_cache(void);
+	~lookup_cache(void) = default;
+
+	/* the generations to pass to put() and put_path() */
+	std::pair<uint64_t, uint64_t> get_gen(void);
+
+	bool get(const uuid &parent_ino, const std::string &name, entry &e);
+	void put(const uuid &parent_ino, const std::string &name, const entry &e, uint64_t looked_up_gen);
+
+	bool get_path(const std::string &path, path_entry &e);
+	void put_path(const std::string &path, const path_entry &e);
+
+	/* Drops the name and the cached paths through it */
+	void invalidate(const uuid &parent_ino, const std::string &name);
+	/* Drops the names in the directory and the cached paths through them */
+	void invalidate_dir(const uuid &dir_ino);
+	/* Drops a negative entry, the paths aren't affected */
+	void invalidate_negative(const uuid &parent_ino, const std::string &name);
+	/* A permission on the way may have changed */
+	void invalidate_all(void);
+};
+
+#endif //NMFS0_LOOKUP_CACHE_HPP
@@ -0,0 +1,98 @@
+#include "node_table.hpp"
+#include "../../lib/logger/logger.hpp"
+
+node_table::node_table(const uuid &root_ino) : next_nodeid(FUSE_ROOT_ID + 1)
+{
+	nodes[FUSE_ROOT_ID] = {root_ino, nil_uuid(), "", S_IFDIR, 1};
+	nodeids[root_ino] = FUSE_ROOT_ID;
+}
+
+fuse_ino_t node_table::add(const uuid &ino, const uuid &parent_ino, const std::string &name, mode_t mode)
+{
+	std::unique_lock lock(sm);
+
+	auto it = nodeids.find(ino);
+	if (it != nodeids.end()) {
+		node &n = nodes[it->second];
+		if (it->second != FUSE_ROOT_ID) {
+			n.parent_ino = parent_ino;
+			n.name = name;
+			n.mode = mode;
+		}
+		n.nlookup++;
+		return it->second;
+	}
+
+	fuse_ino_t nodeid = next_nodeid++;
+	nodes[nodeid] = {ino, parent_ino, name, mode, 1};
+	nodeids[ino] = nodeid;
+	return nodeid;
+}
+
+bool node_table::get(fuse_ino_t nodeid, node &n)
+{
+	std::shared_lock lock(sm);
+
+	auto it = nodes.find(nodeid);
+	if (it == nodes.end())
+		return false;
+
+	n = it->second;
+	return true;
+}
+
+fuse_ino_t node_table::find(const uuid &ino)
+{
+	std::shared_lock lock(sm);
+
+	auto it = nodeids.find(ino);
+	return it != nodeids.end() ? it->second : 0;
+}
+
+void node_table::move(const uuid &ino, const uuid &new_parent_ino, const std::string &new_name)
+{
+	std::unique_lock lock(sm);
+
+	auto it = nodeids.find(ino);
+	if (it == nodeids.end())
+		return;
+
+	node &n = nodes[it->second];
+	n.parent_ino = new_parent_ino;
+	n.name = new_name;
+}
+
+void node_table::detach(const uuid &ino)
+{
+	std::unique_lock lock(sm);
+
+	auto it = nodeids.find(ino);
+	if (it == nodeids.end() || it->second == FUSE_ROOT_ID)
+		return;
+
+	nodes[it->second].name.clear();
+}
+
+void node_table::forget(fuse_ino_t nodeid, uint64_t nlookup)
+{
+	if (nodeid == FUSE_ROOT_ID)
+		return;
+
+	std::unique_lock lock(sm);
+
+	auto it = nodes.find(nodeid);
+	if (it == nodes.end()) {
+		global_logger.log(fuse_op, "node_table: forget of an unknown node " + std::to_string(nodeid));
+		return;
+	}
+
+	if (it->second.nlookup > nlookup) {
+		it.value().nlookup -= nlookup;
+		return;
+	}
+
+	auto iit = nodeids.find(it->second.ino);
+	if (iit != nodeids.end() && iit->second == nodeid)
+		nodeids.erase(iit);
+	nodes.erase(it);
+}
@@ -0,0 +1,60 @@
+#ifndef NMFS0_NODE_TABLE_HPP
+#define NMFS0_NODE_TABLE_HPP
+
+#include <shared_mutex>
+#include <string>
+
+#include <sys/stat.h>
+
+#include <boost/functional/hash.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <boost/uuid/uuid_generators.hpp>
+#include <tsl/robin_map.h>
+
+#include "../fs_ops/fuse_ops.hpp"
+
+using namespace boost::uuids;
+
+/*
+ * The nodes the kernel knows, by nodeid.
+ * A node keeps where its inode was found, so that it is found again
+ * from its directory without resolving a path. The kernel takes a reference on a node
+ * with every entry it is given and drops them with forget(), the node goes with the last one.
+ * Nodeids aren't reused, the root is FUSE_ROOT_ID and never goes.
+ */
+class node_table {
+public:
+	struct node {
+		uuid ino;
+		uuid parent_ino;
+		/* empty once the name is removed */
+		std::string name;
+		mode_t mode;
+		uint64_t nlookup;
+	};
+
+private:
+	std::shared_mutex sm;
+	tsl::robin_map<fuse_ino_t, node> nodes;
+	tsl::robin_map<uuid, fuse_ino_t, boost::hash<uuid>> nodeids;
+	fuse_ino_t next_nodeid;
+
+public:
+	explicit node_table(const uuid &root_ino);
+	~node_table(void) = default;
+
+	/* Called for every entry given to the kernel, the node of ino is moved to name if it has one */
+	fuse_ino_t add(const uuid &ino, const uuid &parent_ino, const std::string &name, mode_t mode);
+	/* false when the kernel has forgotten nodeid */
+	bool get(fuse_ino_t nodeid, node &n);
+	/* 0 when the kernel doesn't know ino */
+	fuse_ino_t find(const uuid &ino);
+
+	/* Called when a name is renamed through this client */
+	void move(const uuid &ino, const uuid &new_parent_ino, const std::string &new_name);
+	/* Called when the name of ino is removed */
+	void detach(const uuid &ino);
+	void forget(fuse_ino_t nodeid, uint64_t nlookup);
+};
+
+#endif //NMFS0_NODE_TABLE_HPP
@@ -0,0 +1,213 @@
+#include "read_ahead.hpp"
+
+#include <cstdlib>
+
+extern std::shared_ptr<rados_io> data_pool;
+
+read_ahead::read_ahead(void) : next_offset(0), seq_reads(0), window_size(READAHEAD_MIN_WINDOW), version(0)
+{
+}
+
+read_ahead::~read_ahead(void)
+{
+	for (auto &c : chunks)
+		drop_chunk(c);
+}
+
+void read_ahead::wait_chunk(chunk &c)
+{
+	if (c.handle == nullptr)
+		return;
+
+	try {
+		c.got = c.handle->wait();
+	} catch (std::exception &e) {
+		global_logger.log(file_handler_ops, std::string("read_ahead: a chunk failed : ") + e.what());
+		c.failed = true;
+	}
+	c.handle.reset();
+}
+
+void read_ahead::drop_chunk(chunk &c)
+{
+	/* the buffer can't go away while a read is filling it */
+	wait_chunk(c);
+	free(c.data);
+	c.data = nullptr;
+}
+
+void read_ahead::prefetch(const std::shared_ptr<inode> &i, off_t file_size)
+{
+	off_t ahead_end = chunks.empty() ? next_offset : chunks.back().offset + static_cast<off_t>(chunks.back().len);
+	if (ahead_end < next_offset)
+		ahead_end = next_offset;
+
+	/* A new window goes out once less than a window is left ahead of the reads */
+	if (ahead_end - next_offset >= static_cast<off_t>(window_size) || ahead_end >= file_size)
+		return;
+
+	off_t end = std::min(ahead_end + static_cast<off_t>(window_size), file_size);
+	global_logger.log(file_handler_ops, "read_ahead: offset " + std::to_string(ahead_end) + " length " + std::to_string(end - ahead_end));
+
+	std::string key = uuid_to_string(i->get_ino());
+	for (off_t off = ahead_end; off < end;) {
+		size_t len = std::min(static_cast<off_t>(READAHEAD_CHUNK - off % READAHEAD_CHUNK), end - off);
+		char *data = static_cast<char *>(malloc(len));
+		if (data == nullptr)
+			break;
+
+		chunk c{off, len, data, nullptr, 0, false};
+		c.handle = data_pool->aio_read(obj_category::DATA, key, data, len, off, file_size);
+		chunks.push_back(std::move(c));
+		off += len;
+	}
+
+	window_size = std::min(window_size * 2, static_cast<size_t>(READAHEAD_MAX_WINDOW));
+}
+
+size_t read_ahead::serve(size_t size, off_t offset, std::vector<fuse_buf> *taken, char *&buffer, size_t &buffer_start)
+{
+	size_t served = 0;
+	for (auto &c : chunks) {
+		off_t pos = offset + served;
+		if (served == size || pos < c.offset)
+			break;
+		if (pos >= c.offset + static_cast<off_t>(c.len))
+			continue;
+		if (c.data == nullptr)
+			break;
+
+		wait_chunk(c);
+		if (c.failed || pos >= c.offset + static_cast<off_t>(c.got))
+			break;
+
+		size_t n = std::min(size - served, static_cast<size_t>(c.offset + c.got - pos));
+
+		/* A chunk the read starts on and covers whole goes as it is, until something is copied */
+		if (taken != nullptr && buffer == nullptr && pos == c.offset && n == c.got) {
+			fuse_buf b{};
+			b.size = n;
+			b.mem = c.data;
+			taken->push_back(b);
+			c.data = nullptr;
+			served += n;
+			continue;
+		}
+
+		if (buffer == nullptr) {
+			buffer = static_cast<char *>(malloc(size - served));
+			if (buffer == nullptr)
+				throw std::bad_alloc();
+			buffer_start = served;
+		}
+		std::memcpy(buffer + (served - buffer_start), c.data + (pos - c.offset), n);
+		served += n;
+	}
+	return served;
+}
+
+/*
+ * Reads size bytes at offset. When taken is given, whole chunks are moved into it and
+ * the rest goes to a buffer malloc()ed here, otherwise everything goes to buffer.
+ * buffer_start is where buffer starts in the read.
+ */
+size_t read_ahead::read(const std::shared_ptr<inode> &i, size_t size, off_t offset, std::vector<fuse_buf> *taken,
+			char *&buffer, size_t &buffer_start)
+{
+	off_t file_size = i->get_size();
+	size_t served = 0;
+	{
+		std::scoped_lock lock(m);
+
+		uint64_t v = i->get_data_version();
+		if (v != version) {
+			for (auto &c : chunks)
+				drop_chunk(c);
+			chunks.clear();
+			version = v;
+		}
+
+		served = serve(size, offset, taken, buffer, buffer_start);
+
+		if (offset == next_offset || served > 0) {
+			if (seq_reads < READAHEAD_SEQ_READS)
+				seq_reads++;
+		} else {
+			seq_reads = 0;
+			window_size = READAHEAD_MIN_WINDOW;
+		}
+		next_offset = offset + size;
+
+		/* The chunks behind the read, or all of them once the reads jump, are done with */
+		while (!chunks.empty() && (seq_reads == 0 || chunks.front().failed || chunks.front().data == nullptr ||
+					   chunks.front().offset + static_cast<off_t>(chunks.front().len) <= next_offset)) {
+			drop_chunk(chunks.front());
+			chunks.pop_front();
+		}
+
+		if (seq_reads >= READAHEAD_SEQ_READS)
+			prefetch(i, file_size);
+	}
+
+	/* The rest is read at once, outside the lock */
+	if (served < size && offset + static_cast<off_t>(served) < file_size) {
+		if (buffer == nullptr) {
+			buffer = static_cast<char *>(malloc(size - served));
+			if (buffer == nullptr)
+				throw std::bad_alloc();
+			buffer_start = served;
+		}
+		served += data_pool->read(obj_category::DATA, uuid_to_string(i->get_ino()), buffer + (served - buffer_start),
+					  size - served, offset + served, file_size);
+	}
+	return served;
+}
+
+ssize_t read_ahead::read(const std::shared_ptr<inode> &i, char *buffer, size_t size, off_t offset)
+{
+	size_t buffer_start = 0;
+	return read(i, size, offset, nullptr, buffer, buffer_start);
+}
+
+ssize_t read_ahead::read_buf(const std::shared_ptr<inode> &i, struct fuse_bufvec **bufp, size_t size, off_t offset)
+{
+	std::vector<fuse_buf> taken;
+	char *buffer = nullptr;
+	size_t buffer_start = 0;
+	size_t served;
+	try {
+		served = read(i, size, offset, &taken, buffer, buffer_start);
+	} catch (...) {
+		for (auto &b : taken)
+			free(b.mem);
+		free(buffer);
+		throw;
+	}
+
+	if (buffer != nullptr && served > buffer_start) {
+		fuse_buf b{};
+		b.size = served - buffer_start;
+		b.mem = buffer;
+		taken.push_back(b);
+	} else {
+		free(buffer);
+	}
+
+	/* fuse_bufvec ends with one fuse_buf */
+	size_t count = taken.empty() ? 1 : taken.size();
+	struct fuse_bufvec *bv = static_cast<struct fuse_bufvec *>(malloc(sizeof(struct fuse_bufvec) + (count - 1) * sizeof(struct fuse_buf)));
+	if (bv == nullptr) {
+		for (auto &b : taken)
+			free(b.mem);
+		throw std::bad_alloc();
+	}
+	*bv = FUSE_BUFVEC_INIT(0);
+	if (!taken.empty()) {
+		bv->count = taken.size();
+		for (size_t n = 0; n < taken.size(); n++)
+			bv->buf[n] = taken[n];
+	}
+
+	*bufp = bv;
+	return served;
+}
@@ -0,0 +1,68 @@
+#ifndef NMFS0_READ_AHEAD_HPP
+#define NMFS0_READ_AHEAD_HPP
+
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "../fs_ops/fuse_ops.hpp"
+#include "../meta/inode.hpp"
+
+/* The first window read ahead, doubled by every window up to READAHEAD_MAX_WINDOW */
+#define READAHEAD_MIN_WINDOW (128 * 1024)
+#define READAHEAD_MAX_WINDOW (4 * OBJ_SIZE)
+/* Sequential reads seen before reading ahead */
+#define READAHEAD_SEQ_READS 2
+/* A window is read in chunks aligned to this, the size of the reads the kernel sends */
+#define READAHEAD_CHUNK (128 * 1024)
+
+/*
+ * Read-ahead of an open file handler.
+ * Once the reads follow each other, the data after them is read with async reads
+ * into chunks, and the next reads are served from the chunks.
+ * The chunks are dropped when the data version of the inode changes or the reads stop being sequential.
+ */
+class read_ahead {
+private:
+	struct chunk {
+		off_t offset;
+		size_t len;
+		/* malloc()ed, nullptr once handed over by read_buf() */
+		char *data;
+		std::shared_ptr<rados_io::aio_handle> handle;
+		/* bytes read, valid once the handle is waited */
+		size_t got;
+		bool failed;
+	};
+
+	std::mutex m;
+	/* where the next sequential read starts */
+	off_t next_offset;
+	unsigned int seq_reads;
+	size_t window_size;
+	uint64_t version;
+	/* contiguous and in offset order */
+	std::deque<chunk> chunks;
+
+	void wait_chunk(chunk &c);
+	void drop_chunk(chunk &c);
+	void prefetch(const std::shared_ptr<inode> &i, off_t file_size);
+	/* Serves what the chunks hold, see read() */
+	size_t serve(size_t size, off_t offset, std::vector<fuse_buf> *taken, char *&buffer, size_t &buffer_start);
+	size_t read(const std::shared_ptr<inode> &i, size_t size, off_t offset, std::vector<fuse_buf> *taken,
+		    char *&buffer, size_t &buffer_start);
+
+public:
+	read_ahead(void);
+	~read_ahead(void);
+
+	/* Same as local_read() */
+	ssize_t read(const std::shared_ptr<inode> &i, char *buffer, size_t size, off_t offset);
+	/* Same as read(), but the chunks the read covers whole are handed over in *bufp without a copy.
+	   The buffers are malloc()ed and freed by fuse. */
+	ssize_t read_buf(const std::shared_ptr<inode> &i, struct fuse_bufvec **bufp, size_t size, off_t offset);
+};
+
+#endif //NMFS0_READ_AHEAD_HPP
@@ -0,0 +1,298 @@
+#include "write_cache.hpp"
+#include "../fs_ops/remote_ops.hpp"
+#include "../journal/journal.hpp"
+
+extern std::shared_ptr<rados_io> data_pool;
+extern std::unique_ptr<directory_table> indexing_table;
+extern std::unique_ptr<journal> journalctl;
+
+write_cache::write_cache(write_back *owner, std::shared_ptr<inode> i)
+	: owner(owner), i(i), dirty(0), written_end(0), size_dirty(false), error(0), leader_caches(true)
+{
+}
+
+write_cache::~write_cache(void)
+{
+	int ret = flush();
+	if (ret != 0)
+		global_logger.log(file_handler_ops, "write_cache: dropped a flush error (" + std::to_string(ret) + ")");
+}
+
+ssize_t write_cache::write(const char *buffer, size_t size, off_t offset, int flags)
+{
+	global_logger.log(file_handler_ops, "Called write_cache::write()");
+	return write(size, offset, flags, [buffer, size](char *dst) {
+		std::memcpy(dst, buffer, size);
+		return static_cast<ssize_t>(size);
+	});
+}
+
+ssize_t write_cache::write(struct fuse_bufvec *src, off_t offset, int flags)
+{
+	global_logger.log(file_handler_ops, "Called write_cache::write(fuse_bufvec)");
+	size_t size = fuse_buf_size(src);
+	return write(size, offset, flags, [src, size](char *dst) {
+		struct fuse_bufvec dst_buf = FUSE_BUFVEC_INIT(size);
+		dst_buf.buf[0].mem = dst;
+		return fuse_buf_copy(&dst_buf, src, static_cast<fuse_buf_copy_flags>(0));
+	});
+}
+
+ssize_t write_cache::write(size_t size, off_t offset, int flags, const std::function<ssize_t(char *)> &fill)
+{
+	if (size == 0)
+		return 0;
+
+	/* The size is raised at once so that O_APPEND and getattr see it, it is journaled on flush.
+	   It is compared with the inode since truncate, fallocate and O_TRUNC may have lowered it. */
+	bool grows;
+	{
+		std::scoped_lock scl{i->inode_mutex};
+		if (i->get_loc() == LOCAL && (flags & O_APPEND))
+			offset = i->get_size();
+		grows = i->get_size() < offset + static_cast<off_t>(size);
+		if (grows)
+			i->set_size(offset + size);
+	}
+
+	ssize_t grown;
+	ssize_t copied;
+	size_t file_dirty;
+	{
+		std::scoped_lock lock(m);
+		off_t end = offset + size;
+
+		/* the extent the data goes in : the one starting before offset and reaching it, or a new one */
+		auto it = extents.upper_bound(offset);
+		if (it != extents.begin() && std::prev(it)->first + static_cast<off_t>(std::prev(it)->second.size()) >= offset)
+			it = std::prev(it);
+		else
+			it = extents.emplace_hint(it, offset, std::vector<char>());
+
+		size_t old_len = it->second.size();
+		if (it->first + static_cast<off_t>(old_len) < end)
+			it->second.resize(end - it->first);
+		/* A buffer spliced from the kernel lands here with its only copy. If it fails midway
+		   the range is left as it is, its content is unspecified after a failed write anyway. */
+		copied = fill(it->second.data() + (offset - it->first));
+
+		/* The following extents it now reaches are merged, the new data wins where they overlap */
+		size_t absorbed = 0;
+		auto next = std::next(it);
+		while (next != extents.end() && next->first <= it->first + static_cast<off_t>(it->second.size())) {
+			off_t cur_end = it->first + it->second.size();
+			off_t next_end = next->first + next->second.size();
+			if (next_end > cur_end)
+				it->second.insert(it->second.end(), next->second.begin() + (cur_end - next->first), next->second.end());
+			absorbed += next->second.size();
+			next = extents.erase(next);
+		}
+
+		grown = static_cast<ssize_t>(it->second.size() - old_len) - static_cast<ssize_t>(absorbed);
+		if (dirty == 0)
+			dirty_since = system_clock::now();
+		dirty += grown;
+		file_dirty = dirty;
+
+		if (written_end < end)
+			written_end = end;
+		if (grows)
+			size_dirty = true;
+	}
+
+	bool over = false;
+	if (grown > 0)
+		over = owner->add_dirty(grown);
+	else if (grown < 0)
+		owner->sub_dirty(-grown);
+
+	if (over || file_dirty > WRITE_CACHE_FILE_MAX) {
+		int ret = flush();
+		if (ret != 0)
+			return ret;
+	}
+	return copied < 0 ? copied : static_cast<ssize_t>(size);
+}
+
+int write_cache::publish_size(off_t end)
+{
+	if (i->get_loc() == LOCAL) {
+		std::scoped_lock scl{i->inode_mutex};
+		journalctl->chreg(i->get_p_ino(), i);
+		return 0;
+	}
+
+	/* An empty rpc_write raises the size the leader keeps without moving any data,
+	   and drops what the leader caches of the file */
+	std::shared_ptr<remote_inode> remote_i = std::dynamic_pointer_cast<remote_inode>(i);
+	ssize_t ret;
+	while (true) {
+		ret = remote_write(remote_i, nullptr, 0, end, 0, &leader_caches);
+		if (ret == -ENOTLEADER) {
+			indexing_table->find_remote_dentry_table_again(remote_i);
+			continue;
+		} else if (ret == -ENEEDRECOV) {
+			throw std::runtime_error("Need Recovery of remote dentry_table");
+		} else
+			break;
+	}
+	return ret < 0 ? static_cast<int>(ret) : 0;
+}
+
+int write_cache::flush(bool background)
+{
+	std::scoped_lock fl(flush_m);
+
+	std::map<off_t, std::vector<char>> taken;
+	size_t taken_bytes;
+	off_t end;
+	bool send_size;
+	{
+		std::scoped_lock lock(m);
+		taken.swap(extents);
+		taken_bytes = dirty;
+		dirty = 0;
+		end = written_end;
+		written_end = 0;
+		send_size = size_dirty;
+		size_dirty = false;
+	}
+
+	int ret = 0;
+	if (!taken.empty() || send_size) {
+		global_logger.log(file_handler_ops, "Called write_cache::flush(" + std::to_string(taken.size()) + " extents)");
+		try {
+			std::string key = uuid_to_string(i->get_ino());
+			std::vector<std::shared_ptr<rados_io::aio_handle>> handles;
+			for (auto &e : taken)
+				handles.push_back(data_pool->aio_write(obj_category::DATA, key, e.second.data(), e.second.size(), e.first));
+			for (auto &h : handles)
+				h->wait();
+			i->bump_data_version();
+
+			/* the size goes out only after the data it covers, and the leader of a remote file
+			   hears of a flush while its kernel may keep pages, which are dropped after the data lands */
+			if (send_size || (i->get_loc() == REMOTE && !taken.empty() && leader_caches))
+				ret = publish_size(end);
+		} catch (std::exception &e) {
+			global_logger.log(file_handler_ops, std::string("write_cache: flush failed : ") + e.what());
+			ret = -EIO;
+		}
+		owner->sub_dirty(taken_bytes);
+	}
+
+	std::scoped_lock lock(m);
+	if (background) {
+		if (ret != 0)
+			error = ret;
+	} else if (ret == 0 && error != 0) {
+		ret = error;
+		error = 0;
+	}
+	return ret;
+}
+
+bool write_cache::expired(system_clock::time_point now)
+{
+	std::scoped_lock lock(m);
+	return dirty > 0 && now - dirty_since >= milliseconds(WRITE_CACHE_FLUSH_MS);
+}
+
+write_back::write_back(size_t max_dirty) : max_dirty(max_dirty), total_dirty(0), stopping(false)
+{
+	if (enabled())
+		flusher = std::thread(&write_back::flush_loop, this);
+}
+
+write_back::~write_back(void)
+{
+	{
+		std::unique_lock lock(m);
+		stopping = true;
+	}
+	cv.notify_all();
+	if (flusher.joinable())
+		flusher.join();
+}
+
+bool write_back::enabled(void)
+{
+	return max_dirty > 0;
+}
+
+std::shared_ptr<write_cache> write_back::open(std::shared_ptr<inode> i)
+{
+	std::unique_lock lock(m);
+
+	auto it = caches.find(i->get_ino());
+	if (it != caches.end()) {
+		std::shared_ptr<write_cache> c = it->second.lock();
+		if (c != nullptr)
+			return c;
+	}
+
+	std::shared_ptr<write_cache> c = std::make_shared<write_cache>(this, i);
+	caches[i->get_ino()] = c;
+	return c;
+}
+
+int write_back::flush(const uuid &ino)
+{
+	if (total_dirty.load() == 0)
+		return 0;
+
+	std::shared_ptr<write_cache> c;
+	{
+		std::unique_lock lock(m);
+		auto it = caches.find(ino);
+		if (it == caches.end())
+			return 0;
+		c = it->second.lock();
+	}
+	return c != nullptr ? c->flush() : 0;
+}
+
+bool write_back::add_dirty(size_t bytes)
+{
+	bool over = total_dirty.fetch_add(bytes) + bytes > max_dirty;
+	if (over)
+		cv.notify_all();
+	return over;
+}
+
+void write_back::sub_dirty(size_t bytes)
+{
+	total_dirty.fetch_sub(bytes);
+}
+
+void write_back::flush_loop(void)
+{
+	std::unique_lock lock(m);
+	while (!stopping) {
+		cv.wait_for(lock, milliseconds(WRITE_CACHE_FLUSH_MS / 2));
+		if (stopping)
+			break;
+
+		/* Old dirty data goes out, and everything when the limit is crossed */
+		bool over = total_dirty.load() > max_dirty;
+		system_clock::time_point now = system_clock::now();
+		std::vector<std::shared_ptr<write_cache>> open_caches;
+		for (auto it = caches.begin(); it != caches.end();) {
+			std::shared_ptr<write_cache> c = it->second.lock();
+			if (c == nullptr) {
+				it = caches.erase(it);
+				continue;
+			}
+			open_caches.push_back(std::move(c));
+			++it;
+		}
+
+		/* The last reference of a released file may be dropped here, so its destructor flushes outside m */
+		lock.unlock();
+		for (auto &c : open_caches)
+			if (over || c->expired(now))
+				c->flush(true);
+		open_caches.clear();
+		lock.lock();
+	}
+}
@@ -0,0 +1,112 @@
+#ifndef NMFS0_WRITE_CACHE_HPP
+#define NMFS0_WRITE_CACHE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <tsl/robin_map.h>
+
+#include "../fs_ops/fuse_ops.hpp"
+#include "../meta/inode.hpp"
+
+using namespace std::chrono;
+using namespace boost::uuids;
+
+/* -o write_cache_mb when it isn't given : megabytes of dirty data kept by the client, 0 writes through */
+#define DEFAULT_WRITE_CACHE_MB 256
+
+/* A file with more dirty bytes than this is flushed by the write which crossed it */
+#define WRITE_CACHE_FILE_MAX (2 * OBJ_SIZE)
+/* Dirty data older than this is flushed by the flusher thread */
+#define WRITE_CACHE_FLUSH_MS 1000
+
+class write_back;
+
+/*
+ * The dirty data of an open file, shared by the file handlers of the file on this client.
+ * Writes are copied into extents, and an extent overlapping or touching another is merged
+ * with it, so small sequential writes go to the data pool as a few large striped writes.
+ * The size reaches the journal (or the leader of a remote file) once per flush.
+ */
+class write_cache {
+private:
+	write_back *owner;
+	std::shared_ptr<inode> i;
+
+	std::mutex m;
+	/* <offset, data>, disjoint and not touching */
+	std::map<off_t, std::vector<char>> extents;
+	size_t dirty;
+	system_clock::time_point dirty_since;
+	/* the end of the data written since the last flush, sent on flush */
+	off_t written_end;
+	/* a write since the last flush raised the size of the inode */
+	bool size_dirty;
+
+	/* flushes run one at a time so the data reaches the pool in write order */
+	std::mutex flush_m;
+	/* error of a flush nobody waited for, reported by the next flush */
+	int error;
+	/* the leader of a remote file said its kernel may keep pages of it, known from the last flush, flush_m is held */
+	bool leader_caches;
+
+	/* Journals the size of a local file, or sends it to the leader of a remote one with the news of the flush */
+	int publish_size(off_t end);
+	/* fill copies the data to where it goes in the cache and returns the bytes copied */
+	ssize_t write(size_t size, off_t offset, int flags, const std::function<ssize_t(char *)> &fill);
+
+public:
+	write_cache(write_back *owner, std::shared_ptr<inode> i);
+	~write_cache(void);
+
+	/* Returns the bytes written, O_APPEND writes are placed at the end of the file */
+	ssize_t write(const char *buffer, size_t size, off_t offset, int flags);
+	/* Copies a buffer fuse may have spliced from the kernel straight into the cache */
+	ssize_t write(struct fuse_bufvec *src, off_t offset, int flags);
+	/* Writes the dirty data and the size, returns 0 or the error of this or an earlier flush.
+	   A background flush keeps its error for the next one instead. */
+	int flush(bool background = false);
+	bool expired(system_clock::time_point now);
+};
+
+/* The write caches of the open files by ino, their flusher thread and the limit on dirty data */
+class write_back {
+private:
+	std::mutex m;
+	std::condition_variable cv;
+	tsl::robin_map<uuid, std::weak_ptr<write_cache>, boost::hash<uuid>> caches;
+
+	size_t max_dirty;
+	std::atomic<size_t> total_dirty;
+
+	bool stopping;
+	std::thread flusher;
+
+	void flush_loop(void);
+
+public:
+	explicit write_back(size_t max_dirty);
+	~write_back(void);
+
+	bool enabled(void);
+	/* The cache of the file i, made on the first call */
+	std::shared_ptr<write_cache> open(std::shared_ptr<inode> i);
+	/* Flushes the cache of ino, if there is one with dirty data */
+	int flush(const uuid &ino);
+
+	/* Accounting of write_cache, returns whether the dirty data is over the limit */
+	bool add_dirty(size_t bytes);
+	void sub_dirty(size_t bytes);
+};
+
+#endif //NMFS0_WRITE_CACHE_HPP
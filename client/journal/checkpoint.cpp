@@ -1,6 +1,6 @@
 #include "checkpoint.hpp"
 
-checkpoint::checkpoint(std::shared_ptr<rados_io> meta_pool, mqueue<std::shared_ptr<transaction>> *queue) : meta(meta_pool), q(queue)
+checkpoint::checkpoint(std::shared_ptr<rados_io> meta_pool, journal_table *jtable, mqueue<std::shared_ptr<transaction>> *queue) : meta(meta_pool), table(jtable), q(queue)
 {
 }
 
@@ -12,5 +12,6 @@ void checkpoint::operator()(void)
 			break;
 
 		tx->checkpoint(meta);
+		table->done(tx->get_self_ino());
 	}
 }
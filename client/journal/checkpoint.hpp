@@ -1,16 +1,18 @@
 #ifndef _CHECKPOINT_HPP_
 #define _CHECKPOINT_HPP_
 
+#include "journal_table.hpp"
 #include "mqueue.hpp"
 #include "transaction.hpp"
 
 class checkpoint {
 private:
 	std::shared_ptr<rados_io> meta;
+	journal_table *table;
 	mqueue<std::shared_ptr<transaction>> *q;
 
 public:
-	checkpoint(std::shared_ptr<rados_io> meta_pool, mqueue<std::shared_ptr<transaction>> *queue);
+	checkpoint(std::shared_ptr<rados_io> meta_pool, journal_table *jtable, mqueue<std::shared_ptr<transaction>> *queue);
 	~checkpoint(void) = default;
 
 	void operator()(void);
@@ -4,7 +4,7 @@ journal::journal(std::shared_ptr<rados_io> meta_pool, std::shared_ptr<lease_clie
 {
 	commit_thr = std::make_unique<std::thread>(commit(&stopped, meta, &jtable, q));
 	for (int i = 0; i < NUM_CP_THREAD; i++)
-		checkpoint_thr[i] = std::make_unique<std::thread>(checkpoint(meta, &q[i]));
+		checkpoint_thr[i] = std::make_unique<std::thread>(checkpoint(meta, &jtable, &q[i]));
 }
 
 journal::~journal(void)
@@ -18,23 +18,43 @@ journal::~journal(void)
 void journal::check(const uuid &self_ino)
 {
 	global_logger.log(journal_ops, "Called check()");
-	jtable.delete_entry(self_ino);
 
-	std::vector<char> value(OBJ_SIZE);
-	size_t obj_size = meta->read(obj_category::JOURNAL, uuid_to_string(self_ino), value.data(), OBJ_SIZE, 0);
+	/* This client led it last, its own transactions are still on the way */
+	if (jtable.is_pending(self_ino))
+		return;
 
-	size_t index = 0;
-	while (index < obj_size) {
+	size_t obj_size;
+	if (!meta->stat(obj_category::JOURNAL, uuid_to_string(self_ino), obj_size))
+		return;
+
+	std::vector<char> value(obj_size);
+	obj_size = meta->read(obj_category::JOURNAL, uuid_to_string(self_ino), value.data(), obj_size, 0);
+
+	/* Replay the transactions the last leader committed but didn't checkpoint, in order */
+	size_t index = 0, replayed = 0;
+	while (index + sizeof(int32_t) <= obj_size) {
 		int32_t tx_size = *(reinterpret_cast<int32_t *>(&value[index]));
+		if (tx_size <= static_cast<int32_t>(sizeof(int32_t)) || index + tx_size > obj_size)
+			break;	/* torn by a crash while it was being committed */
+
 		std::vector<char> raw(&value[index], &value[index] + tx_size);
 		transaction tx(self_ino);
 		if (!tx.deserialize(raw)) {
 			tx.sync(meta);
-		} else {
-			throw std::runtime_error("journal::check() failed (not implemented yet)");
+			replayed++;
 		}
 		index += tx_size;
 	}
+
+	/* Everything is in the metadata objects now */
+	if (obj_size > 0)
+		meta->remove(obj_category::JOURNAL, uuid_to_string(self_ino));
+	global_logger.log(journal_ops, "Replayed " + std::to_string(replayed) + " transactions of " + uuid_to_string(self_ino));
+}
+
+bool journal::has_pending(const uuid &self_ino)
+{
+	return jtable.is_pending(self_ino);
 }
 
 void journal::mkself(std::shared_ptr<inode> self_inode)
@@ -136,3 +156,51 @@ void journal::chreg(const uuid &self_ino, std::shared_ptr<inode> f_inode)
 			break;
 	}
 }
+
+journal::batch::batch(journal &j, const uuid &self_ino) : j(j), self_ino(self_ino)
+{
+	global_logger.log(journal_ops, "Called journal::batch(" + uuid_to_string(self_ino) + ")");
+}
+
+journal::batch::~batch(void)
+{
+	if (records.empty())
+		return;
+
+	std::shared_ptr<transaction> tx;
+	while (true) {
+		tx = j.jtable.get_entry(self_ino);
+		if (!tx->pin())
+			break;
+	}
+
+	/* The transaction can't be committed while it is pinned, so these don't have to retry */
+	for (const auto &record : records)
+		record(*tx);
+	tx->unpin();
+}
+
+void journal::batch::chself(std::shared_ptr<inode> self_inode)
+{
+	records.emplace_back([self_inode](transaction &tx) { tx.chself(self_inode); });
+}
+
+void journal::batch::mkdir(std::shared_ptr<inode> self_inode, const std::string &d_name, const uuid &d_ino)
+{
+	records.emplace_back([self_inode, d_name, d_ino](transaction &tx) { tx.mkdir(self_inode, d_name, d_ino); });
+}
+
+void journal::batch::mkreg(std::shared_ptr<inode> self_inode, const std::string &f_name, std::shared_ptr<inode> f_inode)
+{
+	records.emplace_back([self_inode, f_name, f_inode](transaction &tx) { tx.mkreg(self_inode, f_name, f_inode); });
+}
+
+void journal::batch::rmreg(std::shared_ptr<inode> self_inode, const std::string &f_name, std::shared_ptr<inode> f_inode)
+{
+	records.emplace_back([self_inode, f_name, f_inode](transaction &tx) { tx.rmreg(self_inode, f_name, f_inode); });
+}
+
+void journal::batch::chreg(std::shared_ptr<inode> f_inode)
+{
+	records.emplace_back([f_inode](transaction &tx) { tx.chreg(f_inode); });
+}
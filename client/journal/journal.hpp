@@ -1,7 +1,9 @@
 #ifndef _JOURNAL_HPP_
 #define _JOURNAL_HPP_
 
+#include <functional>
 #include <thread>
+#include <vector>
 
 #include "checkpoint.hpp"
 #include "commit.hpp"
@@ -22,10 +24,35 @@ private:
 	std::unique_ptr<std::thread> commit_thr, checkpoint_thr[NUM_CP_THREAD];
 
 public:
+	/*
+	 * Puts the operations on one directory into the same transaction.
+	 * They are kept until the batch is destroyed and then appended together,
+	 * the transaction is pinned only while they are appended.
+	 */
+	class batch {
+	private:
+		journal &j;
+		uuid self_ino;
+		std::vector<std::function<void(transaction &)>> records;
+
+	public:
+		batch(journal &j, const uuid &self_ino);
+		~batch(void);
+
+		void chself(std::shared_ptr<inode> self_inode);
+		void mkdir(std::shared_ptr<inode> self_inode, const std::string &d_name, const uuid &d_ino);
+		void mkreg(std::shared_ptr<inode> self_inode, const std::string &f_name, std::shared_ptr<inode> f_inode);
+		void rmreg(std::shared_ptr<inode> self_inode, const std::string &f_name, std::shared_ptr<inode> f_inode);
+		void chreg(std::shared_ptr<inode> f_inode);
+	};
+
 	journal(std::shared_ptr<rados_io> meta_pool, std::shared_ptr<lease_client> lease);
 	~journal(void);
 
+	/* Replays the journal of a directory this client has just become the leader of */
 	void check(const uuid &self_ino);
+	/* Whether the directory has transactions not checkpointed yet, its lease has to be kept until they are */
+	bool has_pending(const uuid &self_ino);
 
 	/* self */
 	void mkself(std::shared_ptr<inode> self_inode);
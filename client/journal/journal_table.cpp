@@ -10,7 +10,11 @@ void journal_table::delete_entry(const uuid &ino)
 	global_logger.log(journal_table_ops, "Called delete_entry(" + to_string(ino) + ")");
 
 	std::unique_lock lock(sm);
-	map->erase(ino);
+	if (map->erase(ino)) {
+		auto it = pending.find(ino);
+		if (it != pending.end() && --it.value() == 0)
+			pending.erase(it);
+	}
 }
 
 std::shared_ptr<transaction> journal_table::get_entry(const uuid &ino)
@@ -28,6 +32,7 @@ std::shared_ptr<transaction> journal_table::get_entry(const uuid &ino)
 		std::unique_lock lock(sm);
 		auto ret = map->insert({ino, nullptr});
 		if (ret.second) {
+			pending[ino]++;
 			return ret.first.value() = std::make_shared<transaction>(ino);
 		} else {
 			return ret.first->second;
@@ -45,3 +50,19 @@ std::unique_ptr<journal_map> journal_table::replace_map(void)
 	map = std::make_unique<journal_map>();
 	return temp;
 }
+
+void journal_table::done(const uuid &ino)
+{
+	global_logger.log(journal_table_ops, "Called done(" + to_string(ino) + ")");
+
+	std::unique_lock lock(sm);
+	auto it = pending.find(ino);
+	if (it != pending.end() && --it.value() == 0)
+		pending.erase(it);
+}
+
+bool journal_table::is_pending(const uuid &ino)
+{
+	std::shared_lock lock(sm);
+	return pending.find(ino) != pending.end();
+}
@@ -20,6 +20,9 @@ private:
 	std::shared_mutex sm;
 	std::unique_ptr<journal_map> map;
 
+	/* The number of transactions of each directory not checkpointed yet */
+	tsl::robin_map<uuid, int, boost::hash<uuid>> pending;
+
 public:
 	journal_table(void);
 	~journal_table(void) = default;
@@ -27,6 +30,8 @@ public:
 	void delete_entry(const uuid &ino);				/* for check */
 	std::shared_ptr<transaction> get_entry(const uuid &ino);	/* for operation */
 	std::unique_ptr<journal_map> replace_map(void);			/* for commit */
+	void done(const uuid &ino);					/* for checkpoint */
+	bool is_pending(const uuid &ino);
 };
 
 #endif /* _JOURNAL_TABLE_HPP_ */
@@ -87,7 +87,7 @@ int transaction::deserialize(std::vector<char> raw)
 	if (s_inode_size != -1) {	/* finished? */
 		s_inode = std::make_unique<inode>(JOURNAL);
 		s_inode->deserialize(&raw[index]);
-		index += sizeof(inode);
+		index += s_inode_size;
 	}
 
 	/* dentries */
@@ -130,10 +130,15 @@ int transaction::deserialize(std::vector<char> raw)
 	return 0;
 }
 
-transaction::transaction(const uuid &self_ino) : committed(false), status(self_status::S_UNCHANGED), s_ino(self_ino), s_inode(nullptr)
+transaction::transaction(const uuid &self_ino) : committed(false), pins(0), status(self_status::S_UNCHANGED), s_ino(self_ino), s_inode(nullptr)
 {
 }
 
+const uuid &transaction::get_self_ino(void)
+{
+	return s_ino;
+}
+
 int transaction::mkself(std::shared_ptr<inode> self_inode)
 {
 	global_logger.log(transaction_ops, "Called transaction::mkself(" + to_string(self_inode->get_ino()) + ")");
@@ -394,7 +399,7 @@ void transaction::sync(std::shared_ptr<rados_io> meta)
 
 	if (status == self_status::S_DELETED) {
 		meta->remove(obj_category::INODE, to_string(s_ino));
-		meta->remove(obj_category::DENTRY, to_string(s_ino));
+		dentry::remove(s_ino);
 		return;
 	}
 
@@ -402,20 +407,22 @@ void transaction::sync(std::shared_ptr<rados_io> meta)
 	if (s_inode)
 		s_inode->sync();
 
-	/* dentries */
-	dentry d(s_ino, status == self_status::S_CREATED);
+	/* dentries, only the changed names are written */
+	std::map<std::string, uuid> added;
+	std::set<std::string> deleted;
 	for (const auto &p : dentries) {
 		bool alive = p.second.first;
 		std::string name = p.first;
 		uuid ino = p.second.second;
 
 		if (alive) {
-			d.add_child(name, ino);
+			added.insert({name, ino});
 		} else {
-			d.delete_child(name);
+			deleted.insert(name);
 		}
 	}
-	d.sync();
+	if (status == self_status::S_CREATED || !added.empty() || !deleted.empty())
+		dentry::sync_changes(s_ino, added, deleted);
 
 	/* f_inodes */
 	for (const auto &p : f_inodes)
@@ -423,12 +430,32 @@ void transaction::sync(std::shared_ptr<rados_io> meta)
 			p.second->sync();
 }
 
+int transaction::pin(void)
+{
+	std::unique_lock lock(m);
+
+	if (committed)
+		return -1;
+
+	pins++;
+	return 0;
+}
+
+void transaction::unpin(void)
+{
+	std::unique_lock lock(m);
+
+	if (--pins == 0)
+		unpinned.notify_all();
+}
+
 void transaction::commit(std::shared_ptr<rados_io> meta)
 {
 	global_logger.log(transaction_ops, "Called commit()");
 
 	{
 		std::unique_lock lock(m);
+		unpinned.wait(lock, [this] { return pins == 0; });
 
 		if (committed)
 			throw std::logic_error("transaction::commit() failed (tx has been already committed)");
@@ -452,6 +479,6 @@ void transaction::checkpoint(std::shared_ptr<rados_io> meta)
 	/* Synchronize */
 	sync(meta);
 
-	/* Clear the checkpoint bit */
-	meta->write(obj_category::JOURNAL, to_string(s_ino), "\0", 1, offset);
+	/* Clear the valid bit, it follows the total size */
+	meta->write(obj_category::JOURNAL, to_string(s_ino), "\0", 1, offset + sizeof(int32_t));
 }
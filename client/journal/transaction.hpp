@@ -2,6 +2,7 @@
 #define _TRANSACTION_HPP_
 
 #include <atomic>
+#include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <stdexcept>
@@ -31,6 +32,10 @@ private:
 	/* Has this transaction already been committed? */
 	std::atomic<bool> committed;
 
+	/* The number of journal::batch holding this transaction, it isn't committed until they are gone */
+	int pins;
+	std::condition_variable unpinned;
+
 	/* the offset for this transaction in the journal object */
 	off_t offset;
 
@@ -58,6 +63,8 @@ public:
 	transaction(const uuid &self_ino);
 	~transaction(void) = default;
 
+	const uuid &get_self_ino(void);
+
 	/* self */
 	int mkself(std::shared_ptr<inode> self_inode);
 	int rmself(const uuid &self_ino);
@@ -74,6 +81,10 @@ public:
 	int mvreg(std::shared_ptr<inode> self_inode, const std::string &src_f_name, const uuid &src_f_ino, const std::string &dst_f_name, const uuid &dst_f_ino);
 	int chreg(std::shared_ptr<inode> f_inode);
 
+	/* Keeps the transaction from being committed, fails if it already has been */
+	int pin(void);
+	void unpin(void);
+
 	std::vector<char> serialize(void);
 	int deserialize(std::vector<char> raw);
 
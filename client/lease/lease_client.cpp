@@ -4,8 +4,20 @@ using grpc::ClientContext;
 using grpc::Status;
 
 lease_client::lease_client(std::shared_ptr<Channel> channel, const std::string &self_remote)
-		: stub(lease::NewStub(channel)), remote(self_remote)
+		: stub(lease::NewStub(channel)), remote(self_remote), stopping(false)
 {
+	renewer = std::thread(&lease_client::renew_loop, this);
+}
+
+lease_client::~lease_client(void)
+{
+	{
+		std::unique_lock lock(m);
+		stopping = true;
+	}
+	cv.notify_all();
+	if (renewer.joinable())
+		renewer.join();
 }
 
 bool lease_client::is_valid(uuid ino)
@@ -18,6 +30,23 @@ bool lease_client::is_mine(uuid ino)
 	return table.is_mine(ino);
 }
 
+system_clock::time_point lease_client::get_due(uuid ino)
+{
+	return table.get_due(ino);
+}
+
+void lease_client::keep_while(std::function<bool(const uuid &)> is_busy)
+{
+	std::unique_lock lock(m);
+	busy = std::move(is_busy);
+}
+
+void lease_client::on_lost(std::function<void(const uuid &, const std::string &)> lost_lease)
+{
+	std::unique_lock lock(m);
+	lost = std::move(lost_lease);
+}
+
 int lease_client::acquire(uuid ino, std::string &remote_addr)
 {
 	if (table.is_mine(ino))
@@ -49,3 +78,104 @@ int lease_client::acquire(uuid ino, std::string &remote_addr)
 		throw std::runtime_error("lease_client::acquire() failed");
 	}
 }
+
+void lease_client::acquire_all(const std::vector<uuid> &inos, std::vector<int> &rets, std::vector<std::string> &remote_addrs)
+{
+	rets.assign(inos.size(), 0);
+	remote_addrs.assign(inos.size(), "");
+
+	acquire_all_request request;
+	std::vector<size_t> asked;
+	for (size_t n = 0; n < inos.size(); n++) {
+		if (table.is_mine(inos[n]))
+			continue;
+
+		lease_ino *i = request.add_inos();
+		i->set_ino_prefix(uuid_controller::get_prefix_from_uuid(inos[n]));
+		i->set_ino_postfix(uuid_controller::get_postfix_from_uuid(inos[n]));
+		asked.push_back(n);
+	}
+	if (asked.empty())
+		return;
+	request.set_remote_addr(remote);
+
+	acquire_all_response response;
+
+	ClientContext context;
+
+	Status status = stub->acquire_all(&context, request, &response);
+
+	if (status.ok() && response.ret_size() == static_cast<int>(asked.size())) {
+		for (int k = 0; k < response.ret_size(); k++) {
+			size_t n = asked[k];
+			rets[n] = response.ret(k);
+
+			system_clock::time_point due{system_clock::duration{response.due(k)}};
+			table.update(inos[n], due, static_cast<bool>(!rets[n]));
+
+			if (rets[n])
+				remote_addrs[n] = response.remote_addr(k);
+		}
+	} else {
+		std::cerr << "[" << status.error_code() << "] " << status.error_message() << std::endl;
+		throw std::runtime_error("lease_client::acquire_all() failed");
+	}
+}
+
+void lease_client::renew_loop(void)
+{
+	std::unique_lock lock(m);
+	while (!stopping) {
+		cv.wait_for(lock, milliseconds(LEASE_RENEW_CHECK_MS), [this] { return stopping; });
+		if (stopping)
+			break;
+
+		std::function<bool(const uuid &)> is_busy = busy;
+		lock.unlock();
+		std::vector<uuid> inos = table.get_renewable(system_clock::now() + milliseconds(LEASE_RENEW_MARGIN_MS), is_busy);
+		for (size_t begin = 0; begin < inos.size(); begin += LEASE_RENEW_BATCH)
+			renew(std::vector<uuid>(inos.begin() + begin, inos.begin() + std::min(inos.size(), begin + LEASE_RENEW_BATCH)));
+		lock.lock();
+	}
+}
+
+void lease_client::renew(const std::vector<uuid> &inos)
+{
+	global_logger.log(lease_ops, "Called renew(" + std::to_string(inos.size()) + " leases)");
+
+	renew_request request;
+	for (auto &ino : inos) {
+		lease_ino *i = request.add_inos();
+		i->set_ino_prefix(uuid_controller::get_prefix_from_uuid(ino));
+		i->set_ino_postfix(uuid_controller::get_postfix_from_uuid(ino));
+	}
+	request.set_remote_addr(remote);
+
+	renew_response response;
+
+	ClientContext context;
+
+	Status status = stub->renew(&context, request, &response);
+
+	/* The next check tries again, until the leases expire */
+	if (!status.ok() || response.ret_size() != static_cast<int>(inos.size())) {
+		std::cerr << "[" << status.error_code() << "] " << status.error_message() << std::endl;
+		table.set_used(inos);
+		return;
+	}
+
+	std::function<void(const uuid &, const std::string &)> lost_lease;
+	{
+		std::unique_lock lock(m);
+		lost_lease = lost;
+	}
+
+	for (int n = 0; n < response.ret_size(); n++) {
+		system_clock::time_point due{system_clock::duration{response.due(n)}};
+		table.update(inos[n], due, !response.ret(n));
+
+		/* The lease may already be someone else's, what this client kept of the directory is stale */
+		if (response.ret(n) && lost_lease)
+			lost_lease(inos[n], n < response.remote_addr_size() ? response.remote_addr(n) : "");
+	}
+}
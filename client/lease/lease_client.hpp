@@ -1,8 +1,12 @@
 #ifndef _LEASE_CLIENT_HPP_
 #define _LEASE_CLIENT_HPP_
 
+#include <condition_variable>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 
 #include <grpcpp/grpcpp.h>
 
@@ -14,12 +18,34 @@
 using grpc::Channel;
 using namespace boost::uuids;
 
+/* How long before its due a lease is renewed, well under LEASE_PERIOD_MS of the manager */
+#define LEASE_RENEW_MARGIN_MS 3000
+/* How often the renewer looks for leases to renew */
+#define LEASE_RENEW_CHECK_MS 500
+/* How many leases go in one renew() call at most */
+#define LEASE_RENEW_BATCH 4096
+
+/*
+ * The leases of this client are renewed in the background.
+ * Those this client leads and has used since the last renewal, or which are busy, are renewed
+ * in batches once the earliest is about to expire, a lease nobody uses is left to expire.
+ */
 class lease_client {
 private:
 	std::unique_ptr<lease::Stub> stub;
 	std::string remote;
 	lease_table_client table;
 
+	std::mutex m;
+	std::condition_variable cv;
+	bool stopping;
+	std::thread renewer;
+	std::function<bool(const uuid &)> busy;
+	std::function<void(const uuid &, const std::string &)> lost;
+
+	void renew_loop(void);
+	void renew(const std::vector<uuid> &inos);
+
 public:
 	/*
 	 * lease_client()
@@ -27,7 +53,7 @@ public:
 	 * 'self_remote' should be the remote server address of itself
 	 */
 	lease_client(std::shared_ptr<Channel> channel, const std::string &self_remote);
-	~lease_client(void) = default;
+	~lease_client(void);
 
 	/*
 	 * is_valid()
@@ -56,6 +82,30 @@ public:
 	 */
 	bool is_mine(uuid ino);
 
+	/*
+	 * get_due()
+	 *
+	 * Return when the lease for the ino expires as far as this client knows.
+	 * The caches bounded by a lease keep their entries until then.
+	 */
+	system_clock::time_point get_due(uuid ino);
+
+	/*
+	 * keep_while()
+	 *
+	 * The leases for which 'is_busy' returns true are renewed even when unused.
+	 */
+	void keep_while(std::function<bool(const uuid &)> is_busy);
+
+	/*
+	 * on_lost()
+	 *
+	 * 'lost_lease' is called with the ino of every lease the renewer couldn't renew,
+	 * from then on this client is not the leader of the directory.
+	 * The address is that of the new leader, "" if the manager doesn't know one.
+	 */
+	void on_lost(std::function<void(const uuid &, const std::string &)> lost_lease);
+
 	/*
 	 * acquire()
 	 *
@@ -67,6 +117,14 @@ public:
 	 * - 'remote_addr' is changed to the address of the directory leader'
 	 */
 	int acquire(uuid ino, std::string &remote_addr);
+
+	/*
+	 * acquire_all()
+	 *
+	 * acquire() for every ino of 'inos' in one call,
+	 * 'rets' and 'remote_addrs' get what acquire() returns and changes for each of them
+	 */
+	void acquire_all(const std::vector<uuid> &inos, std::vector<int> &rets, std::vector<std::string> &remote_addrs);
 };
 
 #endif /* _LEASE_CLIENT_HPP_ */
@@ -14,7 +14,7 @@ std::string serializeTimePoint(const std::chrono::system_clock::time_point& time
 	return ss.str();
 }
 
-lease_table_client::lease_entry::lease_entry(const system_clock::time_point &new_due, bool mine) : due(new_due), leader(mine)
+lease_table_client::lease_entry::lease_entry(const system_clock::time_point &new_due, bool mine) : due(new_due), leader(mine), used(true)
 {
 }
 
@@ -62,6 +62,8 @@ bool lease_table_client::is_valid(uuid ino)
 			return false;
 		}
 	}
+	e->used.store(true, std::memory_order_relaxed);
+
 	const std::chrono::system_clock::time_point input = system_clock::now();
 	global_logger.log(lease_ops, "system_clock::now: " + serializeTimePoint(input, "UTC: %Y-%m-%d %H:%M:%S"));
 	global_logger.log(lease_ops, "e->get_due(): " + serializeTimePoint(e->get_due(), "UTC: %Y-%m-%d %H:%M:%S"));
@@ -95,6 +97,23 @@ bool lease_table_client::is_mine(uuid ino)
 	return mine && (system_clock::now() < latest_due);
 }
 
+system_clock::time_point lease_table_client::get_due(uuid ino)
+{
+	lease_entry *e;
+
+	{
+		std::shared_lock lock(sm);
+		auto it = map.find(ino);
+		if (it != map.end()) {
+			e = it->second;
+		} else {
+			return system_clock::time_point{};
+		}
+	}
+
+	return e->get_due();
+}
+
 void lease_table_client::update(uuid ino, const system_clock::time_point &new_due, bool mine)
 {
 	global_logger.log(lease_ops, "Called update(" + to_string(ino) + ")");
@@ -127,3 +146,43 @@ void lease_table_client::update(uuid ino, const system_clock::time_point &new_du
 		}
 	}
 }
+
+std::vector<uuid> lease_table_client::get_renewable(const system_clock::time_point &before, const std::function<bool(const uuid &)> &is_busy)
+{
+	std::vector<uuid> inos;
+	std::vector<lease_entry *> entries;
+	system_clock::time_point now = system_clock::now(), earliest = system_clock::time_point::max();
+	system_clock::time_point latest_due;
+	bool mine;
+
+	std::shared_lock lock(sm);
+	for (auto &it : map) {
+		std::tie(latest_due, mine) = it.second->get_info();
+		if (!mine || latest_due <= now)
+			continue;
+		if (!it.second->used.load(std::memory_order_relaxed) && !(is_busy && is_busy(it.first)))
+			continue;
+
+		inos.push_back(it.first);
+		entries.push_back(it.second);
+		earliest = std::min(earliest, latest_due);
+	}
+
+	/* Renewing them all together keeps their dues in step, so one call renews everything per period */
+	if (earliest >= before)
+		return {};
+
+	for (auto e : entries)
+		e->used.store(false, std::memory_order_relaxed);
+	return inos;
+}
+
+void lease_table_client::set_used(const std::vector<uuid> &inos)
+{
+	std::shared_lock lock(sm);
+	for (auto &ino : inos) {
+		auto it = map.find(ino);
+		if (it != map.end())
+			it->second->used.store(true, std::memory_order_relaxed);
+	}
+}
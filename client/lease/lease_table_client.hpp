@@ -1,9 +1,12 @@
 #ifndef _LEASE_TABLE_CLIENT_HPP_
 #define _LEASE_TABLE_CLIENT_HPP_
 
+#include <atomic>
 #include <chrono>
+#include <functional>
 #include <shared_mutex>
 #include <tuple>
+#include <vector>
 
 #include <boost/functional/hash.hpp>
 #include <boost/uuid/uuid.hpp>
@@ -25,6 +28,9 @@ private:
 		bool leader;
 
 	public:
+		/* Whether the lease has been checked since it was last renewed */
+		std::atomic<bool> used;
+
 		lease_entry(const system_clock::time_point &new_due, bool mine);
 		~lease_entry(void) = default;
 
@@ -42,7 +48,20 @@ public:
 
 	bool is_valid(uuid ino);
 	bool is_mine(uuid ino);
+	/* The epoch if there is no lease for the ino */
+	system_clock::time_point get_due(uuid ino);
 	void update(uuid ino, const system_clock::time_point &new_due, bool mine);
+
+	/*
+	 * get_renewable()
+	 *
+	 * The valid leases of this client used since they were last renewed or for which 'is_busy' is true,
+	 * all of them once the earliest one is due before 'before', none otherwise.
+	 * The leases returned count as unused until they are checked again.
+	 */
+	std::vector<uuid> get_renewable(const system_clock::time_point &before, const std::function<bool(const uuid &)> &is_busy);
+	/* Count the leases as used again, when they couldn't be renewed */
+	void set_used(const std::vector<uuid> &inos);
 };
 
 #endif /* _LEASE_TABLE_CLIENT_HPP_ */
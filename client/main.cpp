@@ -1,9 +1,29 @@
-#include "fs_ops/fuse_ops.hpp"
+#include <cstddef>
+
+#include "fs_ops/fuse_ll_ops.hpp"
+
+extern struct mount_options nmfs_options;
+
+static const struct fuse_opt nmfs_opt_spec[] = {
+	{"prefetch=%u", offsetof(struct mount_options, prefetch_batch), 0},
+	{"attr_ttl=%u", offsetof(struct mount_options, attr_ttl_ms), 0},
+	{"rpc_cq_threads=%u", offsetof(struct mount_options, rpc_cq_threads), 0},
+	{"rpc_workers=%u", offsetof(struct mount_options, rpc_workers), 0},
+	{"async_creates=%u", offsetof(struct mount_options, async_creates), 0},
+	{"rpc_channels=%u", offsetof(struct mount_options, rpc_channels), 0},
+	{"write_cache_mb=%u", offsetof(struct mount_options, write_cache_mb), 0},
+	{"kernel_ttl=%u", offsetof(struct mount_options, kernel_ttl_ms), 0},
+	FUSE_OPT_END
+};
 
 int main(int argc, char *argv[])
 {
-	/* ./nmfs ARGS MOUNT_POINT "MANAGE_IP:PORT,REMOTE_IP:PORT" */
-	fuse_operations fops = fuse_ops::get_fuse_ops();
-	fuse_main(argc-1, argv, &fops, argv[argc-1]);
-	return 0;
+	/* ./nmfs ARGS MOUNT_POINT "MANAGE_IP:PORT,REMOTE_IP:PORT[,BACKEND]" */
+	struct fuse_args args = FUSE_ARGS_INIT(argc-1, argv);
+	if (fuse_opt_parse(&args, &nmfs_options, nmfs_opt_spec, nullptr) == -1)
+		return 1;
+
+	int ret = fuse_ll_ops::run(&args, argv[argc-1]);
+	fuse_opt_free_args(&args);
+	return ret;
 }
@@ -1,28 +1,232 @@
 #include "dentry.hpp"
 
+#include <algorithm>
+#include <tuple>
+
+#include <boost/functional/hash.hpp>
+
 extern std::shared_ptr<rados_io> meta_pool;
 
+/* The fragments of a directory are read and written under one of these */
+#define NUM_FRAG_MUTEXES 64
+static std::mutex frag_mutexes[NUM_FRAG_MUTEXES];
+
+static std::mutex &get_frag_mutex(const uuid &ino)
+{
+	return frag_mutexes[boost::hash<uuid>()(ino) % NUM_FRAG_MUTEXES];
+}
+
+static std::string ino_to_value(const uuid &ino)
+{
+	return std::string(reinterpret_cast<const char *>(ino.data), sizeof(uuid));
+}
+
+static uuid value_to_ino(const std::string &value)
+{
+	uuid ino{};
+	memcpy(&ino, value.data(), sizeof(uuid));
+	return ino;
+}
+
+/* FNV-1a, it must not change between clients */
+static uint32_t hash_name(const std::string &name)
+{
+	uint32_t hash = 2166136261u;
+	for (unsigned char c : name) {
+		hash ^= c;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static uint32_t frag_first(uint32_t bits, uint32_t value)
+{
+	return bits ? value << (32 - bits) : 0;
+}
+
+static bool frag_contains(uint32_t bits, uint32_t value, uint32_t hash)
+{
+	return bits == 0 || (hash >> (32 - bits)) == value;
+}
+
+static std::string frag_key(const uuid &ino, uint32_t bits, uint32_t value)
+{
+	/* The root fragment is the dentry object itself */
+	if (bits == 0)
+		return uuid_to_string(ino);
+	return uuid_to_string(ino) + "." + std::to_string(bits) + "." + std::to_string(value);
+}
+
+static std::string fragtree_key(const uuid &ino)
+{
+	return uuid_to_string(ino) + ".frag";
+}
+
+/* The leaves ordered by their first hash, a directory which has never been split has only the root */
+static std::map<uint32_t, dentry::frag_info> read_fragtree(const uuid &ino)
+{
+	std::map<uint32_t, dentry::frag_info> leaves;
+	size_t size;
+
+	if (!meta_pool->stat(obj_category::DENTRY, fragtree_key(ino), size) || size < sizeof(uint32_t)) {
+		leaves.insert({0, {0, 0, 0}});
+		return leaves;
+	}
+
+	std::vector<char> raw(size);
+	meta_pool->read(obj_category::DENTRY, fragtree_key(ino), raw.data(), size, 0);
+
+	uint32_t num;
+	memcpy(&num, raw.data(), sizeof(uint32_t));
+	const char *pointer = raw.data() + sizeof(uint32_t);
+	for (uint32_t n = 0; n < num; n++) {
+		dentry::frag_info info{};
+		memcpy(&info, pointer, sizeof(dentry::frag_info));
+		pointer += sizeof(dentry::frag_info);
+		leaves.insert({frag_first(info.bits, info.value), info});
+	}
+
+	return leaves;
+}
+
+static void write_fragtree(const uuid &ino, const std::map<uint32_t, dentry::frag_info> &leaves)
+{
+	/* It only grows, so it's enough to write it from the start. */
+	std::vector<char> raw(sizeof(uint32_t) + leaves.size() * sizeof(dentry::frag_info));
+
+	uint32_t num = static_cast<uint32_t>(leaves.size());
+	memcpy(raw.data(), &num, sizeof(uint32_t));
+	char *pointer = raw.data() + sizeof(uint32_t);
+	for (auto &leaf : leaves) {
+		memcpy(pointer, &leaf.second, sizeof(dentry::frag_info));
+		pointer += sizeof(dentry::frag_info);
+	}
+
+	meta_pool->write(obj_category::DENTRY, fragtree_key(ino), raw.data(), raw.size(), 0);
+}
+
+static void read_frag_omap(const std::string &key, std::map<std::string, std::string> &kvs)
+{
+	/* page through the omap */
+	std::string last_name;
+	bool more = true;
+	while (more) {
+		std::map<std::string, std::string> page;
+		more = meta_pool->omap_get(obj_category::DENTRY, key, last_name, DENTRY_OMAP_PAGE, page);
+
+		if (!page.empty())
+			last_name = page.rbegin()->first;
+		kvs.merge(page);
+	}
+}
+
+/*
+ * Splits a leaf until every piece is small enough.
+ * The new leaves are written before the caller writes the fragtree,
+ * so a crash in between leaves only unreferenced objects behind.
+ */
+static void split_fragment(const uuid &ino, dentry::frag_info leaf, std::map<uint32_t, dentry::frag_info> &leaves, std::vector<dentry::frag_info> &stale)
+{
+	global_logger.log(dentry_ops, "Split a fragment (" + std::to_string(leaf.bits) + ", " + std::to_string(leaf.value) + ") of " + uuid_to_string(ino));
+
+	std::map<std::string, std::string> kvs;
+	read_frag_omap(frag_key(ino, leaf.bits, leaf.value), kvs);
+
+	std::map<std::string, std::string> halves[2];
+	for (auto &kv : kvs)
+		halves[(hash_name(kv.first) >> (31 - leaf.bits)) & 1].insert(kv);
+
+	leaves.erase(frag_first(leaf.bits, leaf.value));
+	stale.push_back(leaf);
+
+	for (uint32_t half = 0; half < 2; half++) {
+		dentry::frag_info child{leaf.bits + 1, (leaf.value << 1) | half, halves[half].size()};
+		meta_pool->omap_update(obj_category::DENTRY, frag_key(ino, child.bits, child.value), halves[half], {});
+		leaves.insert({frag_first(child.bits, child.value), child});
+
+		if (child.count > DENTRY_FRAG_MAX_CHILDREN && child.bits < DENTRY_FRAG_MAX_BITS)
+			split_fragment(ino, child, leaves, stale);
+	}
+}
+
 dentry::dentry(uuid ino, bool mkdir) : this_ino(ino)
 {
 	if(mkdir){
 		global_logger.log(dentry_ops, "Called dentry(" + uuid_to_string(ino) +") from mkdir");
+		this->frags.insert({0, {0, 0, true, {}}});
 	} else {
 		global_logger.log(dentry_ops, "Called dentry(" + uuid_to_string(ino) +")");
-		unique_ptr<char[]> raw_data = std::make_unique<char[]>(MAX_DENTRY_OBJ_SIZE);
-		try {
-			meta_pool->read(obj_category::DENTRY, uuid_to_string(ino), raw_data.get(), MAX_DENTRY_OBJ_SIZE, 0);
-			this->deserialize(raw_data.get());
-		} catch(rados_io::no_such_object &e){
-			throw std::runtime_error("Dentry Corrupted: inode number " + uuid_to_string(ino));
+		/* Only the fragtree is read here, the fragments are loaded when they are needed. */
+		std::unique_lock lock(get_frag_mutex(ino));
+		for (auto &leaf : read_fragtree(ino))
+			this->frags.insert({leaf.first, {leaf.second.bits, leaf.second.value, false, {}}});
+	}
+}
+
+dentry::fragment &dentry::get_fragment(const std::string &name, bool load)
+{
+	auto it = this->frags.upper_bound(hash_name(name));
+	it--;
+
+	if (load && !it->second.loaded)
+		this->load_fragment(it->second);
+
+	return it->second;
+}
+
+void dentry::load_fragment(fragment &f)
+{
+	global_logger.log(dentry_ops, "Called dentry.load_fragment(" + std::to_string(f.bits) + ", " + std::to_string(f.value) + ")");
+	std::unique_lock lock(get_frag_mutex(this->this_ino));
+
+	/* The fragment may have been split since the fragtree was read, then it is loaded from its leaves. */
+	size_t legacy_size = 0;
+	try {
+		for (auto &leaf : read_fragtree(this->this_ino)) {
+			frag_info &info = leaf.second;
+			if (info.bits < f.bits || !frag_contains(f.bits, f.value, leaf.first))
+				continue;
+
+			std::map<std::string, std::string> kvs;
+			read_frag_omap(frag_key(this->this_ino, info.bits, info.value), kvs);
+			for (auto &kv : kvs)
+				f.children.insert(std::make_pair(kv.first, value_to_ino(kv.second)));
+
+			if (info.bits == 0 && f.children.empty())
+				meta_pool->stat(obj_category::DENTRY, uuid_to_string(this->this_ino), legacy_size);
 		}
+	} catch(rados_io::no_such_object &e){
+		throw std::runtime_error("Dentry Corrupted: inode number " + uuid_to_string(this->this_ino));
 	}
+	f.loaded = true;
+	lock.unlock();
+
+	if (legacy_size > 0)
+		this->load_legacy(f, legacy_size);
+}
+
+void dentry::load_legacy(fragment &f, size_t size)
+{
+	global_logger.log(dentry_ops, "Called dentry.load_legacy()");
+
+	unique_ptr<char[]> raw_data = std::make_unique<char[]>(size);
+	meta_pool->read(obj_category::DENTRY, uuid_to_string(this->this_ino), raw_data.get(), size, 0);
+	this->deserialize(raw_data.get());
+
+	if (f.children.empty())
+		return;
+
+	/* Move the entries to the omap and leave an empty list behind */
+	this->sync();
+	size_t child_num = 0;
+	meta_pool->write(obj_category::DENTRY, uuid_to_string(this->this_ino), reinterpret_cast<char *>(&child_num), sizeof(size_t), 0);
 }
 
 void dentry::add_child(const std::string &filename, uuid ino){
 	global_logger.log(dentry_ops, "Called dentry.add_child()");
 	global_logger.log(dentry_ops, "file : " + filename + " inode number : " + uuid_to_string(ino));
 
-	auto ret = this->child_list.insert(std::make_pair(filename, ino));
+	auto ret = this->get_fragment(filename).children.insert(std::make_pair(filename, ino));
 	if(!ret.second) {
 		global_logger.log(dentry_ops, "Replace file with new ino");
 		ret.first.value() = ino;
@@ -33,43 +237,15 @@ void dentry::delete_child(const std::string &filename) {
 	global_logger.log(dentry_ops, "Called dentry.delete_child()");
 	global_logger.log(dentry_ops, "file : " + filename);
 
-	auto it = this->child_list.find(filename);
-	if(it != this->child_list.end()) {
-		this->child_list.erase(it);
+	auto &children = this->get_fragment(filename).children;
+	auto it = children.find(filename);
+	if(it != children.end()) {
+		children.erase(it);
 	} else {
 		global_logger.log(dentry_ops, "delete_child called for nonexistent file");
 	}
 }
 
-unique_ptr<char[]> dentry::serialize()
-{
-	global_logger.log(dentry_ops, "Called dentry.serialize()");
-	size_t child_num = this->child_list.size();
-	size_t raw_size = sizeof(size_t) + (child_num) * sizeof(int) + (this->get_total_name_length()) + (child_num)*sizeof(uuid);
-	unique_ptr<char[]> raw = std::make_unique<char[]>(raw_size + 1);
-	char *pointer = raw.get();
-
-	memcpy(pointer, &(child_num), sizeof(size_t));
-	pointer += sizeof(size_t);
-
-	for(auto & it : this->child_list){
-		/* serialiize name length */
-		int name_length = static_cast<int>(it.first.length());
-		memcpy(pointer, &(name_length), sizeof(int));
-		pointer += sizeof(int);
-
-		/* serialize name */
-		memcpy(pointer, it.first.data(), static_cast<size_t>(name_length));
-		pointer += name_length;
-
-		/* serialize ino */
-		memcpy(pointer, &(it.second), sizeof(uuid));
-		pointer += sizeof(uuid);
-	}
-
-	return raw;
-}
-
 void dentry::deserialize(char *raw)
 {
 	global_logger.log(dentry_ops, "Called dentry.deserialize()");
@@ -94,7 +270,7 @@ void dentry::deserialize(char *raw)
 		memcpy(&ino, pointer, sizeof(uuid));
 		pointer += sizeof(uuid);
 
-		this->child_list.insert(std::pair<std::string, uuid>(name.get(), ino));
+		this->get_fragment(name.get(), false).children.insert(std::pair<std::string, uuid>(name.get(), ino));
 		global_logger.log(dentry_ops, "name_length : " + std::to_string(name_length) + "child name : " + std::string(name.get()) + " child ino : " + uuid_to_string(ino));
 	}
 
@@ -103,41 +279,179 @@ void dentry::deserialize(char *raw)
 void dentry::sync()
 {
 	global_logger.log(dentry_ops,"Called dentry.sync()");
-	size_t child_num = this->child_list.size();
-	size_t raw_size = sizeof(size_t) + (child_num) * sizeof(int) + (this->get_total_name_length()) + (child_num)*sizeof(uuid);
-	unique_ptr<char[]> raw = this->serialize();
-	meta_pool->write(obj_category::DENTRY, uuid_to_string(this->this_ino), raw.get(), raw_size, 0);
+	std::map<std::string, uuid> added;
+	this->for_each_child([&added](const std::string &name, const uuid &ino) {
+		added.insert({name, ino});
+	});
+
+	sync_changes(this->this_ino, added, {});
+}
+
+void dentry::sync_changes(uuid ino, const std::map<std::string, uuid> &added, const std::set<std::string> &deleted)
+{
+	global_logger.log(dentry_ops,"Called dentry::sync_changes(" + uuid_to_string(ino) + ")");
+	std::unique_lock lock(get_frag_mutex(ino));
+
+	std::map<uint32_t, frag_info> leaves = read_fragtree(ino);
+
+	/* group the changes by fragment */
+	std::map<uint32_t, std::pair<std::map<std::string, std::string>, std::set<std::string>>> changes;
+	for (auto &it : added) {
+		auto leaf = --leaves.upper_bound(hash_name(it.first));
+		changes[leaf->first].first.insert(std::make_pair(it.first, ino_to_value(it.second)));
+	}
+	for (auto &name : deleted) {
+		auto leaf = --leaves.upper_bound(hash_name(name));
+		changes[leaf->first].second.insert(name);
+	}
+
+	/* A new directory has no change but its object still has to be created. */
+	if (changes.empty())
+		changes[0];
+
+	std::vector<frag_info> to_split;
+	for (auto &change : changes) {
+		frag_info &info = leaves[change.first];
+		meta_pool->omap_update(obj_category::DENTRY, frag_key(ino, info.bits, info.value), change.second.first, change.second.second);
+
+		info.count += change.second.first.size();
+		info.count -= std::min<uint64_t>(info.count, change.second.second.size());
+		if (info.count > DENTRY_FRAG_MAX_CHILDREN && info.bits < DENTRY_FRAG_MAX_BITS)
+			to_split.push_back(info);
+	}
+
+	std::vector<frag_info> stale;
+	for (auto &info : to_split)
+		split_fragment(ino, info, leaves, stale);
+
+	/* Only a new directory is left without a fragtree */
+	if (!added.empty() || !deleted.empty())
+		write_fragtree(ino, leaves);
+
+	/* The split fragments aren't referenced any more */
+	for (auto &info : stale) {
+		if (info.bits == 0) {
+			std::map<std::string, std::string> kvs;
+			std::set<std::string> names;
+			read_frag_omap(frag_key(ino, 0, 0), kvs);
+			for (auto &kv : kvs)
+				names.insert(kv.first);
+			meta_pool->omap_update(obj_category::DENTRY, frag_key(ino, 0, 0), {}, names);
+		} else {
+			meta_pool->remove(obj_category::DENTRY, frag_key(ino, info.bits, info.value));
+		}
+	}
+}
+
+void dentry::remove(uuid ino)
+{
+	global_logger.log(dentry_ops,"Called dentry::remove(" + uuid_to_string(ino) + ")");
+	std::unique_lock lock(get_frag_mutex(ino));
+
+	for (auto &leaf : read_fragtree(ino))
+		if (leaf.second.bits != 0)
+			meta_pool->remove(obj_category::DENTRY, frag_key(ino, leaf.second.bits, leaf.second.value));
+
+	meta_pool->remove(obj_category::DENTRY, fragtree_key(ino));
+	meta_pool->remove(obj_category::DENTRY, uuid_to_string(ino));
 }
 
 uuid dentry::get_child_ino(const std::string& child_name)
 {
 	global_logger.log(dentry_ops, "Called dentry.get_child_ino(" + child_name + ")");
 
-	auto ret = child_list.find(child_name);
-	if(ret == child_list.end())
+	auto &children = this->get_fragment(child_name).children;
+	auto ret = children.find(child_name);
+	if(ret == children.end())
 		return nil_uuid();
 	else
 		return ret->second;
 }
 
-void dentry::fill_filler(void *buffer, fuse_fill_dir_t filler)
+void dentry::for_each_child(const std::function<void(const std::string &, const uuid &)> &fn)
 {
-	filler(buffer, ".", nullptr, 0, static_cast<fuse_fill_dir_flags>(0));
-	filler(buffer, "..", nullptr, 0, static_cast<fuse_fill_dir_flags>(0));
-	for (auto & it : this->child_list)
-		filler(buffer, it.first.c_str(), nullptr, 0, static_cast<fuse_fill_dir_flags>(0));
+	for (auto &f : this->frags) {
+		if (!f.second.loaded)
+			this->load_fragment(f.second);
+
+		for (auto &it : f.second.children)
+			fn(it.first, it.second);
+	}
+}
+
+bool dentry::for_each_child_from(off_t offset, size_t max, const std::function<void(const std::string &, const uuid &, off_t)> &fn)
+{
+	uint32_t start_hash = offset >= DENTRY_OFFSET_FIRST ? static_cast<uint32_t>(offset >> DENTRY_OFFSET_HASH_SHIFT) : 0;
+	size_t visited = 0;
+
+	auto f = this->frags.upper_bound(start_hash);
+	f--;
+	for (; f != this->frags.end(); f++) {
+		if (!f->second.loaded)
+			this->load_fragment(f->second);
+
+		/* The children from start_hash on, ordered by hash and then by name */
+		std::vector<std::tuple<uint32_t, std::string, uuid>> sorted;
+		for (auto &it : f->second.children) {
+			uint32_t hash = hash_name(it.first);
+			if (hash >= start_hash)
+				sorted.emplace_back(hash, it.first, it.second);
+		}
+		std::sort(sorted.begin(), sorted.end());
+
+		off_t rank = 0;
+		for (size_t n = 0; n < sorted.size(); n++) {
+			uint32_t hash = std::get<0>(sorted[n]);
+			rank = (n > 0 && std::get<0>(sorted[n - 1]) == hash) ? rank + 1 : 0;
+
+			off_t child_offset = (static_cast<off_t>(hash) << DENTRY_OFFSET_HASH_SHIFT) | (rank + DENTRY_OFFSET_FIRST);
+			if (child_offset <= offset)
+				continue;
+			if (visited == max)
+				return true;
+
+			fn(std::get<1>(sorted[n]), std::get<2>(sorted[n]), child_offset);
+			visited++;
+		}
+	}
+
+	return false;
 }
 
 uint64_t dentry::get_child_num() {
-	return this->child_list.size();
+	uint64_t child_num = 0;
+
+	this->for_each_child([&child_num](const std::string &name, const uuid &ino) {
+		child_num++;
+	});
+
+	return child_num;
+}
+
+uint64_t dentry::count_upto(uint64_t limit) {
+	uint64_t child_num = 0;
+
+	for (auto &f : this->frags) {
+		if (child_num >= limit)
+			break;
+		if (!f.second.loaded)
+			this->load_fragment(f.second);
+		child_num += f.second.children.size();
+	}
+
+	return std::min(child_num, limit);
+}
+
+bool dentry::is_empty() {
+	return this->count_upto(1) == 0;
 }
 
 uint64_t dentry::get_total_name_length() {
 	uint64_t total_name_length = 0;
 
-	for(auto& ret : this->child_list){
-		total_name_length += ret.first.size();
-	}
+	this->for_each_child([&total_name_length](const std::string &name, const uuid &ino) {
+		total_name_length += name.size();
+	});
 
 	return total_name_length;
 }
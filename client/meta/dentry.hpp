@@ -1,9 +1,12 @@
 #ifndef NMFS0_DENTRY_HPP
 #define NMFS0_DENTRY_HPP
 
+#include <functional>
 #include <map>
+#include <set>
 #include <utility>
 #include <mutex>
+#include <vector>
 
 #include <tsl/robin_map.h>
 
@@ -14,16 +17,56 @@
 
 #define MAX_DENTRY_OBJ_SIZE OBJ_SIZE
 
+/* number of entries fetched from the omap at a time */
+#define DENTRY_OMAP_PAGE 1024
+
+/* A fragment with more entries than this is split in two */
+#define DENTRY_FRAG_MAX_CHILDREN 16384
+#define DENTRY_FRAG_MAX_BITS 24
+
+/* readdir offsets : the hash of a name above DENTRY_OFFSET_HASH_SHIFT and its rank among
+   the names with the same hash below it, from DENTRY_OFFSET_FIRST ("." and ".." are 1 and 2) */
+#define DENTRY_OFFSET_HASH_SHIFT 30
+#define DENTRY_OFFSET_FIRST 3
+
 using std::unique_ptr;
 using namespace boost::uuids;
 
 class dentry_table;
 
-/*TODO : when total dentries size exceed single object size */
+/*
+ * The entries are kept in omaps, one key per name mapped to the ino.
+ * Names hash into fragments. A fragment (bits, value) holds the names whose hash starts with
+ * the given bits of value, and it is split in two when it grows past DENTRY_FRAG_MAX_CHILDREN.
+ * The root fragment (0, 0) is the DENTRY object of the directory itself and the leaves
+ * with their sizes are listed in the "<ino>.frag" object.
+ * Directories written in the old format (a serialized list in the object data) are moved
+ * to the omap the first time they are loaded.
+ */
 class dentry {
+public:
+	struct frag_info {
+		uint32_t bits;
+		uint32_t value;
+		/* approximate, only used to decide splits */
+		uint64_t count;
+	};
+
 private:
+	struct fragment {
+		uint32_t bits;
+		uint32_t value;
+		bool loaded;
+		tsl::robin_map<std::string, uuid> children;
+	};
+
 	uuid this_ino;
-	tsl::robin_map<std::string, uuid> child_list;
+	/* fragments ordered by the first hash they hold, loaded on demand */
+	std::map<uint32_t, fragment> frags;
+
+	fragment &get_fragment(const std::string &name, bool load = true);
+	void load_fragment(fragment &f);
+	void load_legacy(fragment &f, size_t size);
 
 public:
 	explicit dentry(uuid ino, bool mkdir = false);
@@ -31,14 +74,26 @@ public:
 	void add_child(const std::string &filename, uuid ino);
 	void delete_child(const std::string &filename);
 
-	unique_ptr<char[]> serialize();
+	/* old format */
 	void deserialize(char *raw);
+	/* Writes every entry, for a new directory */
 	void sync();
+	/* Writes only the added and deleted names, the entries don't have to be loaded */
+	static void sync_changes(uuid ino, const std::map<std::string, uuid> &added, const std::set<std::string> &deleted);
+	/* Removes every fragment of a directory */
+	static void remove(uuid ino);
 
 	uuid get_child_ino(const std::string& child_name);
-	void fill_filler(void *buffer, fuse_fill_dir_t filler);
+	/* Visits the fragments in hash order */
+	void for_each_child(const std::function<void(const std::string &, const uuid &)> &fn);
+	/* Visits at most max children after offset in offset order and returns whether there are more.
+	   The offsets stay the same as long as no name with the same hash is added or deleted. */
+	bool for_each_child_from(off_t offset, size_t max, const std::function<void(const std::string &, const uuid &, off_t)> &fn);
 
 	uint64_t get_child_num();
+	/* Counts the children up to limit, the fragments past it aren't loaded */
+	uint64_t count_upto(uint64_t limit);
+	bool is_empty();
 	uint64_t get_total_name_length();
 
 	friend class dentry_table;
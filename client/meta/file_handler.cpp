@@ -1,5 +1,7 @@
 #include "file_handler.hpp"
 
+extern std::unique_ptr<write_back> write_buffers;
+
 file_handler::file_handler(uuid ino) : ino(ino), fhno(0) {
 
 }
@@ -35,6 +37,26 @@ void file_handler::set_remote_i(const std::shared_ptr<remote_inode> &open_remote
 	file_handler::remote_i = open_remote_i;
 }
 
+std::shared_ptr<write_cache> file_handler::get_write_cache() {
+	std::scoped_lock scl{this->wcache_mutex};
+	if (this->wcache == nullptr)
+		this->wcache = write_buffers->open(this->get_open_inode_info());
+	return this->wcache;
+}
+
+int file_handler::flush_write_cache() {
+	std::shared_ptr<write_cache> c;
+	{
+		std::scoped_lock scl{this->wcache_mutex};
+		c = this->wcache;
+	}
+	return c != nullptr ? c->flush() : 0;
+}
+
+read_ahead &file_handler::get_read_ahead() {
+	return this->prefetcher;
+}
+
 void file_handler_list::add_file_handler(uint64_t key, std::shared_ptr<file_handler> fh) {
 	global_logger.log(file_handler_ops, "Called add_file_handler()");
 	std::scoped_lock scl{this->file_handler_mutex};
@@ -2,8 +2,11 @@
 #define NMFS0_FILE_HANDLER_HPP
 
 #include <memory>
+#include <mutex>
 #include <sys/stat.h>
 #include "remote_inode.hpp"
+#include "../in_memory/write_cache.hpp"
+#include "../in_memory/read_ahead.hpp"
 
 class file_handler {
 private:
@@ -13,6 +16,12 @@ private:
 
 	std::shared_ptr<inode> i;
 	std::shared_ptr<remote_inode> remote_i;
+
+	/* the write cache of the file, taken on the first write through this handler */
+	std::mutex wcache_mutex;
+	std::shared_ptr<write_cache> wcache;
+
+	read_ahead prefetcher;
 public:
 	explicit file_handler(uuid ino);
 
@@ -27,6 +36,12 @@ public:
 	void set_i(const std::shared_ptr<inode> &open_i);
 
 	void set_remote_i(const std::shared_ptr<remote_inode> &open_remote_i);
+
+	std::shared_ptr<write_cache> get_write_cache();
+	/* Returns 0 if nothing was written through this handler */
+	int flush_write_cache();
+
+	read_ahead &get_read_ahead();
 };
 
 class file_handler_list {
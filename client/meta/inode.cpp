@@ -2,11 +2,14 @@
 
 #include <cstring>
 
+#include "../in_memory/data_versions.hpp"
+
 using std::runtime_error;
 
 extern std::shared_ptr<rados_io> meta_pool;
 extern std::unique_ptr<client> this_client;
 extern std::unique_ptr<uuid_controller> ino_controller;
+extern std::unique_ptr<data_versions> file_versions;
 
 inode::no_entry::no_entry(const string &msg) : runtime_error(msg)
 {
@@ -26,6 +29,15 @@ const char *inode::permission_denied::what()
 	return runtime_error::what();
 }
 
+inode::not_directory::not_directory(const string &msg) : runtime_error(msg)
+{
+}
+
+const char *inode::not_directory::what()
+{
+	return runtime_error::what();
+}
+
 inode::inode(const inode &copy)
 {
 	core.i_mode = copy.core.i_mode;
@@ -128,16 +140,16 @@ inode::inode(uuid parent_ino, uid_t owner, gid_t group, mode_t mode, const char
 inode::inode(uuid ino)
 {
 	global_logger.log(inode_ops, "Called inode(" + uuid_to_string(ino) + ")");
-	unique_ptr<char[]> raw_data = std::make_unique<char[]>(REG_INODE_SIZE);
+	unique_ptr<char[]> raw_data = std::make_unique<char[]>(REG_INODE_SIZE + INODE_LINK_READAHEAD);
 	try {
-		meta_pool->read(obj_category::INODE, uuid_to_string(ino), raw_data.get(), REG_INODE_SIZE, 0);
-		this->deserialize(raw_data.get());
+		size_t len = meta_pool->read(obj_category::INODE, uuid_to_string(ino), raw_data.get(), REG_INODE_SIZE + INODE_LINK_READAHEAD, 0);
+		this->deserialize(raw_data.get(), len);
 	} catch(rados_io::no_such_object &e){
 		throw no_entry("No such file or Directory: in inode(ino) constructor");
 	}
 }
 
-inode::inode(enum meta_location loc) : loc(loc){
+inode::inode(enum meta_location loc) : core(), loc(loc){
 }
 
 void inode::fill_stat(struct stat *s)
@@ -174,14 +186,23 @@ std::vector<char> inode::serialize()
 }
 
 void inode::deserialize(const char *value)
+{
+	this->deserialize(value, REG_INODE_SIZE);
+}
+
+void inode::deserialize(const char *value, size_t len)
 {
 	global_logger.log(inode_ops, "Called inode.deserialize()");
 	memcpy(&core, value, REG_INODE_SIZE);
 
 	if(S_ISLNK(this->core.i_mode)){
 		this->link_target_name = std::make_shared<std::string>();
-		(*this->link_target_name).resize(this->core.link_target_len);
-		meta_pool->read(obj_category::INODE, uuid_to_string(this->core.i_ino), &((*this->link_target_name)[0]), this->core.link_target_len, REG_INODE_SIZE);
+		if (len >= REG_INODE_SIZE + this->core.link_target_len) {
+			this->link_target_name->assign(value + REG_INODE_SIZE, this->core.link_target_len);
+		} else {
+			(*this->link_target_name).resize(this->core.link_target_len);
+			meta_pool->read(obj_category::INODE, uuid_to_string(this->core.i_ino), &((*this->link_target_name)[0]), this->core.link_target_len, REG_INODE_SIZE);
+		}
 		global_logger.log(inode_ops, "deserialized link target name : " + *this->link_target_name);
 	}
 
@@ -196,6 +217,31 @@ void inode::sync()
 	meta_pool->write(obj_category::INODE, uuid_to_string(this->core.i_ino), raw.data(), REG_INODE_SIZE + this->core.link_target_len, 0);
 }
 
+std::vector<std::shared_ptr<inode>> inode::load_batch(const std::vector<uuid> &inos)
+{
+	global_logger.log(inode_ops, "Called inode::load_batch(" + std::to_string(inos.size()) + ")");
+	const size_t read_size = REG_INODE_SIZE + INODE_LINK_READAHEAD;
+
+	std::vector<char> raw(inos.size() * read_size);
+	std::vector<std::shared_ptr<rados_io::aio_handle>> handles;
+	for (size_t n = 0; n < inos.size(); n++)
+		handles.push_back(meta_pool->aio_read(obj_category::INODE, uuid_to_string(inos[n]), raw.data() + n * read_size, read_size, 0));
+
+	std::vector<std::shared_ptr<inode>> inodes(inos.size());
+	for (size_t n = 0; n < inos.size(); n++) {
+		try {
+			size_t len = handles[n]->wait();
+			inodes[n] = std::make_shared<inode>(UNKNOWN);
+			inodes[n]->deserialize(raw.data() + n * read_size, len);
+		} catch (rados_io::no_such_object &e) {
+			global_logger.log(inode_ops, "No inode object for " + uuid_to_string(inos[n]));
+			inodes[n] = nullptr;
+		}
+	}
+
+	return inodes;
+}
+
 void inode::permission_check(int mask){
 	global_logger.log(inode_ops, "Called permission_check");
 	bool check_read = (mask & R_OK) ? true : false;
@@ -268,6 +314,13 @@ uint32_t inode::get_link_target_len(){
 std::shared_ptr<std::string> inode::get_link_target_name(){
 	return this->link_target_name;
 }
+/* Kept by ino, not by instance, since a remote_inode is made anew for every request, see data_versions */
+uint64_t inode::get_data_version(){
+	return file_versions->get(this->get_ino());
+}
+void inode::bump_data_version(){
+	file_versions->bump(this->get_ino());
+}
 
 // setter
 void inode::set_mode(mode_t mode){
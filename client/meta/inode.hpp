@@ -1,6 +1,7 @@
 #ifndef _INODE_HPP_
 #define _INODE_HPP_
 
+#include <atomic>
 #include <memory>
 #include <sys/stat.h>
 #include <stdexcept>
@@ -15,6 +16,8 @@
 #include "uuid_controller.hpp"
 
 #define REG_INODE_SIZE (sizeof(struct _core))
+/* A symlink target shorter than this comes with the first read of the inode */
+#define INODE_LINK_READAHEAD 256
 #define DIR_INODE_SIZE 4096
 #define ENOTLEADER 8000
 #define ENEEDRECOV 8001
@@ -69,6 +72,12 @@ public:
 		const char *what();
 	};
 
+	class not_directory : public runtime_error {
+	public:
+		explicit not_directory(const string &msg);
+		const char *what();
+	};
+
 	inode(const inode &copy);
 
 	/* for normal reg file and root directory */
@@ -85,6 +94,8 @@ public:
 	void fill_stat(struct stat *s);
 	std::vector<char> serialize();
 	void deserialize(const char *value);
+	/* value holds len bytes of the object, the link target is read separately only if it isn't there */
+	void deserialize(const char *value, size_t len);
 	void sync();
 	virtual void permission_check(int mask);
 
@@ -105,6 +116,9 @@ public:
 	uint32_t get_link_target_len();
     	std::shared_ptr<std::string> get_link_target_name();
 
+	uint64_t get_data_version();
+	void bump_data_version();
+
 	// setter
 	void set_p_ino(const uuid &p_ino);
 
@@ -122,6 +136,9 @@ public:
 	void set_link_target_len(uint32_t len);
 	void set_link_target_name(const std::shared_ptr<std::string> name);
 
+	/* Reads the inodes with async reads issued at once, a missing inode comes back as nullptr */
+	static std::vector<std::shared_ptr<inode>> load_batch(const std::vector<uuid> &inos);
+
 	void inode_to_rename_src_response(::rpc_rename_not_same_parent_src_respond *response);
     	void rename_src_response_to_inode(::rpc_rename_not_same_parent_src_respond &response);
     	void inode_to_rename_dst_request(::rpc_rename_not_same_parent_dst_request &request);
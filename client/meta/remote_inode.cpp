@@ -1,29 +1,43 @@
 #include "remote_inode.hpp"
+
+#include <shared_mutex>
+
+#include <tsl/robin_map.h>
+
 #include "../rpc/rpc_client.hpp"
+#include "../in_memory/attr_cache.hpp"
+
+extern std::unique_ptr<attr_cache> remote_attrs;
+
+extern struct mount_options nmfs_options;
+
+/* <address, rpc_client>, sharded by address so the calls to different leaders don't contend */
+struct rpc_client_shard {
+	std::shared_mutex sm;
+	tsl::robin_map<std::string, std::shared_ptr<rpc_client>> clients;
+};
 
-/* <address, channel> */
-std::map<std::string, std::shared_ptr<rpc_client>> rc_list;
-std::recursive_mutex rc_list_mutex;
+static rpc_client_shard rc_shards[RPC_CLIENT_SHARDS];
 
 std::shared_ptr<rpc_client> get_rpc_client(const std::string& remote_address) {
 	global_logger.log(remote_fs_op, "Called  get_rpc_client()");
-	std::scoped_lock scl{rc_list_mutex};
-	std::map<std::string, std::shared_ptr<rpc_client>>::iterator it;
-	it = rc_list.find(remote_address);
+	rpc_client_shard &shard = rc_shards[std::hash<std::string>{}(remote_address) % RPC_CLIENT_SHARDS];
 
-	if(it != rc_list.end()){
-		return it->second;
-	} else {
-		std::shared_ptr<rpc_client> rc = std::make_shared<rpc_client>(grpc::CreateChannel(remote_address, grpc::InsecureChannelCredentials()));
-		auto ret = rc_list.insert(std::make_pair(remote_address,nullptr));
-		if (ret.second) {
-			ret.first->second = rc;
-		} else {
-			global_logger.log(dentry_table_ops, "Already added rc is tried to inserted");
-			return nullptr;
-		}
-		return rc;
+	{
+		std::shared_lock lock(shard.sm);
+		auto it = shard.clients.find(remote_address);
+		if (it != shard.clients.end())
+			return it->second;
 	}
+
+	std::unique_lock lock(shard.sm);
+	auto it = shard.clients.find(remote_address);
+	if (it != shard.clients.end())
+		return it->second;
+
+	std::shared_ptr<rpc_client> rc = std::make_shared<rpc_client>(remote_address, nmfs_options.rpc_channels);
+	shard.clients.insert({remote_address, rc});
+	return rc;
 }
 
 remote_inode::remote_inode(std::string leader_ip, uuid dentry_table_ino, std::string file_name, bool target_is_parent ) \
@@ -46,25 +60,56 @@ bool remote_inode::get_target_is_parent() const {
 	return target_is_parent;
 }
 
-mode_t remote_inode::get_mode() {
+int remote_inode::fetch_attr(struct stat &attr) {
+	uuid ino = this->inode::get_ino();
+	if (!ino.is_nil() && remote_attrs->get(ino, attr)) {
+		global_logger.log(remote_fs_op, "attr cache : HIT");
+		return 0;
+	}
+
 	std::string remote_address(this->leader_ip);
 	std::shared_ptr<rpc_client> rc = get_rpc_client(remote_address);
 
-	mode_t returend_mode = rc->get_mode(this->dentry_table_ino, this->file_name);
+	uint64_t gen = remote_attrs->get_gen();
+	milliseconds lease_left{};
+	int ret = rc->getattr(this->dentry_table_ino, this->file_name, this->target_is_parent, &attr, lease_left);
+	if (ret == 0)
+		remote_attrs->put(ino, attr, lease_left, gen);
+
+	return ret;
+}
+
+mode_t remote_inode::get_mode() {
+	struct stat attr{};
+	if (this->fetch_attr(attr) != 0)
+		throw std::runtime_error("ACCESS IMPROPER LEADER");
 
-	/* store returned i_mode value for next called permission_check() */
-	this->inode::set_mode(returend_mode);
+	/* store returned attributes for next called permission_check() */
+	this->set_attr(attr);
 
-	return returend_mode;
+	return attr.st_mode;
 }
 
 void remote_inode::set_leader_ip(const string &leader_ip) {
 	remote_inode::leader_ip = leader_ip;
 }
 
+void remote_inode::set_attr(const struct stat &attr) {
+	this->inode::set_mode(attr.st_mode);
+	this->inode::set_uid(attr.st_uid);
+	this->inode::set_gid(attr.st_gid);
+	this->inode::set_nlink(attr.st_nlink);
+	this->inode::set_size(attr.st_size);
+	this->inode::set_atime(attr.st_atim);
+	this->inode::set_mtime(attr.st_mtim);
+	this->inode::set_ctime(attr.st_ctim);
+}
+
 void remote_inode::permission_check(int mask) {
-	std::string remote_address(this->leader_ip);
-	std::shared_ptr<rpc_client> rc = get_rpc_client(remote_address);
+	struct stat attr{};
+	if (this->fetch_attr(attr) != 0)
+		throw std::runtime_error("ACCESS IMPROPER LEADER");
 
-	rc->permission_check(this->dentry_table_ino, this->file_name, mask, this->target_is_parent);
+	this->set_attr(attr);
+	this->inode::permission_check(mask);
 }
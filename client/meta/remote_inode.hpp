@@ -3,8 +3,12 @@
 
 #include "inode.hpp"
 
+/* The table of rpc clients is split in this many parts, each with its own lock */
+#define RPC_CLIENT_SHARDS 16
+
 class rpc_client;
 
+/* The rpc client of a leader, made on the first call */
 std::shared_ptr<rpc_client> get_rpc_client(const std::string& remote_address);
 
 class remote_inode : public inode {
@@ -24,10 +28,16 @@ public:
 	[[nodiscard]] uuid get_dentry_table_ino() const;
 	[[nodiscard]] const string &get_file_name() const;
 	[[nodiscard]] bool get_target_is_parent() const;
+	/* The attributes from the attr cache or from the leader,
+	   returns -ENOTLEADER or -ENEEDRECOV when the leader can't answer */
+	int fetch_attr(struct stat &attr);
 	mode_t get_mode() override;
 
     void set_leader_ip(const string &leader_ip);
+	/* Fills in the attributes sent by the leader */
+	void set_attr(const struct stat &attr);
 
+    /* checked here with the attributes from fetch_attr() */
     void permission_check(int mask) override;
 };
 
@@ -0,0 +1,246 @@
+#include "async_creates.hpp"
+#include "rpc_client.hpp"
+#include "compound_queue.hpp"
+#include "../in_memory/attr_cache.hpp"
+#include "../in_memory/directory_table.hpp"
+#include "../meta/remote_inode.hpp"
+
+extern std::unique_ptr<uuid_controller> ino_controller;
+extern std::unique_ptr<attr_cache> remote_attrs;
+extern std::unique_ptr<directory_table> indexing_table;
+
+async_creates::async_creates(rpc_client *rc, const std::string &address) : rc(rc), address(address), unsent(0), batch_full(false), stopping(false)
+{
+	flusher = std::thread(&async_creates::flush_loop, this);
+}
+
+async_creates::~async_creates(void)
+{
+	{
+		std::unique_lock lock(m);
+		stopping = true;
+	}
+	cv.notify_all();
+	flusher.join();
+}
+
+bool async_creates::create(const uuid &dir_ino, const std::string &name, mode_t mode, uid_t uid, gid_t gid, uuid &new_ino)
+{
+	std::unique_lock lock(m);
+
+	auto it = dirs.find(dir_ino);
+	if (it == dirs.end() || it->second.left == 0)
+		return false;
+	if (it->second.due < system_clock::now() + milliseconds(ASYNC_CREATE_MARGIN_MS))
+		return false;
+	/* A name which may exist goes to the leader, which opens the file or refuses it */
+	if (it->second.names.count(name) != 0)
+		return false;
+
+	new_ino = ino_controller->alloc_new_uuid();
+
+	rpc_compound_op op;
+	op.set_type(rpc_compound_op::CREATE);
+	op.set_filename(name);
+	op.set_mode(mode);
+	op.set_uid(uid);
+	op.set_gid(gid);
+	op.set_grant_id(it->second.grant_id);
+	op.set_ino_prefix(ino_controller->get_prefix_from_uuid(new_ino));
+	op.set_ino_postfix(ino_controller->get_postfix_from_uuid(new_ino));
+
+	it.value().left--;
+	it.value().names.insert(name);
+	it.value().pending.push_back(std::move(op));
+	unsent++;
+
+	if (it->second.pending.size() >= COMPOUND_MAX_OPS) {
+		batch_full = true;
+		cv.notify_all();
+	}
+	return true;
+}
+
+bool async_creates::delegated(const uuid &dir_ino)
+{
+	std::unique_lock lock(m);
+
+	auto it = dirs.find(dir_ino);
+	return it != dirs.end() && it->second.left > 0 &&
+	       it->second.due >= system_clock::now() + milliseconds(ASYNC_CREATE_MARGIN_MS);
+}
+
+void async_creates::add_delegation(const uuid &dir_ino, uint64_t grant_id, uint32_t count, milliseconds lease_left,
+				   const std::vector<std::string> &names)
+{
+	global_logger.log(rpc_client_ops, "Called add_delegation(" + std::to_string(count) + ")");
+	std::unique_lock lock(m);
+
+	/* The creations still queued keep the grant they were made with */
+	auto it = dirs.find(dir_ino);
+	if (it == dirs.end())
+		it = dirs.insert({dir_ino, dir_state{0, 0, system_clock::time_point(), {}, false}}).first;
+
+	it.value().grant_id = grant_id;
+	it.value().left = count;
+	it.value().due = system_clock::now() + lease_left;
+	it.value().names = std::set<std::string>(names.begin(), names.end());
+	for (const auto &op : it->second.pending)
+		it.value().names.insert(op.filename());
+}
+
+void async_creates::revoke(const uuid &dir_ino)
+{
+	std::unique_lock lock(m);
+
+	auto it = dirs.find(dir_ino);
+	if (it == dirs.end())
+		return;
+
+	global_logger.log(rpc_client_ops, "Called revoke()");
+	it.value().left = 0;
+	if (it->second.pending.empty() && !it->second.flushing)
+		dirs.erase(it);
+}
+
+int async_creates::send_again(const uuid &dir_ino, std::vector<rpc_compound_op> &ops, std::vector<rpc_compound_result> &results, bool redirect)
+{
+	for (auto &op : ops)
+		op.set_grant_id(0);
+
+	int ret = redirect ? -ENOTLEADER : rc->compound(dir_ino, ops, results);
+	std::string refused_address = address;
+	try {
+		for (int n = 0; ret == -ENOTLEADER && n < ASYNC_CREATE_MAX_REDIRECTS; n++) {
+			refused_address = indexing_table->find_leader_again(dir_ino, refused_address);
+			global_logger.log(rpc_client_ops, "async creates are sent again to " + refused_address);
+			ret = get_rpc_client(refused_address)->compound(dir_ino, ops, results);
+		}
+	} catch (inode::no_entry &e) {
+		ret = -ENOENT;
+	} catch (std::runtime_error &e) {
+		ret = -ENEEDRECOV;
+	}
+	return ret;
+}
+
+void async_creates::send(std::unique_lock<std::mutex> &lock, const uuid &dir_ino)
+{
+	auto it = dirs.find(dir_ino);
+	it.value().flushing = true;
+
+	std::vector<rpc_compound_op> ops;
+	auto &pending = it.value().pending;
+	size_t n = std::min<size_t>(pending.size(), COMPOUND_MAX_OPS);
+	ops.assign(std::make_move_iterator(pending.begin()), std::make_move_iterator(pending.begin() + n));
+	pending.erase(pending.begin(), pending.begin() + n);
+
+	lock.unlock();
+	std::vector<rpc_compound_result> results;
+	int ret = rc->compound(dir_ino, ops, results);
+	/* The delegation ends with the lease of the leader which gave it */
+	bool revoked = ret == -ENOTLEADER;
+	if (ret == -ENOTLEADER)
+		ret = send_again(dir_ino, ops, results, true);
+	if (ret == 0 && results.size() != ops.size())
+		ret = -ENEEDRECOV;
+
+	/* The grant was taken back or ran out before they got there */
+	std::vector<size_t> stale;
+	for (size_t k = 0; ret == 0 && k < ops.size(); k++)
+		if (results[k].ret() == -ESTALE)
+			stale.push_back(k);
+	if (!stale.empty()) {
+		revoked = true;
+		std::vector<rpc_compound_op> stale_ops;
+		std::vector<rpc_compound_result> stale_results;
+		for (size_t k : stale)
+			stale_ops.push_back(ops[k]);
+
+		int stale_ret = send_again(dir_ino, stale_ops, stale_results, false);
+		if (stale_ret == 0 && stale_results.size() != stale_ops.size())
+			stale_ret = -ENEEDRECOV;
+		for (size_t n = 0; n < stale.size(); n++)
+			results[stale[n]].set_ret(stale_ret != 0 ? stale_ret : stale_results[n].ret());
+	}
+	lock.lock();
+
+	for (size_t k = 0; k < ops.size(); k++) {
+		int err = ret != 0 ? ret : results[k].ret();
+		if (err != 0) {
+			uuid ino = ino_controller->splice_prefix_and_postfix(ops[k].ino_prefix(), ops[k].ino_postfix());
+			global_logger.log(rpc_client_ops, "async create of " + ops[k].filename() + " failed (" + std::to_string(err) + ")");
+			errors[ino] = err;
+			remote_attrs->invalidate(ino);
+		}
+	}
+	unsent -= ops.size();
+
+	it = dirs.find(dir_ino);
+	it.value().flushing = false;
+	if (revoked)
+		it.value().left = 0;
+	if (it->second.pending.empty() && (it->second.left == 0 || it->second.due < system_clock::now()))
+		dirs.erase(it);
+	cv.notify_all();
+}
+
+void async_creates::flush(const uuid &dir_ino)
+{
+	if (unsent == 0)
+		return;
+
+	std::unique_lock lock(m);
+	while (true) {
+		auto it = dirs.find(dir_ino);
+		if (it == dirs.end())
+			return;
+
+		if (it->second.flushing)
+			cv.wait(lock);
+		else if (!it->second.pending.empty())
+			send(lock, dir_ino);
+		else
+			return;
+	}
+}
+
+int async_creates::get_error(const uuid &ino)
+{
+	std::unique_lock lock(m);
+
+	auto it = errors.find(ino);
+	return it == errors.end() ? 0 : it->second;
+}
+
+void async_creates::forget_error(const uuid &ino)
+{
+	std::unique_lock lock(m);
+	errors.erase(ino);
+}
+
+void async_creates::flush_loop(void)
+{
+	std::unique_lock lock(m);
+
+	while (true) {
+		cv.wait(lock, [this] { return stopping || unsent > 0; });
+		/* more creations are gathered unless a batch is full already */
+		cv.wait_for(lock, milliseconds(ASYNC_CREATE_FLUSH_MS), [this] { return stopping || batch_full; });
+		batch_full = false;
+
+		std::vector<uuid> ready;
+		for (const auto &p : dirs)
+			if (!p.second.pending.empty() && !p.second.flushing)
+				ready.push_back(p.first);
+
+		for (const auto &dir_ino : ready) {
+			auto it = dirs.find(dir_ino);
+			if (it != dirs.end() && !it->second.pending.empty() && !it->second.flushing)
+				send(lock, dir_ino);
+		}
+
+		if (stopping && unsent == 0)
+			return;
+	}
+}
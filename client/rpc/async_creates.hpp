@@ -0,0 +1,101 @@
+#ifndef NMFS_ASYNC_CREATES_HPP
+#define NMFS_ASYNC_CREATES_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include <boost/functional/hash.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <tsl/robin_map.h>
+#include <rpc.grpc.pb.h>
+
+using namespace std::chrono;
+using namespace boost::uuids;
+
+/* -o async_creates when it isn't given : creations asked for per delegation, 0 creates synchronously */
+#define DEFAULT_ASYNC_CREATES 0
+
+/* A queued creation is sent at most this long after it was made */
+#define ASYNC_CREATE_FLUSH_MS 5
+/* A delegation isn't used when it expires sooner than this */
+#define ASYNC_CREATE_MARGIN_MS 100
+/* A batch the leader refused is sent to the next one at most this many times */
+#define ASYNC_CREATE_MAX_REDIRECTS 3
+
+class rpc_client;
+
+/*
+ * Creations this client answers by itself under the delegations of a leader (see rpc_delegate_creates).
+ * A create takes one of the creations delegated on the parent, chooses the ino and returns at once.
+ * The flusher thread sends the queued creations to the leader in rpc_compound batches,
+ * and any other request on the directory sends them first so this client sees its own files.
+ * A name the directory had when it was delegated, or one queued already, is created synchronously.
+ * The delegation ends when the leader takes it back, as it does once another name is added,
+ * and the creations made under it are sent again without it with the same ino.
+ * A creation the leader refuses, when another client took the name meanwhile,
+ * is reported on the file afterwards by flush, fsync and close (see get_error()).
+ */
+class async_creates {
+private:
+	struct dir_state {
+		uint64_t grant_id;
+		uint32_t left;
+		system_clock::time_point due;
+		std::vector<rpc_compound_op> pending;
+		/* a batch taken off pending is being sent */
+		bool flushing;
+		/* the names in the directory, as far as this client knows */
+		std::set<std::string> names;
+	};
+
+	rpc_client *rc;
+	std::string address;
+
+	std::mutex m;
+	std::condition_variable cv;
+	tsl::robin_map<uuid, dir_state, boost::hash<uuid>> dirs;
+	/* errors of the creations the leader refused, by ino */
+	tsl::robin_map<uuid, int, boost::hash<uuid>> errors;
+	/* creations queued or being sent, flush() doesn't lock when there are none */
+	std::atomic<size_t> unsent;
+	bool batch_full;
+
+	bool stopping;
+	std::thread flusher;
+
+	void send(std::unique_lock<std::mutex> &lock, const uuid &dir_ino);
+	/* Sends ops without their grant, to the leader which follows the one refusing them */
+	int send_again(const uuid &dir_ino, std::vector<rpc_compound_op> &ops, std::vector<rpc_compound_result> &results, bool redirect);
+	void flush_loop(void);
+
+public:
+	async_creates(rpc_client *rc, const std::string &address);
+	~async_creates(void);
+
+	/* Queues the creation of a regular file with one of the creations delegated on the directory,
+	   false if there are none left or the name may be taken */
+	bool create(const uuid &dir_ino, const std::string &name, mode_t mode, uid_t uid, gid_t gid, uuid &new_ino);
+
+	bool delegated(const uuid &dir_ino);
+	void add_delegation(const uuid &dir_ino, uint64_t grant_id, uint32_t count, milliseconds lease_left,
+			    const std::vector<std::string> &names);
+	/* Stops using the delegation on the directory, this client added a name to it synchronously */
+	void revoke(const uuid &dir_ino);
+
+	/* Sends the creations queued on the directory and waits for them */
+	void flush(const uuid &dir_ino);
+	/* Returns the error of the creation of ino, 0 if it hasn't failed */
+	int get_error(const uuid &ino);
+	/* Called when the file is closed, its error has been reported */
+	void forget_error(const uuid &ino);
+};
+
+#endif //NMFS_ASYNC_CREATES_HPP
@@ -0,0 +1,76 @@
+#include "compound_queue.hpp"
+#include "../../lib/logger/logger.hpp"
+#include "../meta/inode.hpp"
+
+compound_queue::compound_queue(size_t max_ops, send_fn send) : max_ops(max_ops), send(std::move(send))
+{
+}
+
+void compound_queue::send_batch(std::unique_lock<std::mutex> &lock, const uuid &dir_ino)
+{
+	auto it = dirs.find(dir_ino);
+	it.value().sending = true;
+
+	std::vector<std::shared_ptr<pending>> batch;
+	std::vector<rpc_compound_op> ops;
+	auto &q = it.value().ops;
+	while (!q.empty() && batch.size() < max_ops) {
+		batch.push_back(q.front());
+		ops.push_back(q.front()->op);
+		q.pop_front();
+	}
+
+	lock.unlock();
+	std::vector<rpc_compound_result> results;
+	int ret;
+	try {
+		ret = send(dir_ino, ops, results);
+		if (ret == 0 && results.size() != batch.size())
+			ret = -ENEEDRECOV;
+	} catch (std::exception &e) {
+		global_logger.log(rpc_client_ops, std::string("compound_queue::send_batch() failed : ") + e.what());
+		ret = -ENEEDRECOV;
+	}
+	lock.lock();
+
+	for (size_t n = 0; n < batch.size(); n++) {
+		if (ret == 0) {
+			batch[n]->result = results[n];
+			batch[n]->ret = results[n].ret();
+		} else {
+			batch[n]->ret = ret;
+		}
+		batch[n]->done = true;
+	}
+
+	it = dirs.find(dir_ino);
+	it.value().sending = false;
+	if (it->second.ops.empty())
+		dirs.erase(it);
+	cv.notify_all();
+}
+
+int compound_queue::run(const uuid &dir_ino, const rpc_compound_op &op, rpc_compound_result &result)
+{
+	auto p = std::make_shared<pending>();
+	p->op = op;
+	p->ret = 0;
+	p->done = false;
+
+	std::unique_lock lock(m);
+	auto it = dirs.find(dir_ino);
+	if (it == dirs.end())
+		it = dirs.insert({dir_ino, dir_queue{{}, false}}).first;
+	it.value().ops.push_back(p);
+
+	while (!p->done) {
+		it = dirs.find(dir_ino);
+		if (!it->second.sending)
+			send_batch(lock, dir_ino);
+		else
+			cv.wait(lock);
+	}
+
+	result = p->result;
+	return p->ret;
+}
@@ -0,0 +1,61 @@
+#ifndef NMFS_COMPOUND_QUEUE_HPP
+#define NMFS_COMPOUND_QUEUE_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <tsl/robin_map.h>
+#include <rpc.grpc.pb.h>
+
+using namespace boost::uuids;
+
+/* Operations run by one rpc_compound at most */
+#define COMPOUND_MAX_OPS 64
+
+/*
+ * Gathers the operations sent to the children of one remote directory.
+ * The first caller on a directory sends what is queued on it as one rpc_compound
+ * and the callers coming in meanwhile wait for the next one,
+ * so the operations running at the same time share round trips instead of taking one each.
+ */
+class compound_queue {
+public:
+	/* Sends the operations, returns 0 with one result per operation or an error for all of them */
+	using send_fn = std::function<int(const uuid &, const std::vector<rpc_compound_op> &, std::vector<rpc_compound_result> &)>;
+
+private:
+	struct pending {
+		rpc_compound_op op;
+		rpc_compound_result result;
+		int ret;
+		bool done;
+	};
+
+	struct dir_queue {
+		std::deque<std::shared_ptr<pending>> ops;
+		/* a caller is sending the operations taken off the queue */
+		bool sending;
+	};
+
+	std::mutex m;
+	std::condition_variable cv;
+	tsl::robin_map<uuid, dir_queue, boost::hash<uuid>> dirs;
+	size_t max_ops;
+	send_fn send;
+
+	void send_batch(std::unique_lock<std::mutex> &lock, const uuid &dir_ino);
+
+public:
+	compound_queue(size_t max_ops, send_fn send);
+
+	/* Returns the result of the operation, or -ENOTLEADER or -ENEEDRECOV if the batch couldn't be run */
+	int run(const uuid &dir_ino, const rpc_compound_op &op, rpc_compound_result &result);
+};
+
+#endif //NMFS_COMPOUND_QUEUE_HPP
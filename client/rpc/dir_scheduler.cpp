@@ -0,0 +1,118 @@
+#include "dir_scheduler.hpp"
+#include "../../lib/logger/logger.hpp"
+
+dir_scheduler::dir_scheduler(size_t num_workers) : stopping(false)
+{
+	for (size_t n = 0; n < num_workers; n++)
+		workers.emplace_back(&dir_scheduler::work, this);
+}
+
+dir_scheduler::~dir_scheduler(void)
+{
+	this->stop();
+}
+
+bool dir_scheduler::can_start(const dir_queue &dq)
+{
+	if (dq.q.empty() || dq.running_write)
+		return false;
+	return dq.q.front().read_only || dq.running_reads == 0;
+}
+
+void dir_scheduler::submit(const uuid &dir_ino, task fn, bool read_only)
+{
+	std::unique_lock lock(m);
+
+	if (stopping) {
+		lock.unlock();
+		fn(true);
+		return;
+	}
+
+	auto it = queues.find(dir_ino);
+	if (it == queues.end())
+		it = queues.insert({dir_ino, dir_queue{{}, 0, false, false}}).first;
+	it.value().q.push_back({std::move(fn), read_only});
+
+	/* A directory which can't start it now is made ready by the worker finishing on it */
+	if (!it->second.scheduled && can_start(it->second)) {
+		it.value().scheduled = true;
+		ready.push_back(dir_ino);
+		cv.notify_one();
+	}
+}
+
+void dir_scheduler::work(void)
+{
+	std::unique_lock lock(m);
+
+	while (true) {
+		cv.wait(lock, [this] { return stopping || !ready.empty(); });
+		if (stopping)
+			return;
+
+		uuid dir_ino = ready.front();
+		ready.pop_front();
+
+		auto it = queues.find(dir_ino);
+		queued next = std::move(it.value().q.front());
+		it.value().q.pop_front();
+		if (next.read_only)
+			it.value().running_reads++;
+		else
+			it.value().running_write = true;
+
+		/* The next read can start on another worker while this one runs */
+		it.value().scheduled = can_start(it->second);
+		if (it->second.scheduled) {
+			ready.push_back(dir_ino);
+			cv.notify_one();
+		}
+
+		lock.unlock();
+		next.fn(false);
+		lock.lock();
+
+		it = queues.find(dir_ino);
+		if (next.read_only)
+			it.value().running_reads--;
+		else
+			it.value().running_write = false;
+
+		if (!it->second.scheduled && can_start(it->second)) {
+			it.value().scheduled = true;
+			ready.push_back(dir_ino);
+		} else if (it->second.q.empty() && it->second.running_reads == 0 && !it->second.running_write) {
+			queues.erase(it);
+		}
+	}
+}
+
+void dir_scheduler::stop(void)
+{
+	{
+		std::unique_lock lock(m);
+		if (stopping)
+			return;
+		stopping = true;
+	}
+	cv.notify_all();
+
+	for (auto &worker : workers)
+		worker.join();
+
+	/* Nothing runs any more, what is left is finished as cancelled */
+	std::vector<task> left;
+	{
+		std::unique_lock lock(m);
+		for (auto it = queues.begin(); it != queues.end(); ++it)
+			for (auto &e : it.value().q)
+				left.push_back(std::move(e.fn));
+		queues.clear();
+		ready.clear();
+	}
+	for (auto &fn : left)
+		fn(true);
+
+	global_logger.log(rpc_server_ops, "rpc workers are stopped, " + std::to_string(left.size()) + " queued calls are cancelled");
+}
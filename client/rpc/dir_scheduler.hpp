@@ -0,0 +1,65 @@
+#ifndef NMFS_DIR_SCHEDULER_HPP
+#define NMFS_DIR_SCHEDULER_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <tsl/robin_map.h>
+
+using namespace boost::uuids;
+
+/*
+ * Runs the rpc handlers on a pool of workers with a queue per directory.
+ * The requests on a directory start in arrival order. A request which only reads runs
+ * along with the reads next to it in the queue, one which changes the directory runs alone.
+ * The workers take the directories with a request ready to start in turn,
+ * one request each, so a hot directory can't hold all the workers.
+ */
+class dir_scheduler {
+public:
+	/* cancelled : the scheduler stopped before it ran, the call is to be finished without running it */
+	using task = std::function<void(bool cancelled)>;
+
+private:
+	struct queued {
+		task fn;
+		bool read_only;
+	};
+
+	struct dir_queue {
+		std::deque<queued> q;
+		size_t running_reads;
+		bool running_write;
+		/* in ready, or being taken from it */
+		bool scheduled;
+	};
+
+	std::mutex m;
+	std::condition_variable cv;
+
+	tsl::robin_map<uuid, dir_queue, boost::hash<uuid>> queues;
+	/* directories whose first request can start */
+	std::deque<uuid> ready;
+
+	std::vector<std::thread> workers;
+	bool stopping;
+
+	bool can_start(const dir_queue &dq);
+	void work(void);
+
+public:
+	explicit dir_scheduler(size_t num_workers);
+	~dir_scheduler(void);
+
+	void submit(const uuid &dir_ino, task fn, bool read_only = false);
+	/* Waits for the running requests, the queued ones and those submitted later are cancelled */
+	void stop(void);
+};
+
+#endif //NMFS_DIR_SCHEDULER_HPP
@@ -1,15 +1,48 @@
 #include "rpc_client.hpp"
+
+#include <sys/param.h>
+
+#include "../in_memory/attr_cache.hpp"
+#include "../in_memory/directory_table.hpp"
+
 extern std::shared_ptr<rados_io> data_pool;
 extern std::unique_ptr<file_handler_list> open_context;
 extern std::unique_ptr<uuid_controller> ino_controller;
 extern std::unique_ptr<client> this_client;
 extern std::unique_ptr<journal> journalctl;
+extern std::unique_ptr<attr_cache> remote_attrs;
+extern std::unique_ptr<directory_table> indexing_table;
+extern struct mount_options nmfs_options;
+
+rpc_client::rpc_client(const std::string &remote_address, size_t num_channels) : next_stub(0),
+	compounds(COMPOUND_MAX_OPS, [this](const uuid &dentry_table_ino, const std::vector<rpc_compound_op> &ops, std::vector<rpc_compound_result> &results) {
+		return this->compound(dentry_table_ino, ops, results);
+	}), creates(this, remote_address)
+{
+	/* A local subchannel pool keeps the channels from sharing one connection */
+	grpc::ChannelArguments args;
+	args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+	for (size_t n = 0; n < std::max<size_t>(num_channels, 1); n++)
+		stubs.push_back(remote_ops::NewStub(grpc::CreateCustomChannel(remote_address, grpc::InsecureChannelCredentials(), args)));
+}
 
-rpc_client::rpc_client(std::shared_ptr<Channel> channel) : stub_(remote_ops::NewStub(channel)){}
+remote_ops::Stub *rpc_client::stub() {
+	return stubs[next_stub.fetch_add(1, std::memory_order_relaxed) % stubs.size()].get();
+}
+
+int rpc_client::not_leader(ClientContext &context, uint64_t dentry_table_ino_prefix, uint64_t dentry_table_ino_postfix) {
+	const auto &metadata = context.GetServerTrailingMetadata();
+	auto it = metadata.find(LEADER_METADATA_KEY);
+	if (it != metadata.end())
+		indexing_table->hint_leader(ino_controller->splice_prefix_and_postfix(dentry_table_ino_prefix, dentry_table_ino_postfix),
+					    std::string(it->second.data(), it->second.size()));
+	return -ENOTLEADER;
+}
 
 /* dentry_table operations */
 uuid rpc_client::check_child_inode(uuid dentry_table_ino, std::string filename){
 	global_logger.log(rpc_client_ops, "Called check_child_inode()");
+	this->creates.flush(dentry_table_ino);
 	ClientContext context;
 	rpc_dentry_table_request Input;
 	rpc_dentry_table_respond Output;
@@ -18,7 +51,7 @@ uuid rpc_client::check_child_inode(uuid dentry_table_ino, std::string filename){
 	Input.set_dentry_table_ino_postfix(ino_controller->get_postfix_from_uuid(dentry_table_ino));
 	Input.set_filename(filename);
 
-	Status status = stub_->rpc_check_child_inode(&context, Input, &Output);
+	Status status = stub()->rpc_check_child_inode(&context, Input, &Output);
 	if(status.ok()){
 		if(Output.ret() == -ENOTLEADER)
 			throw std::runtime_error("ACCESS IMPROPER LEADER");
@@ -29,9 +62,56 @@ uuid rpc_client::check_child_inode(uuid dentry_table_ino, std::string filename){
 	}
 }
 
+int rpc_client::resolve_path(uuid dentry_table_ino, const std::vector<std::string> &names, std::vector<resolved_component> &components){
+	global_logger.log(rpc_client_ops, "Called resolve_path()");
+	this->creates.flush(dentry_table_ino);
+	ClientContext context;
+	rpc_resolve_path_request Input;
+	rpc_resolve_path_respond Output;
+
+	Input.set_dentry_table_ino_prefix(ino_controller->get_prefix_from_uuid(dentry_table_ino));
+	Input.set_dentry_table_ino_postfix(ino_controller->get_postfix_from_uuid(dentry_table_ino));
+	for (const std::string &name : names)
+		Input.add_names(name);
+
+	Status status = stub()->rpc_resolve_path(&context, Input, &Output);
+	if(status.ok()){
+		if(Output.ret() == -ENOTLEADER)
+			throw std::runtime_error("ACCESS IMPROPER LEADER");
+
+		components.clear();
+		components.reserve(Output.components_size());
+		for (const rpc_resolved_component &c : Output.components()) {
+			resolved_component rc{};
+			rc.ino = ino_controller->splice_prefix_and_postfix(c.i_ino_prefix(), c.i_ino_postfix());
+			rc.attr.st_mode		= c.i_mode();
+			rc.attr.st_uid		= c.i_uid();
+			rc.attr.st_gid		= c.i_gid();
+			rc.attr.st_ino		= c.i_ino_postfix();
+			rc.attr.st_nlink	= c.i_nlink();
+			rc.attr.st_size		= c.i_size();
+
+			rc.attr.st_atim.tv_sec	= c.a_sec();
+			rc.attr.st_atim.tv_nsec	= c.a_nsec();
+			rc.attr.st_mtim.tv_sec	= c.m_sec();
+			rc.attr.st_mtim.tv_nsec	= c.m_nsec();
+			rc.attr.st_ctim.tv_sec	= c.c_sec();
+			rc.attr.st_ctim.tv_nsec	= c.c_nsec();
+			rc.searchable = c.searchable();
+			rc.lease_left = milliseconds(c.lease_left_ms());
+			components.push_back(rc);
+		}
+		return Output.ret();
+	} else {
+		global_logger.log(rpc_client_ops, status.error_message());
+		throw std::runtime_error("rpc_client::resolve_path() failed");
+	}
+}
+
 /* inode operations */
 mode_t rpc_client::get_mode(uuid dentry_table_ino, std::string filename){
 	global_logger.log(rpc_client_ops, "Called get_mode()");
+	this->creates.flush(dentry_table_ino);
 	ClientContext context;
 	rpc_inode_request Input;
 	rpc_inode_respond Output;
@@ -40,7 +120,7 @@ mode_t rpc_client::get_mode(uuid dentry_table_ino, std::string filename){
 	Input.set_dentry_table_ino_postfix(ino_controller->get_postfix_from_uuid(dentry_table_ino));
 	Input.set_filename(filename);
 
-	Status status = stub_->rpc_get_mode(&context, Input, &Output);
+	Status status = stub()->rpc_get_mode(&context, Input, &Output);
 	if(status.ok()){
 		if(Output.ret() == -ENOTLEADER)
 			throw std::runtime_error("ACCESS IMPROPER LEADER");
@@ -53,6 +133,7 @@ mode_t rpc_client::get_mode(uuid dentry_table_ino, std::string filename){
 
 void rpc_client::permission_check(uuid dentry_table_ino, std::string filename, int mask, bool target_is_parent){
 	global_logger.log(rpc_client_ops, "Called permission_check()");
+	this->creates.flush(dentry_table_ino);
 	ClientContext context;
 	rpc_inode_request Input;
 	rpc_inode_respond Output;
@@ -63,7 +144,7 @@ void rpc_client::permission_check(uuid dentry_table_ino, std::string filename, i
 	Input.set_mask(mask);
 	Input.set_target_is_parent(target_is_parent);
 
-	Status status = stub_->rpc_permission_check(&context, Input, &Output);
+	Status status = stub()->rpc_permission_check(&context, Input, &Output);
 	if(status.ok()){
 		if(Output.ret() == -ENOTLEADER)
 			throw std::runtime_error("ACCESS IMPROPER LEADER");
@@ -77,22 +158,23 @@ void rpc_client::permission_check(uuid dentry_table_ino, std::string filename, i
 }
 
 /* file system operations */
-int rpc_client::getattr(shared_ptr<remote_inode> i, struct stat* s) {
+int rpc_client::getattr(uuid dentry_table_ino, const std::string &filename, bool target_is_parent, struct stat* s, milliseconds &lease_left) {
 	global_logger.log(rpc_client_ops, "Called getattr()");
+	this->creates.flush(dentry_table_ino);
 	ClientContext context;
 	rpc_getattr_request Input;
 	rpc_getattr_respond Output;
 
 	/* prepare Input */
-	Input.set_dentry_table_ino_prefix(ino_controller->get_prefix_from_uuid(i->get_dentry_table_ino()));
-	Input.set_dentry_table_ino_postfix(ino_controller->get_postfix_from_uuid(i->get_dentry_table_ino()));
-	Input.set_filename(i->get_file_name());
-	Input.set_target_is_parent(i->get_target_is_parent());
+	Input.set_dentry_table_ino_prefix(ino_controller->get_prefix_from_uuid(dentry_table_ino));
+	Input.set_dentry_table_ino_postfix(ino_controller->get_postfix_from_uuid(dentry_table_ino));
+	Input.set_filename(filename);
+	Input.set_target_is_parent(target_is_parent);
 
-	Status status = stub_->rpc_getattr(&context, Input, &Output);
+	Status status = stub()->rpc_getattr(&context, Input, &Output);
 	if(status.ok()){
 		if(Output.ret() == -ENOTLEADER)
-			return -ENOTLEADER;
+			return this->not_leader(context, Input);
 
 		if(Output.ret() == -EACCES)
 			throw inode::no_entry("No such file or directory: rpc_client::getattr()");
@@ -109,8 +191,9 @@ int rpc_client::getattr(shared_ptr<remote_inode> i, struct stat* s) {
 		s->st_mtim.tv_sec	= Output.m_sec();
 		s->st_mtim.tv_nsec	= Output.m_nsec();
 		s->st_ctim.tv_sec	= Output.c_sec();
-		s->st_ctim.tv_sec	= Output.c_nsec();
+		s->st_ctim.tv_nsec	= Output.c_nsec();
 
+		lease_left = milliseconds(Output.lease_left_ms());
 		return Output.ret();
 	} else {
 		global_logger.log(rpc_client_ops, status.error_message());
@@ -121,6 +204,7 @@ int rpc_client::getattr(shared_ptr<remote_inode> i, struct stat* s) {
 
 int rpc_client::access(shared_ptr<remote_inode> i, int mask) {
 	global_logger.log(rpc_client_ops, "Called access()");
+	this->creates.flush(i->get_dentry_table_ino());
 	ClientContext context;
 	rpc_access_request Input;
 	rpc_common_respond Output;
@@ -132,10 +216,10 @@ int rpc_client::access(shared_ptr<remote_inode> i, int mask) {
 	Input.set_mask(mask);
 	Input.set_target_is_parent(i->get_target_is_parent());
 
-	Status status = stub_->rpc_access(&context, Input, &Output);
+	Status status = stub()->rpc_access(&context, Input, &Output);
 	if(status.ok()){
 		if(Output.ret() == -ENOTLEADER)
-			return -ENOTLEADER;
+			return this->not_leader(context, Input);
 
 		if(Output.ret() == -EACCES)
 			throw inode::permission_denied("Permission Denied: Remote");
@@ -150,6 +234,7 @@ int rpc_client::access(shared_ptr<remote_inode> i, int mask) {
 
 int rpc_client::opendir(shared_ptr<remote_inode> i, struct fuse_file_info* file_info) {
 	global_logger.log(rpc_client_ops, "Called opendir()");
+	this->creates.flush(i->get_dentry_table_ino());
 	ClientContext context;
 	rpc_open_opendir_request Input;
 	rpc_common_respond Output;
@@ -160,10 +245,10 @@ int rpc_client::opendir(shared_ptr<remote_inode> i, struct fuse_file_info* file_
 	Input.set_filename(i->get_file_name());
 	Input.set_target_is_parent(i->get_target_is_parent());
 
-	Status status = stub_->rpc_opendir(&context, Input, &Output);
+	Status status = stub()->rpc_opendir(&context, Input, &Output);
 	if(status.ok()){
 		if(Output.ret() == -ENOTLEADER)
-			return -ENOTLEADER;
+			return this->not_leader(context, Input);
 
 		if(Output.ret() == 0) {
 			shared_ptr<file_handler> fh = std::make_shared<file_handler>(i->get_ino());
@@ -183,27 +268,69 @@ int rpc_client::opendir(shared_ptr<remote_inode> i, struct fuse_file_info* file_
 	}
 }
 
-int rpc_client::readdir(shared_ptr<remote_inode> i, void* buffer, fuse_fill_dir_t filler) {
+int rpc_client::readdir(shared_ptr<remote_inode> i, void* buffer, fill_dir_t filler, off_t offset, bool plus) {
 	global_logger.log(rpc_client_ops, "Called readdir()");
+	this->creates.flush(i->get_dentry_table_ino());
 	ClientContext context;
 	rpc_readdir_request Input;
-	rpc_name_respond Output;
+	rpc_readdir_respond Output;
 
 	Input.set_dentry_table_ino_prefix(ino_controller->get_prefix_from_uuid(i->get_dentry_table_ino()));
 	Input.set_dentry_table_ino_postfix(ino_controller->get_postfix_from_uuid(i->get_dentry_table_ino()));
-	std::unique_ptr<ClientReader<rpc_name_respond>> reader(stub_->rpc_readdir(&context, Input));
+	Input.set_plus(plus);
+	Input.set_offset(offset);
+	std::unique_ptr<ClientReader<rpc_readdir_respond>> reader(stub()->rpc_readdir(&context, Input));
 
-	while(reader->Read(&Output)){
-		if(Output.ret() == 0)
-			filler(buffer, Output.filename().c_str(), nullptr, 0, static_cast<fuse_fill_dir_flags>(0));
-		else
+	uint64_t gen = remote_attrs->get_gen();
+	bool full = false;
+	while(!full && reader->Read(&Output)){
+		if(Output.ret() != 0)
 			break;
+
+		for (const rpc_dirent &e : Output.entries()) {
+			if(!e.has_attr()) {
+				if (filler(buffer, e.filename().c_str(), nullptr, e.offset(), nullptr)) {
+					full = true;
+					break;
+				}
+				continue;
+			}
+
+			struct stat s{};
+			s.st_mode	= e.i_mode();
+			s.st_uid	= e.i_uid();
+			s.st_gid	= e.i_gid();
+			s.st_ino	= e.i_ino_postfix();
+			s.st_nlink	= e.i_nlink();
+			s.st_size	= e.i_size();
+
+			s.st_atim.tv_sec	= e.a_sec();
+			s.st_atim.tv_nsec	= e.a_nsec();
+			s.st_mtim.tv_sec	= e.m_sec();
+			s.st_mtim.tv_nsec	= e.m_nsec();
+			s.st_ctim.tv_sec	= e.c_sec();
+			s.st_ctim.tv_nsec	= e.c_nsec();
+
+			uuid ino = ino_controller->splice_prefix_and_postfix(e.i_ino_prefix(), e.i_ino_postfix());
+			remote_attrs->put(ino, s, milliseconds(Output.lease_left_ms()), gen);
+			if (filler(buffer, e.filename().c_str(), &s, e.offset(), &ino)) {
+				full = true;
+				break;
+			}
+		}
+	}
+
+	/* The rest is listed by the next call, from the offset of the last entry filled */
+	if (full) {
+		context.TryCancel();
+		reader->Finish();
+		return 0;
 	}
 
 	Status status = reader->Finish();
 	if(status.ok()){
 		if(Output.ret() == -ENOTLEADER)
-			return -ENOTLEADER;
+			return this->not_leader(context, Input);
 
 		return Output.ret();
 	} else {
@@ -215,48 +342,35 @@ int rpc_client::readdir(shared_ptr<remote_inode> i, void* buffer, fuse_fill_dir_
 
 int rpc_client::mkdir(shared_ptr<remote_inode> parent_i, std::string new_child_name, mode_t mode, std::shared_ptr<inode>& new_dir_inode, std::shared_ptr<dentry>& new_dir_dentry) {
 	global_logger.log(rpc_client_ops, "Called mkdir()");
-	ClientContext context;
-	rpc_mkdir_request Input;
-	rpc_mkdir_respond Output;
-
-	/* prepare Input */
-	Input.set_dentry_table_ino_prefix(ino_controller->get_prefix_from_uuid(parent_i->get_dentry_table_ino()));
-	Input.set_dentry_table_ino_postfix(ino_controller->get_postfix_from_uuid(parent_i->get_dentry_table_ino()));
-	Input.set_new_dir_name(new_child_name);
-	Input.set_new_mode(mode);
-	Input.set_uid(this_client->get_client_uid());
-	Input.set_gid(this_client->get_client_gid());
-
-	Status status = stub_->rpc_mkdir(&context, Input, &Output);
-	if(status.ok()){
-		if(Output.ret() == -ENOTLEADER) {
-			new_dir_inode = nullptr;
-			return -ENOTLEADER;
-		}
-
-		if(Output.ret() == 0){
-			uuid returned_dir_ino = ino_controller->splice_prefix_and_postfix(Output.new_dir_ino_prefix(), Output.new_dir_ino_postfix());
-			shared_ptr<inode> new_i = std::make_shared<inode>(parent_i->get_ino(), this_client->get_client_uid(), this_client->get_client_gid(), mode | S_IFDIR, returned_dir_ino);
-			new_i->set_size(DIR_INODE_SIZE);
-
-			shared_ptr<dentry> new_d = std::make_shared<dentry>(new_i->get_ino(), true);
-			journalctl->mkself(new_i);
-
-			new_dir_inode = new_i;
-			new_dir_dentry = new_d;
-		}
-
-		return Output.ret();
+	rpc_compound_op op;
+	rpc_compound_result result;
+
+	op.set_type(rpc_compound_op::MKDIR);
+	op.set_filename(new_child_name);
+	op.set_mode(mode);
+	op.set_uid(this_client->get_client_uid());
+	op.set_gid(this_client->get_client_gid());
+
+	int ret = compound_op(parent_i->get_dentry_table_ino(), op, result);
+	if (ret == 0) {
+		uuid returned_dir_ino = ino_controller->splice_prefix_and_postfix(result.new_ino_prefix(), result.new_ino_postfix());
+		shared_ptr<inode> new_i = std::make_shared<inode>(parent_i->get_ino(), this_client->get_client_uid(), this_client->get_client_gid(), mode | S_IFDIR, returned_dir_ino);
+		new_i->set_size(DIR_INODE_SIZE);
+
+		shared_ptr<dentry> new_d = std::make_shared<dentry>(new_i->get_ino(), true);
+		journalctl->mkself(new_i);
+
+		new_dir_inode = new_i;
+		new_dir_dentry = new_d;
 	} else {
-		global_logger.log(rpc_client_ops, status.error_message());
-		global_logger.log(rpc_client_ops, "rpc_client::mkdir() failed");
 		new_dir_inode = nullptr;
-		return -ENEEDRECOV;
 	}
+	return ret;
 }
 
 int rpc_client::rmdir_top(shared_ptr<remote_inode> target_i, uuid target_ino) {
 	global_logger.log(rpc_client_ops, "Called rmdir_top()");
+	this->creates.flush(target_i->get_dentry_table_ino());
 	ClientContext context;
 	rpc_rmdir_request Input;
 	rpc_common_respond Output;
@@ -267,10 +381,10 @@ int rpc_client::rmdir_top(shared_ptr<remote_inode> target_i, uuid target_ino) {
 	Input.set_target_ino_prefix(ino_controller->get_prefix_from_uuid(target_ino));
 	Input.set_target_ino_postfix(ino_controller->get_postfix_from_uuid(target_ino));
 
-	Status status = stub_->rpc_rmdir_top(&context, Input, &Output);
+	Status status = stub()->rpc_rmdir_top(&context, Input, &Output);
 	if(status.ok()){
 		if(Output.ret() == -ENOTLEADER)
-			return -ENOTLEADER;
+			return this->not_leader(context, Input);
 
 		return Output.ret();
 	} else {
@@ -282,6 +396,7 @@ int rpc_client::rmdir_top(shared_ptr<remote_inode> target_i, uuid target_ino) {
 
 int rpc_client::rmdir_down(shared_ptr<remote_inode> parent_i, uuid target_ino, std::string target_name) {
 	global_logger.log(rpc_client_ops, "Called rmdir_down()");
+	this->creates.flush(parent_i->get_dentry_table_ino());
 	ClientContext context;
 	rpc_rmdir_request Input;
 	rpc_common_respond Output;
@@ -292,10 +407,10 @@ int rpc_client::rmdir_down(shared_ptr<remote_inode> parent_i, uuid target_ino, s
 	Input.set_target_name(target_name);
 	Input.set_target_ino_prefix(ino_controller->get_prefix_from_uuid(target_ino));
 	Input.set_target_ino_postfix(ino_controller->get_postfix_from_uuid(target_ino));
-	Status status = stub_->rpc_rmdir_down(&context, Input, &Output);
+	Status status = stub()->rpc_rmdir_down(&context, Input, &Output);
 	if(status.ok()){
 		if(Output.ret() == -ENOTLEADER)
-			return -ENOTLEADER;
+			return this->not_leader(context, Input);
 
 		return Output.ret();
 	} else {
@@ -307,32 +422,21 @@ int rpc_client::rmdir_down(shared_ptr<remote_inode> parent_i, uuid target_ino, s
 
 int rpc_client::symlink(shared_ptr<remote_inode> dst_parent_i, const char *src, const char *dst) {
 	global_logger.log(rpc_client_ops, "Called symlink()");
-	ClientContext context;
-	rpc_symlink_request Input;
-	rpc_common_respond Output;
+	rpc_compound_op op;
+	rpc_compound_result result;
 
-	/* prepare Input */
-	Input.set_dentry_table_ino_prefix(ino_controller->get_prefix_from_uuid(dst_parent_i->get_dentry_table_ino()));
-	Input.set_dentry_table_ino_postfix(ino_controller->get_postfix_from_uuid(dst_parent_i->get_dentry_table_ino()));
-	Input.set_filename(dst_parent_i->get_file_name());
-	Input.set_src(src);
-	Input.set_dst(dst);
+	op.set_type(rpc_compound_op::SYMLINK);
+	op.set_filename(*get_filename_from_path(dst));
+	op.set_link_target(src);
+	op.set_uid(this_client->get_client_uid());
+	op.set_gid(this_client->get_client_gid());
 
-	Status status = stub_->rpc_symlink(&context, Input, &Output);
-	if(status.ok()){
-		if(Output.ret() == -ENOTLEADER)
-			return -ENOTLEADER;
-
-		return Output.ret();
-	} else {
-		global_logger.log(rpc_client_ops, status.error_message());
-		global_logger.log(rpc_client_ops, "rpc_client::symlink() failed");
-		return -ENEEDRECOV;
-	}
+	return compound_op(dst_parent_i->get_dentry_table_ino(), op, result);
 }
 
 int rpc_client::readlink(shared_ptr<remote_inode> i, char *buf, size_t size) {
 	global_logger.log(rpc_client_ops, "Called readlink()");
+	this->creates.flush(i->get_dentry_table_ino());
 	ClientContext context;
 	rpc_readlink_request Input;
 	rpc_name_respond Output;
@@ -343,10 +447,10 @@ int rpc_client::readlink(shared_ptr<remote_inode> i, char *buf, size_t size) {
 	Input.set_filename(i->get_file_name());
 	Input.set_size(size);
 
-	Status status = stub_->rpc_readlink(&context, Input, &Output);
+	Status status = stub()->rpc_readlink(&context, Input, &Output);
 	if(status.ok()){
 		if(Output.ret() == -ENOTLEADER)
-			return -ENOTLEADER;
+			return this->not_leader(context, Input);
 
 		if(Output.ret() == 0) {
 			/* fill buffer */
@@ -365,6 +469,7 @@ int rpc_client::readlink(shared_ptr<remote_inode> i, char *buf, size_t size) {
 
 int rpc_client::rename_same_parent(shared_ptr<remote_inode> parent_i, const char* old_path, const char* new_path, unsigned int flags) {
 	global_logger.log(rpc_client_ops, "Called access()");
+	this->creates.flush(parent_i->get_dentry_table_ino());
 	ClientContext context;
 	rpc_rename_same_parent_request Input;
 	rpc_common_respond Output;
@@ -376,10 +481,13 @@ int rpc_client::rename_same_parent(shared_ptr<remote_inode> parent_i, const char
 	Input.set_new_path(new_path);
 	Input.set_flags(flags);
 
-	Status status = stub_->rpc_rename_same_parent(&context, Input, &Output);
+	Status status = stub()->rpc_rename_same_parent(&context, Input, &Output);
 	if(status.ok()){
 		if(Output.ret() == -ENOTLEADER)
-			return -ENOTLEADER;
+			return this->not_leader(context, Input);
+
+		if(Output.ret() == 0)
+			this->creates.revoke(parent_i->get_dentry_table_ino());
 
 		return Output.ret();
 	} else {
@@ -391,6 +499,7 @@ int rpc_client::rename_same_parent(shared_ptr<remote_inode> parent_i, const char
 
 int rpc_client::rename_not_same_parent_src(shared_ptr<remote_inode> src_parent_i, const char* old_path, unsigned int flags, std::shared_ptr<inode>& target_inode) {
 	global_logger.log(rpc_client_ops, "Called remote_rename_not_same_parent_src()");
+	this->creates.flush(src_parent_i->get_dentry_table_ino());
 	ClientContext context;
 	rpc_rename_not_same_parent_src_request Input;
 	rpc_rename_not_same_parent_src_respond Output;
@@ -400,11 +509,11 @@ int rpc_client::rename_not_same_parent_src(shared_ptr<remote_inode> src_parent_i
 	Input.set_old_path(old_path);
 	Input.set_flags(flags);
 
-	Status status = stub_->rpc_rename_not_same_parent_src(&context, Input, &Output);
+	Status status = stub()->rpc_rename_not_same_parent_src(&context, Input, &Output);
 	if(status.ok()){
 		if(Output.ret() == -ENOTLEADER) {
 			target_inode = nullptr;
-			return -ENOTLEADER;
+			return this->not_leader(context, Input);
 		}
 
 		if(Output.ret() == -ENOSYS) {
@@ -427,6 +536,7 @@ int rpc_client::rename_not_same_parent_src(shared_ptr<remote_inode> src_parent_i
 
 int rpc_client::rename_not_same_parent_dst(shared_ptr<remote_inode> dst_parent_i, std::shared_ptr<inode>& target_inode, uuid check_dst_ino, const char* new_path, unsigned int flags) {
 	global_logger.log(rpc_client_ops, "Called remote_rename_not_same_parent_dst()");
+	this->creates.flush(dst_parent_i->get_dentry_table_ino());
 	ClientContext context;
 	rpc_rename_not_same_parent_dst_request Input;
 	rpc_common_respond Output;
@@ -439,10 +549,13 @@ int rpc_client::rename_not_same_parent_dst(shared_ptr<remote_inode> dst_parent_i
 	Input.set_new_path(new_path);
 	Input.set_flags(flags);
 
-	Status status = stub_->rpc_rename_not_same_parent_dst(&context, Input, &Output);
+	Status status = stub()->rpc_rename_not_same_parent_dst(&context, Input, &Output);
 	if(status.ok()){
 		if(Output.ret() == -ENOTLEADER)
-			return -ENOTLEADER;
+			return this->not_leader(context, Input);
+
+		if(Output.ret() == 0)
+			this->creates.revoke(dst_parent_i->get_dentry_table_ino());
 
 		return Output.ret();
 	} else {
@@ -454,9 +567,10 @@ int rpc_client::rename_not_same_parent_dst(shared_ptr<remote_inode> dst_parent_i
 
 int rpc_client::open(shared_ptr<remote_inode> i, struct fuse_file_info* file_info) {
 	global_logger.log(rpc_client_ops, "Called open()");
+	this->creates.flush(i->get_dentry_table_ino());
 	ClientContext context;
 	rpc_open_opendir_request Input;
-	rpc_common_respond Output;
+	rpc_open_respond Output;
 
 	/* prepare Input */
 	Input.set_dentry_table_ino_prefix(ino_controller->get_prefix_from_uuid(i->get_dentry_table_ino()));
@@ -464,11 +578,13 @@ int rpc_client::open(shared_ptr<remote_inode> i, struct fuse_file_info* file_inf
 	Input.set_filename(i->get_file_name());
 	Input.set_flags(file_info->flags);
 
-	Status status = stub_->rpc_open(&context, Input, &Output);
+	Status status = stub()->rpc_open(&context, Input, &Output);
 	if(status.ok()){
 		if(Output.ret() == -ENOTLEADER)
-			return -ENOTLEADER;
+			return this->not_leader(context, Input);
 		else if(Output.ret() == 0) {
+			/* reads of the sparse data stop at the size seen at open */
+			i->set_size(Output.i_size());
 			shared_ptr<file_handler> fh = std::make_shared<file_handler>(i->get_ino());
 			fh->set_loc(REMOTE);
 			fh->set_remote_i(i);
@@ -487,67 +603,70 @@ int rpc_client::open(shared_ptr<remote_inode> i, struct fuse_file_info* file_inf
 
 int rpc_client::create(shared_ptr<remote_inode> parent_i, std::string new_child_name, mode_t mode, struct fuse_file_info* file_info) {
 	global_logger.log(rpc_client_ops, "Called create()");
-	ClientContext context;
-	rpc_create_request Input;
-	rpc_create_respond Output;
+	uuid dentry_table_ino = parent_i->get_dentry_table_ino();
+	uuid new_ino;
+
+	/* Under a delegation the leader is told later, O_EXCL has to know the name isn't taken */
+	if (nmfs_options.async_creates > 0 && !(file_info->flags & O_EXCL) &&
+	    this->creates.create(dentry_table_ino, new_child_name, mode, this_client->get_client_uid(), this_client->get_client_gid(), new_ino)) {
+		inode new_i(dentry_table_ino, this_client->get_client_uid(), this_client->get_client_gid(), mode | S_IFREG, new_ino);
+		struct stat attr{};
+		new_i.fill_stat(&attr);
+		remote_attrs->put(new_ino, attr, milliseconds(nmfs_options.attr_ttl_ms), remote_attrs->get_gen());
+
+		open_created(parent_i, new_child_name, new_ino, file_info);
+		return 0;
+	}
 
-	/* prepare Input */
-	Input.set_dentry_table_ino_prefix(ino_controller->get_prefix_from_uuid(parent_i->get_dentry_table_ino()));
-	Input.set_dentry_table_ino_postfix(ino_controller->get_postfix_from_uuid(parent_i->get_dentry_table_ino()));
-	Input.set_new_file_name(new_child_name);
-	Input.set_new_mode(mode);
+	rpc_compound_op op;
+	rpc_compound_result result;
 
-	Status status = stub_->rpc_create(&context, Input, &Output);
-	if(status.ok()){
-		if(Output.ret() == -ENOTLEADER)
-			return -ENOTLEADER;
-		else if(Output.ret() == 0) {
-			uuid new_ino = ino_controller->splice_prefix_and_postfix(Output.new_ino_prefix(), Output.new_ino_postfix());
-			shared_ptr<file_handler> fh = std::make_shared<file_handler>(new_ino);
-			fh->set_loc(REMOTE);
-			std::shared_ptr<remote_inode> open_remote_i = std::make_shared<remote_inode>(parent_i->get_address(), parent_i->get_dentry_table_ino(), new_child_name);
-			open_remote_i->inode::set_ino(new_ino);
-			fh->set_remote_i(open_remote_i);
-			file_info->fh = reinterpret_cast<uint64_t>(fh.get());
-			fh->set_fhno(file_info->fh);
+	op.set_type(rpc_compound_op::CREATE);
+	op.set_filename(new_child_name);
+	op.set_mode(mode);
+	op.set_uid(this_client->get_client_uid());
+	op.set_gid(this_client->get_client_gid());
 
-			open_context->add_file_handler(file_info->fh, fh);
-		}
-		return Output.ret();
-	} else {
-		global_logger.log(rpc_client_ops, status.error_message());
-		global_logger.log(rpc_client_ops, "rpc_client::create() failed");
-		return -ENEEDRECOV;
+	int ret = compound_op(dentry_table_ino, op, result);
+	if (ret == 0) {
+		new_ino = ino_controller->splice_prefix_and_postfix(result.new_ino_prefix(), result.new_ino_postfix());
+		open_created(parent_i, new_child_name, new_ino, file_info);
+
+		/* The next creations in the directory won't wait for the leader */
+		if (nmfs_options.async_creates > 0 && !this->creates.delegated(dentry_table_ino))
+			this->delegate_creates(dentry_table_ino, nmfs_options.async_creates);
 	}
+	return ret;
+}
+
+void rpc_client::open_created(shared_ptr<remote_inode> parent_i, const std::string &new_child_name, uuid new_ino, struct fuse_file_info* file_info) {
+	shared_ptr<file_handler> fh = std::make_shared<file_handler>(new_ino);
+	fh->set_loc(REMOTE);
+	std::shared_ptr<remote_inode> open_remote_i = std::make_shared<remote_inode>(parent_i->get_address(), parent_i->get_dentry_table_ino(), new_child_name);
+	open_remote_i->inode::set_ino(new_ino);
+	open_remote_i->set_size(0);
+	fh->set_remote_i(open_remote_i);
+	file_info->fh = reinterpret_cast<uint64_t>(fh.get());
+	fh->set_fhno(file_info->fh);
+
+	open_context->add_file_handler(file_info->fh, fh);
 }
 
 int rpc_client::unlink(shared_ptr<remote_inode> parent_i, std::string child_name) {
 	global_logger.log(rpc_client_ops, "Called unlink()");
-	ClientContext context;
-	rpc_unlink_request Input;
-	rpc_common_respond Output;
-
-	/* prepare Input */
-	Input.set_dentry_table_ino_prefix(ino_controller->get_prefix_from_uuid(parent_i->get_dentry_table_ino()));
-	Input.set_dentry_table_ino_postfix(ino_controller->get_postfix_from_uuid(parent_i->get_dentry_table_ino()));
-	Input.set_filename(child_name);
+	rpc_compound_op op;
+	rpc_compound_result result;
 
-	Status status = stub_->rpc_unlink(&context, Input, &Output);
-	if(status.ok()){
-		if(Output.ret() == -ENOTLEADER)
-			return -ENOTLEADER;
+	op.set_type(rpc_compound_op::UNLINK);
+	op.set_filename(child_name);
 
-		return Output.ret();
-	} else {
-		global_logger.log(rpc_client_ops, status.error_message());
-		global_logger.log(rpc_client_ops, "rpc_client::unlink() failed");
-		return -ENEEDRECOV;
-	}
+	return compound_op(parent_i->get_dentry_table_ino(), op, result);
 }
 
 
-ssize_t rpc_client::write(shared_ptr<remote_inode> i, const char* buffer, size_t size, off_t offset, int flags) {
+ssize_t rpc_client::write(shared_ptr<remote_inode> i, const char* buffer, size_t size, off_t offset, int flags, bool *leader_caches) {
 	global_logger.log(rpc_client_ops, "Called write()");
+	this->creates.flush(i->get_dentry_table_ino());
 	ClientContext context;
 	rpc_write_request Input;
 	rpc_write_respond Output;
@@ -560,12 +679,23 @@ ssize_t rpc_client::write(shared_ptr<remote_inode> i, const char* buffer, size_t
 	Input.set_size(size);
 	Input.set_flags(flags);
 
-	Status status = stub_->rpc_write(&context, Input, &Output);
+	Status status = stub()->rpc_write(&context, Input, &Output);
 	if(status.ok()){
 		if(Output.ret() == -ENOTLEADER)
-			return -ENOTLEADER;
+			return this->not_leader(context, Input);
 		else if(Output.ret() == 0) {
+			if (leader_caches != nullptr)
+				*leader_caches = Output.cached();
 			size_t written_len = data_pool->write(obj_category::DATA, uuid_to_string(i->get_ino()), buffer, Output.size(), Output.offset());
+			if (i->get_size() < Output.offset() + static_cast<off_t>(Output.size()))
+				i->set_size(Output.offset() + Output.size());
+
+			/* The pages the leader may have read meanwhile are dropped once the data is there (see kernel_cache) */
+			if (size > 0 && Output.cached()) {
+				ssize_t landed_ret = this->write(i, nullptr, 0, Output.offset() + Output.size(), 0);
+				if (landed_ret < 0)
+					global_logger.log(rpc_client_ops, "rpc_client::write() couldn't tell the leader the data landed (" + std::to_string(landed_ret) + ")");
+			}
 			return static_cast<ssize_t>(written_len);
 		}
 		return Output.ret();
@@ -578,110 +708,182 @@ ssize_t rpc_client::write(shared_ptr<remote_inode> i, const char* buffer, size_t
 
 int rpc_client::chmod(shared_ptr<remote_inode> i, mode_t mode) {
 	global_logger.log(rpc_client_ops, "Called chmod()");
+	rpc_compound_op op;
+	rpc_compound_result result;
+
+	op.set_type(rpc_compound_op::SETATTR);
+	op.set_filename(i->get_file_name());
+	op.set_target_is_parent(i->get_target_is_parent());
+	op.set_set_mode(true);
+	op.set_mode(mode);
+
+	return compound_op(i->get_dentry_table_ino(), op, result);
+}
+
+int rpc_client::chown(shared_ptr<remote_inode> i, uid_t uid, gid_t gid) {
+	global_logger.log(rpc_client_ops, "Called chown()");
+	rpc_compound_op op;
+	rpc_compound_result result;
+
+	op.set_type(rpc_compound_op::SETATTR);
+	op.set_filename(i->get_file_name());
+	op.set_target_is_parent(i->get_target_is_parent());
+	op.set_set_owner(true);
+	op.set_new_uid(uid);
+	op.set_new_gid(gid);
+
+	return compound_op(i->get_dentry_table_ino(), op, result);
+}
+
+int rpc_client::utimens(shared_ptr<remote_inode> i, const struct timespec tv[2]) {
+	global_logger.log(rpc_client_ops, "Called utimens()");
+	rpc_compound_op op;
+	rpc_compound_result result;
+
+	op.set_type(rpc_compound_op::SETATTR);
+	op.set_filename(i->get_file_name());
+	op.set_target_is_parent(i->get_target_is_parent());
+	op.set_set_times(true);
+	op.set_a_sec(tv[0].tv_sec);
+	op.set_a_nsec(tv[0].tv_nsec);
+	op.set_m_sec(tv[1].tv_sec);
+	op.set_m_nsec(tv[1].tv_nsec);
+
+	return compound_op(i->get_dentry_table_ino(), op, result);
+}
+
+int rpc_client::truncate(shared_ptr<remote_inode> i, off_t offset) {
+	global_logger.log(rpc_client_ops, "Called truncate()");
+	this->creates.flush(i->get_dentry_table_ino());
 	ClientContext context;
-	rpc_chmod_request Input;
-	rpc_common_respond Output;
+	rpc_truncate_request Input;
+	rpc_truncate_respond Output;
 
 	/* prepare Input */
 	Input.set_dentry_table_ino_prefix(ino_controller->get_prefix_from_uuid(i->get_dentry_table_ino()));
 	Input.set_dentry_table_ino_postfix(ino_controller->get_postfix_from_uuid(i->get_dentry_table_ino()));
 	Input.set_filename(i->get_file_name());
-	Input.set_mode(mode);
+	Input.set_offset(offset);
+	Input.set_target_is_parent(i->get_target_is_parent());
 
-	Status status = stub_->rpc_chmod(&context, Input, &Output);
+	Status status = stub()->rpc_truncate(&context, Input, &Output);
 	if(status.ok()){
 		if(Output.ret() == -ENOTLEADER)
-			return -ENOTLEADER;
-
+			return this->not_leader(context, Input);
+		else if(Output.ret() == 0) {
+			int ret = data_pool->truncate(obj_category::DATA, uuid_to_string(i->get_ino()), offset, Output.file_size());
+			i->set_size(offset);
+			return ret;
+		}
 		return Output.ret();
 	} else {
 		global_logger.log(rpc_client_ops, status.error_message());
-		global_logger.log(rpc_client_ops, "rpc_client::chmod() failed");
+		global_logger.log(rpc_client_ops, "rpc_client::truncate() failed");
 		return -ENEEDRECOV;
 	}
 }
 
-int rpc_client::chown(shared_ptr<remote_inode> i, uid_t uid, gid_t gid) {
-	global_logger.log(rpc_client_ops, "Called chown()");
+int rpc_client::fallocate(shared_ptr<remote_inode> i, int mode, off_t offset, off_t length) {
+	global_logger.log(rpc_client_ops, "Called fallocate()");
+	this->creates.flush(i->get_dentry_table_ino());
 	ClientContext context;
-	rpc_chown_request Input;
-	rpc_common_respond Output;
+	rpc_fallocate_request Input;
+	rpc_fallocate_respond Output;
 
 	/* prepare Input */
 	Input.set_dentry_table_ino_prefix(ino_controller->get_prefix_from_uuid(i->get_dentry_table_ino()));
 	Input.set_dentry_table_ino_postfix(ino_controller->get_postfix_from_uuid(i->get_dentry_table_ino()));
 	Input.set_filename(i->get_file_name());
-	Input.set_uid(uid);
-	Input.set_gid(gid);
-	Input.set_target_is_parent(i->get_target_is_parent());
+	Input.set_mode(mode);
+	Input.set_offset(offset);
+	Input.set_length(length);
 
-	Status status = stub_->rpc_chown(&context, Input, &Output);
+	Status status = stub()->rpc_fallocate(&context, Input, &Output);
 	if(status.ok()){
 		if(Output.ret() == -ENOTLEADER)
-			return -ENOTLEADER;
-
+			return this->not_leader(context, Input);
+		else if(Output.ret() == 0) {
+			off_t file_size = static_cast<off_t>(Output.file_size());
+			if ((mode & FALLOC_FL_PUNCH_HOLE) && offset < file_size)
+				data_pool->punch_hole(obj_category::DATA, uuid_to_string(i->get_ino()), offset, MIN(length, file_size - offset));
+			else if (!(mode & FALLOC_FL_KEEP_SIZE) && file_size < offset + length)
+				i->set_size(offset + length);
+		}
 		return Output.ret();
 	} else {
 		global_logger.log(rpc_client_ops, status.error_message());
-		global_logger.log(rpc_client_ops, "rpc_client::chown() failed");
+		global_logger.log(rpc_client_ops, "rpc_client::fallocate() failed");
 		return -ENEEDRECOV;
 	}
 }
 
-int rpc_client::utimens(shared_ptr<remote_inode> i, const struct timespec tv[2]) {
-	global_logger.log(rpc_client_ops, "Called utimens()");
+int rpc_client::compound(uuid dentry_table_ino, const std::vector<rpc_compound_op> &ops, std::vector<rpc_compound_result> &results) {
+	global_logger.log(rpc_client_ops, "Called compound(" + std::to_string(ops.size()) + ")");
 	ClientContext context;
-	rpc_utimens_request Input;
-	rpc_common_respond Output;
+	rpc_compound_request Input;
+	rpc_compound_respond Output;
 
 	/* prepare Input */
-	Input.set_dentry_table_ino_prefix(ino_controller->get_prefix_from_uuid(i->get_dentry_table_ino()));
-	Input.set_dentry_table_ino_postfix(ino_controller->get_postfix_from_uuid(i->get_dentry_table_ino()));
-	Input.set_filename(i->get_file_name());
-	Input.set_a_sec(tv[0].tv_sec);
-	Input.set_a_nsec(tv[0].tv_nsec);
-	Input.set_m_sec(tv[1].tv_sec);
-	Input.set_m_nsec(tv[1].tv_nsec);
-	Input.set_target_is_parent(i->get_target_is_parent());
+	Input.set_dentry_table_ino_prefix(ino_controller->get_prefix_from_uuid(dentry_table_ino));
+	Input.set_dentry_table_ino_postfix(ino_controller->get_postfix_from_uuid(dentry_table_ino));
+	for (const auto &op : ops)
+		*Input.add_ops() = op;
 
-	Status status = stub_->rpc_utimens(&context, Input, &Output);
+	Status status = stub()->rpc_compound(&context, Input, &Output);
 	if(status.ok()){
 		if(Output.ret() == -ENOTLEADER)
-			return -ENOTLEADER;
+			return this->not_leader(context, Input);
+		if(Output.ret() != 0)
+			return Output.ret();
 
-		return Output.ret();
+		results.assign(Output.results().begin(), Output.results().end());
+		return 0;
 	} else {
 		global_logger.log(rpc_client_ops, status.error_message());
-		global_logger.log(rpc_client_ops, "rpc_client::utimnes() failed");
+		global_logger.log(rpc_client_ops, "rpc_client::compound() failed");
 		return -ENEEDRECOV;
 	}
 }
 
-int rpc_client::truncate(shared_ptr<remote_inode> i, off_t offset) {
-	global_logger.log(rpc_client_ops, "Called truncate()");
+int rpc_client::compound_op(uuid dentry_table_ino, const rpc_compound_op &op, rpc_compound_result &result) {
+	this->creates.flush(dentry_table_ino);
+	int ret = compounds.run(dentry_table_ino, op, result);
+	/* The leader takes back every delegation on the directory once a name is added, this one's too */
+	if (ret == 0 && op.type() != rpc_compound_op::UNLINK && op.type() != rpc_compound_op::SETATTR)
+		this->creates.revoke(dentry_table_ino);
+	return ret;
+}
+
+int rpc_client::delegate_creates(uuid dentry_table_ino, uint32_t count) {
+	global_logger.log(rpc_client_ops, "Called delegate_creates()");
 	ClientContext context;
-	rpc_truncate_request Input;
-	rpc_common_respond Output;
+	rpc_delegate_creates_request Input;
+	rpc_delegate_creates_respond Output;
 
 	/* prepare Input */
-	Input.set_dentry_table_ino_prefix(ino_controller->get_prefix_from_uuid(i->get_dentry_table_ino()));
-	Input.set_dentry_table_ino_postfix(ino_controller->get_postfix_from_uuid(i->get_dentry_table_ino()));
-	Input.set_filename(i->get_file_name());
-	Input.set_offset(offset);
-	Input.set_target_is_parent(i->get_target_is_parent());
+	Input.set_dentry_table_ino_prefix(ino_controller->get_prefix_from_uuid(dentry_table_ino));
+	Input.set_dentry_table_ino_postfix(ino_controller->get_postfix_from_uuid(dentry_table_ino));
+	Input.set_count(count);
 
-	Status status = stub_->rpc_truncate(&context, Input, &Output);
+	Status status = stub()->rpc_delegate_creates(&context, Input, &Output);
 	if(status.ok()){
-		if(Output.ret() == -ENOTLEADER)
-			return -ENOTLEADER;
-		else if(Output.ret() == 0) {
-			int ret = data_pool->truncate(obj_category::DATA, uuid_to_string(i->get_ino()), offset);
-			return ret;
+		if(Output.ret() == 0) {
+			std::vector<std::string> names(Output.names().begin(), Output.names().end());
+			this->creates.add_delegation(dentry_table_ino, Output.grant_id(), Output.count(), milliseconds(Output.lease_left_ms()), names);
 		}
+
 		return Output.ret();
 	} else {
 		global_logger.log(rpc_client_ops, status.error_message());
-		global_logger.log(rpc_client_ops, "rpc_client::truncate() failed");
+		global_logger.log(rpc_client_ops, "rpc_client::delegate_creates() failed");
 		return -ENEEDRECOV;
 	}
 }
+
+int rpc_client::create_error(uuid dentry_table_ino, uuid ino, bool forget) {
+	this->creates.flush(dentry_table_ino);
+	int err = this->creates.get_error(ino);
+	if (forget)
+		this->creates.forget_error(ino);
+	return err;
+}
@@ -1,12 +1,17 @@
 #ifndef NMFS_RPC_CLIENT_HPP
 #define NMFS_RPC_CLIENT_HPP
 
+#include <atomic>
+#include <chrono>
+
 #include <grpcpp/grpcpp.h>
 #include <rpc.grpc.pb.h>
 #include "../meta/dentry.hpp"
 #include "../meta/remote_inode.hpp"
 #include "../meta/file_handler.hpp"
 #include "../journal/journal.hpp"
+#include "compound_queue.hpp"
+#include "async_creates.hpp"
 
 using grpc::Channel;
 using grpc::ClientContext;
@@ -14,25 +19,59 @@ using grpc::Status;
 using grpc::ClientReader;
 
 using std::shared_ptr;
+using namespace std::chrono;
+
+/* -o rpc_channels when it isn't given */
+#define DEFAULT_RPC_CHANNELS 4
+
+/* A path component resolved by the leader of its parent */
+struct resolved_component {
+	uuid ino;
+	struct stat attr;
+	/* the leader has checked X_OK on this directory */
+	bool searchable;
+	/* how long the lease on the parent lasts */
+	milliseconds lease_left;
+};
 
 class rpc_client {
 private:
-	std::unique_ptr<remote_ops::Stub> stub_;
+	/* one per channel, the calls take them in turn */
+	std::vector<std::unique_ptr<remote_ops::Stub>> stubs;
+	std::atomic<size_t> next_stub;
+	compound_queue compounds;
+	/* Every request on a directory sends the creations queued on it first */
+	async_creates creates;
+
+	remote_ops::Stub *stub();
+	/* Keeps the leader an -ENOTLEADER reply names as a hint, returns -ENOTLEADER */
+	int not_leader(ClientContext &context, uint64_t dentry_table_ino_prefix, uint64_t dentry_table_ino_postfix);
+	template <typename Request>
+	int not_leader(ClientContext &context, const Request &Input) {
+		return not_leader(context, Input.dentry_table_ino_prefix(), Input.dentry_table_ino_postfix());
+	}
+	void open_created(shared_ptr<remote_inode> parent_i, const std::string &new_child_name, uuid new_ino, struct fuse_file_info* file_info);
 
 public:
-	rpc_client(std::shared_ptr<Channel> channel);
+	/* num_channels : connections kept to the leader, see -o rpc_channels */
+	rpc_client(const std::string &remote_address, size_t num_channels);
 
 	/* dentry_table operations */
 	uuid check_child_inode(uuid dentry_table_ino, std::string filename);
+	/* Resolves names under the dentry table as far as the leader leads,
+	   returns 0 or the error (-ENOENT, -ENOTDIR, -EACCES) which stopped it */
+	int resolve_path(uuid dentry_table_ino, const std::vector<std::string> &names, std::vector<resolved_component> &components);
 
 	/* inode operations */
 	mode_t get_mode(uuid dentry_table_ino, std::string filename);
 	void permission_check(uuid dentry_table_ino, std::string filename, int mask, bool target_is_parent);
 	/* file system operations */
-	int getattr(shared_ptr<remote_inode> i, struct stat* s);
+	/* lease_left : how long the leader keeps the lease on the parent */
+	int getattr(uuid dentry_table_ino, const std::string &filename, bool target_is_parent, struct stat* s, milliseconds &lease_left);
 	int access(shared_ptr<remote_inode> i, int mask);
 	int opendir(shared_ptr<remote_inode> i, struct fuse_file_info* file_info);
-	int readdir(shared_ptr<remote_inode> i, void* buffer, fuse_fill_dir_t filler);
+	/* plus : readdirplus, the attributes sent along are also kept in the attr cache */
+	int readdir(shared_ptr<remote_inode> i, void* buffer, fill_dir_t filler, off_t offset = 0, bool plus = false);
 	int mkdir(shared_ptr<remote_inode> parent_i, std::string new_child_name, mode_t mode, std::shared_ptr<inode>& new_dir_inode, std::shared_ptr<dentry>& new_dir_dentry);
 	int rmdir_top(shared_ptr<remote_inode> target_i, uuid target_ino);
 	int rmdir_down(shared_ptr<remote_inode> parent_i, uuid target_ino, std::string target_name);
@@ -44,11 +83,26 @@ public:
 	int open(shared_ptr<remote_inode> i, struct fuse_file_info* file_info);
 	int create(shared_ptr<remote_inode> parent_i, std::string new_child_name, mode_t mode, struct fuse_file_info* file_info);
 	int unlink(shared_ptr<remote_inode> parent_i, std::string child_name);
-	ssize_t write(shared_ptr<remote_inode>i, const char* buffer, size_t size, off_t offset, int flags);
+	/* leader_caches : set to whether the kernel of the leader may keep pages of the file */
+	ssize_t write(shared_ptr<remote_inode>i, const char* buffer, size_t size, off_t offset, int flags, bool *leader_caches = nullptr);
 	int chmod(shared_ptr<remote_inode> i, mode_t mode);
 	int chown(shared_ptr<remote_inode> i, uid_t uid, gid_t gid);
 	int utimens(shared_ptr<remote_inode> i, const struct timespec tv[2]);
 	int truncate(shared_ptr<remote_inode> i, off_t offset);
+	int fallocate(shared_ptr<remote_inode> i, int mode, off_t offset, off_t length);
+
+	/* Runs ops on the children of the dentry table in one rpc_compound,
+	   returns 0 with a result per op, or -ENOTLEADER or -ENEEDRECOV */
+	int compound(uuid dentry_table_ino, const std::vector<rpc_compound_op> &ops, std::vector<rpc_compound_result> &results);
+	/* Runs op with the ops other threads issue on the same directory meanwhile (see compound_queue),
+	   create, mkdir, unlink, symlink, chmod, chown and utimens go through it */
+	int compound_op(uuid dentry_table_ino, const rpc_compound_op &op, rpc_compound_result &result);
+
+	/* Asks for count creations to be delegated on the directory, used by create() with -o async_creates */
+	int delegate_creates(uuid dentry_table_ino, uint32_t count);
+	/* The error of a creation answered under a delegation, once the leader has seen it,
+	   it is kept until forget is given when the file is closed */
+	int create_error(uuid dentry_table_ino, uuid ino, bool forget = false);
 };
 
 
@@ -1,4 +1,11 @@
 #include "rpc_server.hpp"
+#include "dir_scheduler.hpp"
+#include "../in_memory/write_cache.hpp"
+#include "../in_memory/kernel_cache.hpp"
+
+#include <thread>
+#include <vector>
+
 /* TODO : thread cannot read fuse_ctx, so only work with root uid and gid*/
 extern std::shared_ptr<rados_io> meta_pool;
 extern std::shared_ptr<rados_io> data_pool;
@@ -9,14 +16,258 @@ extern std::unique_ptr<Server> remote_handle;
 extern std::unique_ptr<client> this_client;
 
 extern std::unique_ptr<journal> journalctl;
+extern std::unique_ptr<write_back> write_buffers;
+extern std::unique_ptr<kernel_cache> kernel_caches;
+extern std::shared_ptr<lease_client> lc;
+extern struct mount_options nmfs_options;
+
+/* how long the lease of a directory this client leads lasts */
+static uint64_t lease_left_ms(uuid ino) {
+	auto left = duration_cast<milliseconds>(lc->get_due(ino) - system_clock::now()).count();
+	return left > 0 ? left : 0;
+}
+
+/*
+ * The asynchronous server.
+ * Every call is an object tagged to the completion queue it came from; the cq threads only
+ * move the calls along, the handlers run on the workers of a dir_scheduler, queued by the
+ * directory in the request, so a handler waiting on a lock or on the object store holds
+ * a worker but never a cq thread. The handlers which only read a directory run side by side.
+ * Only rpc_readdir gives its worker back midway: the other handlers work on the dentry tables
+ * in memory and reach the object store only for an inode not loaded yet, deep in dentry_table.
+ */
+class async_call {
+public:
+	virtual ~async_call(void) = default;
+	/* Called from a cq thread when the operation tagged with this call completes */
+	virtual void proceed(bool ok) = 0;
+};
+
+struct async_context {
+	remote_ops::AsyncService *service;
+	rpc_server *handlers;
+	dir_scheduler *scheduler;
+	/* the address the other clients reach this one at */
+	std::string self_address;
+};
+
+template <typename Request>
+static uuid request_dir_ino(const Request &request) {
+	return ino_controller->splice_prefix_and_postfix(request.dentry_table_ino_prefix(), request.dentry_table_ino_postfix());
+}
+
+/* A request refused with -ENOTLEADER is pointed to the leader when this client knows it (see leader_hints) */
+static void tell_leader(async_context *actx, ServerContext &ctx, const uuid &dir_ino) {
+	std::string address;
+	if (indexing_table->known_leader(dir_ino, actx->self_address, address))
+		ctx.AddTrailingMetadata(LEADER_METADATA_KEY, address);
+}
+
+template <typename Request, typename Response>
+class unary_call : public async_call {
+public:
+	using request_fn = void (remote_ops::AsyncService::*)(ServerContext *, Request *, grpc::ServerAsyncResponseWriter<Response> *,
+							       grpc::CompletionQueue *, grpc::ServerCompletionQueue *, void *);
+	using handler_fn = Status (rpc_server::*)(ServerContext *, const Request *, Response *);
+
+private:
+	async_context *actx;
+	grpc::ServerCompletionQueue *cq;
+	request_fn request_method;
+	handler_fn handler;
+	bool read_only;
+
+	ServerContext ctx;
+	Request request;
+	Response response;
+	grpc::ServerAsyncResponseWriter<Response> responder;
+	bool requested;
+
+public:
+	unary_call(async_context *actx, grpc::ServerCompletionQueue *cq, request_fn request_method, handler_fn handler, bool read_only)
+		: actx(actx), cq(cq), request_method(request_method), handler(handler), read_only(read_only), responder(&ctx), requested(true) {
+		(actx->service->*request_method)(&ctx, &request, &responder, cq, cq, this);
+	}
+
+	void proceed(bool ok) override {
+		if (!requested || !ok) {
+			/* finished, or the server is shutting down */
+			delete this;
+			return;
+		}
+
+		/* The next call of this method is taken while this one runs */
+		new unary_call(actx, cq, request_method, handler, read_only);
+
+		requested = false;
+		actx->scheduler->submit(request_dir_ino(request), [this](bool cancelled) {
+			if (cancelled) {
+				responder.FinishWithError(Status::CANCELLED, this);
+				return;
+			}
+
+			Status status;
+			try {
+				status = (actx->handlers->*handler)(&ctx, &request, &response);
+			} catch (std::exception &e) {
+				global_logger.log(rpc_server_ops, std::string("rpc handler failed: ") + e.what());
+				status = Status(grpc::StatusCode::INTERNAL, e.what());
+			}
+			if (status.ok() && response.ret() == -ENOTLEADER)
+				tell_leader(actx, ctx, request_dir_ino(request));
+			responder.Finish(response, status, this);
+		}, read_only);
+	}
+};
+
+/* rpc_readdir is written in batches, the worker is given back while a batch is sent */
+class readdir_call : public async_call {
+private:
+	async_context *actx;
+	grpc::ServerCompletionQueue *cq;
+
+	ServerContext ctx;
+	rpc_readdir_request request;
+	rpc_readdir_respond response;
+	grpc::ServerAsyncWriter<rpc_readdir_respond> writer;
+	readdir_cursor cursor;
+	bool more;
+
+	enum {
+		REQUESTED,
+		WRITING,
+		FINISHING,
+	} state;
+
+	void next_batch(void) {
+		actx->scheduler->submit(request_dir_ino(request), [this](bool cancelled) {
+			if (cancelled) {
+				state = FINISHING;
+				writer.Finish(Status::CANCELLED, this);
+				return;
+			}
+
+			response.Clear();
+			try {
+				more = actx->handlers->rpc_readdir(&ctx, &request, cursor, &response);
+			} catch (std::exception &e) {
+				global_logger.log(rpc_server_ops, std::string("rpc handler failed: ") + e.what());
+				state = FINISHING;
+				writer.Finish(Status(grpc::StatusCode::INTERNAL, e.what()), this);
+				return;
+			}
+			if (response.ret() == -ENOTLEADER)
+				tell_leader(actx, ctx, request_dir_ino(request));
+			state = WRITING;
+			writer.Write(response, this);
+		}, true);
+	}
+
+public:
+	readdir_call(async_context *actx, grpc::ServerCompletionQueue *cq)
+		: actx(actx), cq(cq), writer(&ctx), cursor{false, 0}, more(true), state(REQUESTED) {
+		actx->service->Requestrpc_readdir(&ctx, &request, &writer, cq, cq, this);
+	}
+
+	void proceed(bool ok) override {
+		switch (state) {
+		case REQUESTED:
+			if (!ok) {
+				delete this;
+				return;
+			}
+			new readdir_call(actx, cq);
+			next_batch();
+			break;
+		case WRITING:
+			if (!ok) {
+				/* The client has gone or has cancelled the listing */
+				state = FINISHING;
+				writer.Finish(Status::CANCELLED, this);
+			} else if (more) {
+				next_batch();
+			} else {
+				state = FINISHING;
+				writer.Finish(Status::OK, this);
+			}
+			break;
+		case FINISHING:
+			delete this;
+			break;
+		}
+	}
+};
+
+template <typename Request, typename Response>
+static void listen(async_context *actx, grpc::ServerCompletionQueue *cq,
+		   typename unary_call<Request, Response>::request_fn request_method,
+		   typename unary_call<Request, Response>::handler_fn handler, bool read_only = false) {
+	new unary_call<Request, Response>(actx, cq, request_method, handler, read_only);
+}
+
+/* One call of every method is waited for on each completion queue, those given true only read */
+static void listen_all(async_context *actx, grpc::ServerCompletionQueue *cq) {
+	using AS = remote_ops::AsyncService;
+
+	listen<rpc_dentry_table_request, rpc_dentry_table_respond>(actx, cq, &AS::Requestrpc_check_child_inode, &rpc_server::rpc_check_child_inode, true);
+	listen<rpc_resolve_path_request, rpc_resolve_path_respond>(actx, cq, &AS::Requestrpc_resolve_path, &rpc_server::rpc_resolve_path, true);
+	listen<rpc_inode_request, rpc_inode_respond>(actx, cq, &AS::Requestrpc_get_mode, &rpc_server::rpc_get_mode, true);
+	listen<rpc_inode_request, rpc_inode_respond>(actx, cq, &AS::Requestrpc_permission_check, &rpc_server::rpc_permission_check, true);
+	listen<rpc_getattr_request, rpc_getattr_respond>(actx, cq, &AS::Requestrpc_getattr, &rpc_server::rpc_getattr, true);
+	listen<rpc_access_request, rpc_common_respond>(actx, cq, &AS::Requestrpc_access, &rpc_server::rpc_access, true);
+	listen<rpc_open_opendir_request, rpc_common_respond>(actx, cq, &AS::Requestrpc_opendir, &rpc_server::rpc_opendir, true);
+	new readdir_call(actx, cq);
+	listen<rpc_rmdir_request, rpc_common_respond>(actx, cq, &AS::Requestrpc_rmdir_top, &rpc_server::rpc_rmdir_top);
+	listen<rpc_rmdir_request, rpc_common_respond>(actx, cq, &AS::Requestrpc_rmdir_down, &rpc_server::rpc_rmdir_down);
+	listen<rpc_readlink_request, rpc_name_respond>(actx, cq, &AS::Requestrpc_readlink, &rpc_server::rpc_readlink, true);
+	listen<rpc_rename_same_parent_request, rpc_common_respond>(actx, cq, &AS::Requestrpc_rename_same_parent, &rpc_server::rpc_rename_same_parent);
+	listen<rpc_rename_not_same_parent_src_request, rpc_rename_not_same_parent_src_respond>(actx, cq, &AS::Requestrpc_rename_not_same_parent_src, &rpc_server::rpc_rename_not_same_parent_src);
+	listen<rpc_rename_not_same_parent_dst_request, rpc_common_respond>(actx, cq, &AS::Requestrpc_rename_not_same_parent_dst, &rpc_server::rpc_rename_not_same_parent_dst);
+	listen<rpc_open_opendir_request, rpc_open_respond>(actx, cq, &AS::Requestrpc_open, &rpc_server::rpc_open);
+	listen<rpc_write_request, rpc_write_respond>(actx, cq, &AS::Requestrpc_write, &rpc_server::rpc_write);
+	listen<rpc_truncate_request, rpc_truncate_respond>(actx, cq, &AS::Requestrpc_truncate, &rpc_server::rpc_truncate);
+	listen<rpc_fallocate_request, rpc_fallocate_respond>(actx, cq, &AS::Requestrpc_fallocate, &rpc_server::rpc_fallocate);
+	listen<rpc_compound_request, rpc_compound_respond>(actx, cq, &AS::Requestrpc_compound, &rpc_server::rpc_compound);
+	listen<rpc_delegate_creates_request, rpc_delegate_creates_respond>(actx, cq, &AS::Requestrpc_delegate_creates, &rpc_server::rpc_delegate_creates);
+}
+
+static void poll_cq(grpc::ServerCompletionQueue *cq) {
+	void *tag;
+	bool ok;
+	while (cq->Next(&tag, &ok))
+		static_cast<async_call *>(tag)->proceed(ok);
+}
+
 void run_rpc_server(const std::string& remote_address){
-	rpc_server rpc_service;
+	rpc_server handlers;
+	remote_ops::AsyncService rpc_service;
 	ServerBuilder builder;
 	builder.AddListeningPort(remote_address, grpc::InsecureServerCredentials());
 	builder.RegisterService(&rpc_service);
+
+	size_t num_cqs = nmfs_options.rpc_cq_threads > 0 ? nmfs_options.rpc_cq_threads : 1;
+	std::vector<std::unique_ptr<grpc::ServerCompletionQueue>> cqs;
+	for (size_t n = 0; n < num_cqs; n++)
+		cqs.push_back(builder.AddCompletionQueue());
 	remote_handle = builder.BuildAndStart();
 
+	dir_scheduler scheduler(nmfs_options.rpc_workers > 0 ? nmfs_options.rpc_workers : 1);
+	async_context actx{&rpc_service, &handlers, &scheduler, remote_address};
+
+	std::vector<std::thread> cq_threads;
+	for (auto &cq : cqs) {
+		listen_all(&actx, cq.get());
+		cq_threads.emplace_back(poll_cq, cq.get());
+	}
+
 	remote_handle->Wait();
+
+	/* The handlers still queued are cancelled, then the queues are drained */
+	scheduler.stop();
+	for (auto &cq : cqs)
+		cq->Shutdown();
+	for (auto &t : cq_threads)
+		t.join();
 }
 
 Status rpc_server::rpc_check_child_inode(::grpc::ServerContext *context, const ::rpc_dentry_table_request *request,
@@ -44,6 +295,99 @@ Status rpc_server::rpc_check_child_inode(::grpc::ServerContext *context, const :
 	return Status::OK;
 }
 
+Status rpc_server::rpc_resolve_path(::grpc::ServerContext *context, const ::rpc_resolve_path_request *request,
+				    ::rpc_resolve_path_respond *response) {
+	global_logger.log(rpc_server_ops, "Called rpc_resolve_path()");
+	uuid dentry_table_ino = ino_controller->splice_prefix_and_postfix(request->dentry_table_ino_prefix(), request->dentry_table_ino_postfix());
+
+	std::shared_ptr<dentry_table> parent_dentry_table;
+	try {
+		parent_dentry_table = indexing_table->get_dentry_table(dentry_table_ino, true);
+	} catch (dentry_table::not_leader &e){
+		response->set_ret(-ENOTLEADER);
+		return Status::OK;
+	}
+	if (parent_dentry_table->get_loc() != LOCAL) {
+		response->set_ret(-ENOTLEADER);
+		return Status::OK;
+	}
+
+	int ret = 0;
+	uint64_t parent_lease_left_ms = lease_left_ms(dentry_table_ino);
+	for (int n = 0; n < request->names_size(); n++) {
+		const std::string &name = request->names(n);
+
+		uuid check_target_ino{};
+		std::shared_ptr<inode> i;
+		try {
+			std::scoped_lock scl{parent_dentry_table->dentry_table_mutex};
+			check_target_ino = parent_dentry_table->check_child_inode(name);
+			if (check_target_ino.is_nil()) {
+				ret = -ENOENT;
+				break;
+			}
+			i = parent_dentry_table->get_child_inode(name, check_target_ino);
+		} catch (inode::no_entry &e) {
+			ret = -ENOENT;
+			break;
+		}
+
+		rpc_resolved_component *component = response->add_components();
+		mode_t mode;
+		{
+			std::scoped_lock scl{i->inode_mutex};
+			mode = i->get_mode();
+			component->set_i_ino_prefix(ino_controller->get_prefix_from_uuid(check_target_ino));
+			component->set_i_ino_postfix(ino_controller->get_postfix_from_uuid(check_target_ino));
+			component->set_i_mode(mode);
+			component->set_i_uid(i->get_uid());
+			component->set_i_gid(i->get_gid());
+			component->set_i_nlink(i->get_nlink());
+			component->set_i_size(i->get_size());
+			component->set_a_sec(i->get_atime().tv_sec);
+			component->set_a_nsec(i->get_atime().tv_nsec);
+			component->set_m_sec(i->get_mtime().tv_sec);
+			component->set_m_nsec(i->get_mtime().tv_nsec);
+			component->set_c_sec(i->get_ctime().tv_sec);
+			component->set_c_nsec(i->get_ctime().tv_nsec);
+		}
+		component->set_lease_left_ms(parent_lease_left_ms);
+
+		if (!S_ISDIR(mode)) {
+			if (n + 1 < request->names_size())
+				ret = -ENOTDIR;
+			break;
+		}
+
+		/* The rest of the path is resolved by the leader of this directory */
+		std::shared_ptr<dentry_table> child_dentry_table;
+		try {
+			child_dentry_table = indexing_table->get_dentry_table(check_target_ino, true);
+		} catch (dentry_table::not_leader &e) {
+			break;
+		}
+		if (child_dentry_table->get_loc() != LOCAL)
+			break;
+
+		try {
+			std::scoped_lock scl{child_dentry_table->dentry_table_mutex};
+			std::shared_ptr<inode> dir_i = child_dentry_table->get_this_dir_inode();
+			std::scoped_lock scl_i{dir_i->inode_mutex};
+			dir_i->permission_check(X_OK);
+		} catch (inode::permission_denied &e) {
+			ret = -EACCES;
+			break;
+		}
+		component->set_searchable(true);
+
+		parent_dentry_table = child_dentry_table;
+		parent_lease_left_ms = lease_left_ms(check_target_ino);
+	}
+
+	response->set_ret(ret);
+	return Status::OK;
+}
+
 Status rpc_server::rpc_get_mode(::grpc::ServerContext *context, const ::rpc_inode_request *request,
 								::rpc_inode_respond *response) {
 	global_logger.log(rpc_server_ops, "Called rpc_get_mode()");
@@ -155,6 +499,7 @@ Status rpc_server::rpc_getattr(::grpc::ServerContext *context, const ::rpc_getat
 		response->set_c_sec(i->get_ctime().tv_sec);
 		response->set_c_nsec(i->get_ctime().tv_nsec);
 	}
+	response->set_lease_left_ms(lease_left_ms(dentry_table_ino));
 	response->set_ret(0);
 	return Status::OK;
 }
@@ -232,67 +577,79 @@ Status rpc_server::rpc_opendir(::grpc::ServerContext *context, const ::rpc_open_
 	return Status::OK;
 }
 
-Status rpc_server::rpc_readdir(::grpc::ServerContext *context, const ::rpc_readdir_request *request,
-							   ::grpc::ServerWriter<::rpc_name_respond> *writer) {
+/* the attributes of a readdirplus entry */
+static void set_dirent_attr(rpc_dirent *dirent, const std::shared_ptr<inode> &i) {
+	std::scoped_lock scl{i->inode_mutex};
+	dirent->set_has_attr(true);
+	dirent->set_i_mode(i->get_mode());
+	dirent->set_i_uid(i->get_uid());
+	dirent->set_i_gid(i->get_gid());
+	dirent->set_i_ino_prefix(ino_controller->get_prefix_from_uuid(i->get_ino()));
+	dirent->set_i_ino_postfix(ino_controller->get_postfix_from_uuid(i->get_ino()));
+	dirent->set_i_nlink(i->get_nlink());
+	dirent->set_i_size(i->get_size());
+
+	dirent->set_a_sec(i->get_atime().tv_sec);
+	dirent->set_a_nsec(i->get_atime().tv_nsec);
+	dirent->set_m_sec(i->get_mtime().tv_sec);
+	dirent->set_m_nsec(i->get_mtime().tv_nsec);
+	dirent->set_c_sec(i->get_ctime().tv_sec);
+	dirent->set_c_nsec(i->get_ctime().tv_nsec);
+}
+
+bool rpc_server::rpc_readdir(::grpc::ServerContext *context, const ::rpc_readdir_request *request,
+			     readdir_cursor &cursor, ::rpc_readdir_respond *response) {
 	global_logger.log(rpc_server_ops, "Called rpc_readdir()");
-	rpc_name_respond response;
 	uuid dentry_table_ino = ino_controller->splice_prefix_and_postfix(request->dentry_table_ino_prefix(), request->dentry_table_ino_postfix());
 
 	std::shared_ptr<dentry_table> parent_dentry_table;
 	try {
 		parent_dentry_table = indexing_table->get_dentry_table(dentry_table_ino, true);
 	} catch (dentry_table::not_leader &e){
-		response.set_ret(-ENOTLEADER);
-		return Status::OK;
+		response->set_ret(-ENOTLEADER);
+		return false;
 	}
 
-	{
-		std::scoped_lock scl{parent_dentry_table->dentry_table_mutex};
-		std::map<std::string, shared_ptr<inode>>::iterator it;
-		response.set_filename(".");
-		writer->Write(response);
-		response.set_filename("..");
-		writer->Write(response);
-		for (it = parent_dentry_table->get_child_inode_begin(); it != parent_dentry_table->get_child_inode_end(); it++) {
-			response.set_filename(it->first);
-			writer->Write(response);
+	bool plus = request->plus();
+	if (!cursor.started) {
+		cursor.started = true;
+		cursor.offset = request->offset();
+
+		/* "." and ".." take the offsets 1 and 2 */
+		if (cursor.offset < 1) {
+			rpc_dirent *dirent = response->add_entries();
+			dirent->set_filename(".");
+			dirent->set_offset(1);
+			if (plus) {
+				std::scoped_lock scl{parent_dentry_table->dentry_table_mutex};
+				set_dirent_attr(dirent, parent_dentry_table->get_this_dir_inode());
+			}
+		}
+		if (cursor.offset < 2) {
+			rpc_dirent *dirent = response->add_entries();
+			dirent->set_filename("..");
+			dirent->set_offset(2);
 		}
-	}
-	return Status::OK;
-}
-
-Status rpc_server::rpc_mkdir(::grpc::ServerContext *context, const ::rpc_mkdir_request *request,
-							 ::rpc_mkdir_respond *response) {
-	global_logger.log(rpc_server_ops, "Called rpc_mkdir(" + request->new_dir_name() + ")");
-	uuid dentry_table_ino = ino_controller->splice_prefix_and_postfix(request->dentry_table_ino_prefix(), request->dentry_table_ino_postfix());
-
-	std::shared_ptr<dentry_table> parent_dentry_table;
-	try {
-		parent_dentry_table = indexing_table->get_dentry_table(dentry_table_ino, true);
-	} catch (dentry_table::not_leader &e){
-		response->set_ret(-ENOTLEADER);
-		return Status::OK;
 	}
 
+	std::vector<readdir_entry> entries;
+	bool more;
 	{
 		std::scoped_lock scl{parent_dentry_table->dentry_table_mutex};
-		shared_ptr<inode> parent_i = parent_dentry_table->get_this_dir_inode();
-		shared_ptr<inode> i = std::make_shared<inode>(dentry_table_ino, request->uid(), request->gid(), request->new_mode() | S_IFDIR);
-		parent_dentry_table->create_child_inode(request->new_dir_name(), i);
-
-		i->set_size(DIR_INODE_SIZE);
-
-		struct timespec ts{};
-		timespec_get(&ts, TIME_UTC);
-		parent_i->set_mtime(ts);
-		parent_i->set_ctime(ts);
-		journalctl->mkdir(parent_i, request->new_dir_name(), i->get_ino());
+		more = parent_dentry_table->list_children(cursor.offset, READDIR_BATCH, plus, entries);
+	}
 
-		response->set_new_dir_ino_prefix(ino_controller->get_prefix_from_uuid(i->get_ino()));
-		response->set_new_dir_ino_postfix(ino_controller->get_postfix_from_uuid(i->get_ino()));
+	for (auto &e : entries) {
+		rpc_dirent *dirent = response->add_entries();
+		dirent->set_filename(e.name);
+		dirent->set_offset(e.offset);
+		if (e.i != nullptr)
+			set_dirent_attr(dirent, e.i);
+		cursor.offset = e.offset;
 	}
-	response->set_ret(0);
-	return Status::OK;
+
+	response->set_lease_left_ms(lease_left_ms(dentry_table_ino));
+	return more;
 }
 
 Status rpc_server::rpc_rmdir_top(::grpc::ServerContext *context, const ::rpc_rmdir_request *request,
@@ -315,7 +672,7 @@ Status rpc_server::rpc_rmdir_top(::grpc::ServerContext *context, const ::rpc_rmd
 	uuid target_ino = ino_controller->splice_prefix_and_postfix(request->target_ino_prefix(), request->target_ino_postfix());
 	{
 		std::scoped_lock scl{target_dentry_table->dentry_table_mutex};
-		if (target_dentry_table->get_child_num() > 0) {
+		if (!target_dentry_table->is_empty()) {
 			response->set_ret(-ENOTEMPTY);
 			return Status::OK;
 		}
@@ -364,42 +721,6 @@ Status rpc_server::rpc_rmdir_down(::grpc::ServerContext *context, const ::rpc_rm
 }
 
 
-Status rpc_server::rpc_symlink(::grpc::ServerContext *context, const ::rpc_symlink_request *request,
-							   ::rpc_common_respond *response) {
-	global_logger.log(rpc_server_ops, "Called rpc_symlink()");
-	uuid dentry_table_ino = ino_controller->splice_prefix_and_postfix(request->dentry_table_ino_prefix(), request->dentry_table_ino_postfix());
-
-	std::shared_ptr<dentry_table> dst_parent_dentry_table;
-	try {
-		dst_parent_dentry_table = indexing_table->get_dentry_table(dentry_table_ino, true);
-	} catch (dentry_table::not_leader &e){
-		response->set_ret(-ENOTLEADER);
-		return Status::OK;
-	}
-
-	std::unique_ptr<std::string> symlink_name = get_filename_from_path(request->dst());
-	{
-		std::scoped_lock scl{dst_parent_dentry_table->dentry_table_mutex};
-		if (!dst_parent_dentry_table->check_child_inode(*symlink_name).is_nil()) {
-			response->set_ret(-EEXIST);
-			return Status::OK;
-		}
-
-		shared_ptr<inode> dst_parent_i = dst_parent_dentry_table->get_this_dir_inode();
-		shared_ptr<inode> symlink_i = std::make_shared<inode>(dentry_table_ino, this_client->get_client_uid(), this_client->get_client_gid(), S_IFLNK | 0777, request->src().c_str());
-
-		symlink_i->set_size(static_cast<off_t>(request->src().length()));
-
-		dst_parent_dentry_table->create_child_inode(*symlink_name, symlink_i);
-
-		struct timespec ts{};
-		timespec_get(&ts, TIME_UTC);
-		journalctl->mkreg(dst_parent_i, *symlink_name, symlink_i);
-	}
-	response->set_ret(0);
-	return Status::OK;
-}
-
 Status rpc_server::rpc_readlink(::grpc::ServerContext *context, const ::rpc_readlink_request *request,
 								::rpc_name_respond *response) {
 	global_logger.log(rpc_server_ops, "Called rpc_readlink()");
@@ -462,13 +783,18 @@ Status rpc_server::rpc_rename_same_parent(::grpc::ServerContext *context, const
 		if (request->flags() == 0) {
 			if (!check_dst_ino.is_nil()) {
 				std::shared_ptr<inode> check_dst_inode = parent_dentry_table->get_child_inode(*new_name);
+				kernel_caches->invalidate(check_dst_inode->get_ino());
+				kernel_caches->invalidate_entry(dentry_table_ino, *new_name);
 				parent_dentry_table->delete_child_inode(*new_name);
 				journalctl->rmreg(parent_i, *new_name, check_dst_inode);
 			}
 			parent_dentry_table->delete_child_inode(*old_name);
 			journalctl->rmreg(parent_i, *old_name, target_i);
+			kernel_caches->invalidate(target_i->get_ino());
+			kernel_caches->invalidate_entry(dentry_table_ino, *old_name);
 			parent_dentry_table->create_child_inode(*new_name, target_i);
 			journalctl->mkreg(parent_i, *new_name, target_i);
+			revoke_create_grants(dentry_table_ino);
 
 		} else {
 			response->set_ret(-ENOSYS);
@@ -508,6 +834,8 @@ Status rpc_server::rpc_rename_not_same_parent_src(::grpc::ServerContext *context
 		if (request->flags() == 0) {
 			src_dentry_table->delete_child_inode(*old_name);
 			journalctl->rmreg(src_parent_i, *old_name, target_i);
+			kernel_caches->invalidate(target_i->get_ino());
+			kernel_caches->invalidate_entry(dentry_table_ino, *old_name);
 		} else {
 			response->set_ret(-ENOSYS);
 			return Status::OK;
@@ -546,11 +874,14 @@ Status rpc_server::rpc_rename_not_same_parent_dst(::grpc::ServerContext *context
 		if (request->flags() == 0) {
 			if (!check_dst_ino.is_nil()) {
 				std::shared_ptr<inode> check_dst_inode = dst_dentry_table->get_child_inode(*new_name);
+				kernel_caches->invalidate(check_dst_inode->get_ino());
+				kernel_caches->invalidate_entry(dentry_table_ino, *new_name);
 				dst_dentry_table->delete_child_inode(*new_name);
 				journalctl->rmreg(dst_parent_i, *new_name, check_dst_inode);
 			}
 			dst_dentry_table->create_child_inode(*new_name, target_inode);
 			journalctl->mkreg(dst_parent_i, *new_name, target_inode);
+			revoke_create_grants(dentry_table_ino);
 		} else {
 			response->set_ret(-ENOSYS);
 			return Status::OK;
@@ -562,7 +893,7 @@ Status rpc_server::rpc_rename_not_same_parent_dst(::grpc::ServerContext *context
 
 
 Status rpc_server::rpc_open(::grpc::ServerContext *context, const ::rpc_open_opendir_request *request,
-							::rpc_common_respond *response) {
+							::rpc_open_respond *response) {
 	global_logger.log(rpc_server_ops, "Called rpc_open()");
 	uuid dentry_table_ino = ino_controller->splice_prefix_and_postfix(request->dentry_table_ino_prefix(), request->dentry_table_ino_postfix());
 
@@ -580,6 +911,13 @@ Status rpc_server::rpc_open(::grpc::ServerContext *context, const ::rpc_open_ope
 		i = parent_dentry_table->get_child_inode(request->filename());
 	}
 
+	/* Another client opening the file reads what was written here from the data pool */
+	int flush_ret = write_buffers->flush(i->get_ino());
+	if (flush_ret != 0) {
+		response->set_ret(flush_ret);
+		return Status::OK;
+	}
+
 	{
 		std::scoped_lock scl{i->inode_mutex};
 		if ((request->flags() & O_DIRECTORY) && !S_ISDIR(i->get_mode())) {
@@ -594,80 +932,11 @@ Status rpc_server::rpc_open(::grpc::ServerContext *context, const ::rpc_open_ope
 
 		if ((request->flags() & O_TRUNC) && !(request->flags() & O_PATH)) {
 			i->set_size(0);
+			i->bump_data_version();
+			kernel_caches->invalidate(i->get_ino());
 			journalctl->chreg(i->get_p_ino(), i);
 		}
-	}
-	response->set_ret(0);
-	return Status::OK;
-}
-
-Status rpc_server::rpc_create(::grpc::ServerContext *context, const ::rpc_create_request *request,
-							  ::rpc_create_respond *response) {
-	global_logger.log(rpc_server_ops, "Called rpc_create(" + request->new_file_name() + ")");
-	uuid dentry_table_ino = ino_controller->splice_prefix_and_postfix(request->dentry_table_ino_prefix(), request->dentry_table_ino_postfix());
-
-	std::shared_ptr<dentry_table> parent_dentry_table;
-	try {
-		parent_dentry_table = indexing_table->get_dentry_table(dentry_table_ino, true);
-	} catch (dentry_table::not_leader &e){
-		response->set_ret(-ENOTLEADER);
-		return Status::OK;
-	}
-
-	{
-		std::scoped_lock scl{parent_dentry_table->dentry_table_mutex};
-		shared_ptr<inode> parent_i = parent_dentry_table->get_this_dir_inode();
-		shared_ptr<inode> i = std::make_shared<inode>(dentry_table_ino, this_client->get_client_uid(), this_client->get_client_gid(), request->new_mode() | S_IFREG);
-		parent_dentry_table->create_child_inode(request->new_file_name(), i);
-
-		struct timespec ts{};
-		timespec_get(&ts, TIME_UTC);
-		parent_i->set_mtime(ts);
-		parent_i->set_ctime(ts);
-		journalctl->mkreg(parent_i, request->new_file_name(), i);
-
-		response->set_new_ino_prefix(ino_controller->get_prefix_from_uuid(i->get_ino()));
-		response->set_new_ino_postfix(ino_controller->get_postfix_from_uuid(i->get_ino()));
-	}
-	response->set_ret(0);
-	return Status::OK;
-}
-
-Status rpc_server::rpc_unlink(::grpc::ServerContext *context, const ::rpc_unlink_request *request,
-							  ::rpc_common_respond *response) {
-	global_logger.log(rpc_server_ops, "Called rpc_unlink(" + request->filename() + ")");
-	uuid dentry_table_ino = ino_controller->splice_prefix_and_postfix(request->dentry_table_ino_prefix(), request->dentry_table_ino_postfix());
-
-	std::shared_ptr<dentry_table> parent_dentry_table;
-	try {
-		parent_dentry_table = indexing_table->get_dentry_table(dentry_table_ino, true);
-	} catch (dentry_table::not_leader &e){
-		response->set_ret(-ENOTLEADER);
-		return Status::OK;
-	}
-
-	{
-		std::scoped_lock scl{parent_dentry_table->dentry_table_mutex};
-		shared_ptr<inode> parent_i = parent_dentry_table->get_this_dir_inode();
-		std::shared_ptr<inode> target_i = parent_dentry_table->get_child_inode(request->filename());
-		nlink_t nlink = target_i->get_nlink() - 1;
-		if (nlink == 0) {
-			uuid target_ino = target_i->get_ino();
-			/* data */
-			data_pool->remove(obj_category::DATA, uuid_to_string(target_ino));
-
-			/* parent dentry */
-			parent_dentry_table->delete_child_inode(request->filename());
-
-			struct timespec ts{};
-			timespec_get(&ts, TIME_UTC);
-			parent_i->set_mtime(ts);
-			parent_i->set_ctime(ts);
-			journalctl->rmreg(parent_i, request->filename(), target_i);
-		} else {
-			target_i->set_nlink(nlink);
-			journalctl->chreg(target_i->get_p_ino(), target_i);
-		}
+		response->set_i_size(i->get_size());
 	}
 	response->set_ret(0);
 	return Status::OK;
@@ -697,6 +966,11 @@ Status rpc_server::rpc_write(::grpc::ServerContext *context, const ::rpc_write_r
 		if (request->flags() & O_APPEND) {
 			offset = i->get_size();
 		}
+		/* The read-ahead and kernel pages of this client are dropped. The writer sends the data right after,
+		   and an empty rpc_write once it has landed if the kernel may have read the old data meanwhile. */
+		i->bump_data_version();
+		kernel_caches->invalidate(i->get_ino());
+		response->set_cached(kernel_caches->may_cache(i->get_ino()));
 
 		if (i->get_size() < offset + size) {
 			i->set_size(offset + size);
@@ -710,9 +984,9 @@ Status rpc_server::rpc_write(::grpc::ServerContext *context, const ::rpc_write_r
 	return Status::OK;
 }
 
-Status rpc_server::rpc_chmod(::grpc::ServerContext *context, const ::rpc_chmod_request *request,
-							 ::rpc_common_respond *response) {
-	global_logger.log(rpc_server_ops, "Called rpc_chmod(" + request->filename() + ")");
+Status rpc_server::rpc_truncate(::grpc::ServerContext *context, const ::rpc_truncate_request *request,
+								::rpc_truncate_respond *response) {
+	global_logger.log(rpc_server_ops, "Called rpc_truncate()");
 	uuid dentry_table_ino = ino_controller->splice_prefix_and_postfix(request->dentry_table_ino_prefix(), request->dentry_table_ino_postfix());
 
 	std::shared_ptr<dentry_table> parent_dentry_table;
@@ -737,9 +1011,15 @@ Status rpc_server::rpc_chmod(::grpc::ServerContext *context, const ::rpc_chmod_r
 
 	{
 		std::scoped_lock scl{i->inode_mutex};
-		mode_t type = i->get_mode() & S_IFMT;
+		if (S_ISDIR(i->get_mode())) {
+			response->set_ret(-EISDIR);
+			return Status::OK;
+		}
 
-		i->set_mode(request->mode() | type);
+		response->set_file_size(i->get_size());
+		i->set_size(request->offset());
+		i->bump_data_version();
+		kernel_caches->invalidate(i->get_ino());
 
 		if(S_ISDIR(i->get_mode()))
 			journalctl->chself(i);
@@ -750,9 +1030,9 @@ Status rpc_server::rpc_chmod(::grpc::ServerContext *context, const ::rpc_chmod_r
 	return Status::OK;
 }
 
-Status rpc_server::rpc_chown(::grpc::ServerContext *context, const ::rpc_chown_request *request,
-							 ::rpc_common_respond *response) {
-	global_logger.log(rpc_server_ops, "Called rpc_chown(" + request->filename() + ")");
+Status rpc_server::rpc_fallocate(::grpc::ServerContext *context, const ::rpc_fallocate_request *request,
+								 ::rpc_fallocate_respond *response) {
+	global_logger.log(rpc_server_ops, "Called rpc_fallocate()");
 	uuid dentry_table_ino = ino_controller->splice_prefix_and_postfix(request->dentry_table_ino_prefix(), request->dentry_table_ino_postfix());
 
 	std::shared_ptr<dentry_table> parent_dentry_table;
@@ -766,99 +1046,214 @@ Status rpc_server::rpc_chown(::grpc::ServerContext *context, const ::rpc_chown_r
 	std::shared_ptr<inode> i;
 	{
 		std::scoped_lock scl{parent_dentry_table->dentry_table_mutex};
-		if (request->target_is_parent()) {
-			global_logger.log(rpc_server_ops, "target is parent");
-			i = parent_dentry_table->get_this_dir_inode();
-		} else {
-			global_logger.log(rpc_server_ops, "target is child");
-			i = parent_dentry_table->get_child_inode(request->filename());
-		}
+		i = parent_dentry_table->get_child_inode(request->filename());
 	}
 
 	{
 		std::scoped_lock scl{i->inode_mutex};
-		if (((int32_t) request->uid()) >= 0)
-			i->set_uid(request->uid());
+		if (S_ISDIR(i->get_mode())) {
+			response->set_ret(-EISDIR);
+			return Status::OK;
+		}
 
-		if (((int32_t) request->gid()) >= 0)
-			i->set_gid(request->gid());
+		/* The client punches the hole in the data pool by itself */
+		response->set_file_size(i->get_size());
+		i->bump_data_version();
+		kernel_caches->invalidate(i->get_ino());
+
+		if (!(request->mode() & FALLOC_FL_KEEP_SIZE) && i->get_size() < request->offset() + request->length()) {
+			i->set_size(request->offset() + request->length());
+			struct timespec ts{};
+			timespec_get(&ts, TIME_UTC);
+			i->set_ctime(ts);
 
-		if(S_ISDIR(i->get_mode()))
-			journalctl->chself(i);
-		else
 			journalctl->chreg(i->get_p_ino(), i);
+		}
 	}
 	response->set_ret(0);
 	return Status::OK;
 }
 
-Status rpc_server::rpc_utimens(::grpc::ServerContext *context, const ::rpc_utimens_request *request,
-							   ::rpc_common_respond *response) {
-	global_logger.log(rpc_server_ops, "Called rpc_utimens(" + request->filename() + ")");
-	uuid dentry_table_ino = ino_controller->splice_prefix_and_postfix(request->dentry_table_ino_prefix(), request->dentry_table_ino_postfix());
-
-	std::shared_ptr<dentry_table> parent_dentry_table;
-	try {
-		parent_dentry_table = indexing_table->get_dentry_table(dentry_table_ino, true);
-	} catch (dentry_table::not_leader &e){
-		response->set_ret(-ENOTLEADER);
-		return Status::OK;
+/* Creations delegated to other clients, they last as long as the lease on the directory did when given */
+struct create_grant {
+	uuid dir_ino;
+	uint32_t left;
+	system_clock::time_point due;
+};
+
+static std::mutex grants_mutex;
+static tsl::robin_map<uint64_t, create_grant> create_grants;
+static uint64_t next_grant_id = 1;
+
+/* Takes a creation of the grant, false if it is unknown, spent or expired */
+static bool take_create_grant(uint64_t grant_id, const uuid &dir_ino) {
+	std::scoped_lock lock{grants_mutex};
+	auto it = create_grants.find(grant_id);
+	if (it == create_grants.end() || it->second.dir_ino != dir_ino)
+		return false;
+
+	if (it->second.due < system_clock::now()) {
+		create_grants.erase(it);
+		return false;
 	}
 
-	std::shared_ptr<inode> i;
-	{
-		std::scoped_lock scl{parent_dentry_table->dentry_table_mutex};
-		if (request->target_is_parent()) {
-			global_logger.log(rpc_server_ops, "target is parent");
-			i = parent_dentry_table->get_this_dir_inode();
+	if (--it.value().left == 0)
+		create_grants.erase(it);
+	return true;
+}
+
+void revoke_create_grants(const uuid &dir_ino, uint64_t keep_grant_id) {
+	std::scoped_lock lock{grants_mutex};
+	for (auto it = create_grants.begin(); it != create_grants.end();) {
+		if (it->second.dir_ino == dir_ino && it->first != keep_grant_id) {
+			global_logger.log(rpc_server_ops, "create grant " + std::to_string(it->first) + " is revoked");
+			it = create_grants.erase(it);
 		} else {
-			global_logger.log(rpc_server_ops, "target is child");
-			i = parent_dentry_table->get_child_inode(request->filename());
+			++it;
 		}
 	}
+}
 
-	{
-		std::scoped_lock scl{i->inode_mutex};
-		if (request->a_nsec() == UTIME_NOW) {
-			struct timespec ts{};
-			if (!timespec_get(&ts, TIME_UTC))
-				throw runtime_error("timespec_get() failed");
-			i->set_atime(ts);
-		} else if (request->a_nsec() == UTIME_OMIT) { ;
+static void set_new_ino(rpc_compound_result *result, const uuid &ino) {
+	result->set_new_ino_prefix(ino_controller->get_prefix_from_uuid(ino));
+	result->set_new_ino_postfix(ino_controller->get_postfix_from_uuid(ino));
+}
+
+static void touch_parent(const shared_ptr<inode> &parent_i) {
+	struct timespec ts{};
+	timespec_get(&ts, TIME_UTC);
+	parent_i->set_mtime(ts);
+	parent_i->set_ctime(ts);
+}
+
+static void set_times(const shared_ptr<inode> &i, const rpc_compound_op &op) {
+	struct timespec ts{};
+	if (!timespec_get(&ts, TIME_UTC))
+		throw runtime_error("timespec_get() failed");
+
+	if (op.a_nsec() == UTIME_NOW)
+		i->set_atime(ts);
+	else if (op.a_nsec() != UTIME_OMIT)
+		i->set_atime(timespec{op.a_sec(), op.a_nsec()});
+
+	if (op.m_nsec() == UTIME_NOW)
+		i->set_mtime(ts);
+	else if (op.m_nsec() != UTIME_OMIT)
+		i->set_mtime(timespec{op.m_sec(), op.m_nsec()});
+}
+
+/* One operation of rpc_compound, dentry_table_mutex is held */
+static int run_compound_op(const std::shared_ptr<dentry_table> &parent_dentry_table, journal::batch &jb,
+			   const rpc_compound_op &op, rpc_compound_result *result) {
+	uuid dentry_table_ino = parent_dentry_table->get_dir_ino();
+	shared_ptr<inode> parent_i = parent_dentry_table->get_this_dir_inode();
+
+	switch (op.type()) {
+	case rpc_compound_op::CREATE:
+	case rpc_compound_op::MKDIR:
+	case rpc_compound_op::SYMLINK: {
+		if (op.grant_id() != 0 && (op.type() != rpc_compound_op::CREATE || !take_create_grant(op.grant_id(), dentry_table_ino)))
+			return -ESTALE;
+
+		if (!parent_dentry_table->check_child_inode(op.filename()).is_nil())
+			return -EEXIST;
+		revoke_create_grants(dentry_table_ino, op.grant_id());
+
+		/* A delegated creation is sent again without its grant when the grant is gone, with the same ino */
+		shared_ptr<inode> i;
+		if (op.type() == rpc_compound_op::CREATE && (op.ino_prefix() != 0 || op.ino_postfix() != 0)) {
+			uuid new_ino = ino_controller->splice_prefix_and_postfix(op.ino_prefix(), op.ino_postfix());
+			i = std::make_shared<inode>(dentry_table_ino, op.uid(), op.gid(), op.mode() | S_IFREG, new_ino);
+		} else if (op.type() == rpc_compound_op::CREATE) {
+			i = std::make_shared<inode>(dentry_table_ino, op.uid(), op.gid(), op.mode() | S_IFREG);
+		} else if (op.type() == rpc_compound_op::MKDIR) {
+			i = std::make_shared<inode>(dentry_table_ino, op.uid(), op.gid(), op.mode() | S_IFDIR);
+			i->set_size(DIR_INODE_SIZE);
 		} else {
-			struct timespec tv{};
-			tv.tv_sec = request->a_sec();
-			tv.tv_nsec = request->a_nsec();
-			i->set_atime(tv);
+			i = std::make_shared<inode>(dentry_table_ino, op.uid(), op.gid(), S_IFLNK | 0777, op.link_target().c_str());
+			i->set_size(static_cast<off_t>(op.link_target().length()));
 		}
+		parent_dentry_table->create_child_inode(op.filename(), i);
 
-		if (request->m_nsec() == UTIME_NOW) {
-			struct timespec ts{};
-			if (!timespec_get(&ts, TIME_UTC))
-				throw runtime_error("timespec_get() failed");
-			i->set_mtime(ts);
-		} else if (request->m_nsec() == UTIME_OMIT) { ;
+		touch_parent(parent_i);
+		if (op.type() == rpc_compound_op::MKDIR)
+			jb.mkdir(parent_i, op.filename(), i->get_ino());
+		else
+			jb.mkreg(parent_i, op.filename(), i);
+
+		set_new_ino(result, i->get_ino());
+		return 0;
+	}
+	case rpc_compound_op::UNLINK: {
+		if (parent_dentry_table->check_child_inode(op.filename()).is_nil())
+			return -ENOENT;
+
+		std::shared_ptr<inode> target_i = parent_dentry_table->get_child_inode(op.filename());
+		if (S_ISDIR(target_i->get_mode()))
+			return -EISDIR;
+		kernel_caches->invalidate(target_i->get_ino());
+		kernel_caches->invalidate_entry(dentry_table_ino, op.filename());
+
+		nlink_t nlink = target_i->get_nlink() - 1;
+		if (nlink == 0) {
+			data_pool->remove(obj_category::DATA, uuid_to_string(target_i->get_ino()), target_i->get_size());
+			parent_dentry_table->delete_child_inode(op.filename());
+
+			touch_parent(parent_i);
+			jb.rmreg(parent_i, op.filename(), target_i);
+		} else {
+			target_i->set_nlink(nlink);
+			jb.chreg(target_i);
+		}
+		return 0;
+	}
+	case rpc_compound_op::SETATTR: {
+		std::shared_ptr<inode> i;
+		if (op.target_is_parent()) {
+			i = parent_i;
 		} else {
-			struct timespec tv{};
-			tv.tv_sec = request->m_sec();
-			tv.tv_nsec = request->m_nsec();
-			i->set_mtime(tv);
+			if (parent_dentry_table->check_child_inode(op.filename()).is_nil())
+				return -ENOENT;
+			i = parent_dentry_table->get_child_inode(op.filename());
 		}
 
-		if(S_ISDIR(i->get_mode()))
+		kernel_caches->invalidate(i->get_ino());
+		std::scoped_lock scl{i->inode_mutex};
+		if (op.set_mode())
+			i->set_mode(op.mode() | (i->get_mode() & S_IFMT));
+		if (op.set_owner()) {
+			if (((int32_t) op.new_uid()) >= 0)
+				i->set_uid(op.new_uid());
+			if (((int32_t) op.new_gid()) >= 0)
+				i->set_gid(op.new_gid());
+		}
+		if (op.set_times())
+			set_times(i, op);
+
+		if (op.target_is_parent())
+			jb.chself(i);
+		else if (S_ISDIR(i->get_mode()))
+			/* A child directory is journaled with its own entries */
 			journalctl->chself(i);
 		else
-			journalctl->chreg(i->get_p_ino(), i);
+			jb.chreg(i);
+		return 0;
+	}
+	default:
+		return -EINVAL;
 	}
-	response->set_ret(0);
-	return Status::OK;
 }
 
-Status rpc_server::rpc_truncate(::grpc::ServerContext *context, const ::rpc_truncate_request *request,
-								::rpc_common_respond *response) {
-	global_logger.log(rpc_server_ops, "Called rpc_truncate()");
+Status rpc_server::rpc_compound(::grpc::ServerContext *context, const ::rpc_compound_request *request,
+				::rpc_compound_respond *response) {
+	global_logger.log(rpc_server_ops, "Called rpc_compound(" + std::to_string(request->ops_size()) + ")");
 	uuid dentry_table_ino = ino_controller->splice_prefix_and_postfix(request->dentry_table_ino_prefix(), request->dentry_table_ino_postfix());
 
+	if (request->ops_size() > COMPOUND_MAX_OPS) {
+		response->set_ret(-E2BIG);
+		return Status::OK;
+	}
+
 	std::shared_ptr<dentry_table> parent_dentry_table;
 	try {
 		parent_dentry_table = indexing_table->get_dentry_table(dentry_table_ino, true);
@@ -867,32 +1262,66 @@ Status rpc_server::rpc_truncate(::grpc::ServerContext *context, const ::rpc_trun
 		return Status::OK;
 	}
 
-	std::shared_ptr<inode> i;
 	{
 		std::scoped_lock scl{parent_dentry_table->dentry_table_mutex};
-		if (request->target_is_parent()) {
-			global_logger.log(rpc_server_ops, "target is parent");
-			i = parent_dentry_table->get_this_dir_inode();
-		} else {
-			global_logger.log(rpc_server_ops, "target is child");
-			i = parent_dentry_table->get_child_inode(request->filename());
+		journal::batch jb(*journalctl, dentry_table_ino);
+		for (const rpc_compound_op &op : request->ops()) {
+			rpc_compound_result *result = response->add_results();
+			result->set_ret(run_compound_op(parent_dentry_table, jb, op, result));
 		}
 	}
+	response->set_ret(0);
+	return Status::OK;
+}
+
+Status rpc_server::rpc_delegate_creates(::grpc::ServerContext *context, const ::rpc_delegate_creates_request *request,
+					::rpc_delegate_creates_respond *response) {
+	global_logger.log(rpc_server_ops, "Called rpc_delegate_creates()");
+	uuid dentry_table_ino = ino_controller->splice_prefix_and_postfix(request->dentry_table_ino_prefix(), request->dentry_table_ino_postfix());
+
+	std::shared_ptr<dentry_table> parent_dentry_table;
+	try {
+		parent_dentry_table = indexing_table->get_dentry_table(dentry_table_ino, true);
+	} catch (dentry_table::not_leader &e){
+		response->set_ret(-ENOTLEADER);
+		return Status::OK;
+	}
+
+	uint64_t left_ms = lease_left_ms(dentry_table_ino);
+	if (left_ms < CREATE_GRANT_MIN_LEASE_MS || request->count() == 0) {
+		response->set_ret(-EAGAIN);
+		return Status::OK;
+	}
+
+	uint32_t count = std::min<uint32_t>(request->count(), CREATE_GRANT_MAX);
+	system_clock::time_point now = system_clock::now();
+
+	/* The names are those of the grant as long as it isn't revoked, no name can be added without the lock */
+	std::scoped_lock scl{parent_dentry_table->dentry_table_mutex};
+	if (parent_dentry_table->count_upto(CREATE_GRANT_MAX_NAMES + 1) > CREATE_GRANT_MAX_NAMES) {
+		response->set_ret(-EAGAIN);
+		return Status::OK;
+	}
+	parent_dentry_table->for_each_child([response](const std::string &name, const uuid &ino) {
+		response->add_names(name);
+	});
 
 	{
-		std::scoped_lock scl{i->inode_mutex};
-		if (S_ISDIR(i->get_mode())) {
-			response->set_ret(-EISDIR);
-			return Status::OK;
+		std::scoped_lock lock{grants_mutex};
+		/* The expired grants go here, the spent ones are gone already */
+		for (auto it = create_grants.begin(); it != create_grants.end();) {
+			if (it->second.due < now)
+				it = create_grants.erase(it);
+			else
+				++it;
 		}
 
-		i->set_size(request->offset());
-
-		if(S_ISDIR(i->get_mode()))
-			journalctl->chself(i);
-		else
-			journalctl->chreg(i->get_p_ino(), i);
+		uint64_t grant_id = next_grant_id++;
+		create_grants.insert({grant_id, create_grant{dentry_table_ino, count, now + milliseconds(left_ms)}});
+		response->set_grant_id(grant_id);
 	}
+	response->set_count(count);
+	response->set_lease_left_ms(left_ms);
 	response->set_ret(0);
 	return Status::OK;
 }
@@ -11,80 +11,101 @@ using grpc::ServerBuilder;
 using grpc::ServerContext;
 using grpc::Status;
 
+/* -o rpc_cq_threads and -o rpc_workers when they aren't given */
+#define DEFAULT_RPC_CQ_THREADS 2
+#define DEFAULT_RPC_WORKERS 8
+
+/* Creations given by one rpc_delegate_creates at most */
+#define CREATE_GRANT_MAX 1024
+/* No creations are delegated on a directory whose lease ends sooner than this */
+#define CREATE_GRANT_MIN_LEASE_MS 200
+/* Nor on one with more names than this, the names go with the grant */
+#define CREATE_GRANT_MAX_NAMES 4096
+
+/* Serves until remote_handle is shut down */
 void run_rpc_server(const std::string& remote_address);
 
-class rpc_server : public remote_ops::Service {
+/*
+ * Called when a name is added to a directory this client leads, other than under keep_grant_id.
+ * The creations delegated on it are taken back, the names their holders were given are out of date.
+ */
+void revoke_create_grants(const uuid &dir_ino, uint64_t keep_grant_id = 0);
+
+/* Where a listing continues in the next batch of rpc_readdir */
+struct readdir_cursor {
+	bool started;
+	off_t offset;
+};
+
+/*
+ * The handlers of remote_ops.
+ * They are called from the workers of the asynchronous server in rpc_server.cpp,
+ * queued by the directory in the request.
+ */
+class rpc_server {
 public:
     Status rpc_check_child_inode(::grpc::ServerContext *context, const ::rpc_dentry_table_request *request,
-				 ::rpc_dentry_table_respond *response) override;
+				 ::rpc_dentry_table_respond *response);
+
+    Status rpc_resolve_path(::grpc::ServerContext *context, const ::rpc_resolve_path_request *request,
+			    ::rpc_resolve_path_respond *response);
 
     Status rpc_get_mode(::grpc::ServerContext *context, const ::rpc_inode_request *request,
-			::rpc_inode_respond *response) override;
+			::rpc_inode_respond *response);
 
     Status rpc_permission_check(::grpc::ServerContext *context, const ::rpc_inode_request *request,
-				::rpc_inode_respond *response) override;
+				::rpc_inode_respond *response);
 
     Status rpc_getattr(::grpc::ServerContext *context, const ::rpc_getattr_request *request,
-		       ::rpc_getattr_respond *response) override;
+		       ::rpc_getattr_respond *response);
 
     Status rpc_access(::grpc::ServerContext *context, const ::rpc_access_request *request,
-		      ::rpc_common_respond *response) override;
+		      ::rpc_common_respond *response);
 
     Status rpc_opendir(::grpc::ServerContext *context, const ::rpc_open_opendir_request *request,
-		       ::rpc_common_respond *response) override;
-
-    Status rpc_readdir(::grpc::ServerContext *context, const ::rpc_readdir_request *request,
-		       ::grpc::ServerWriter<::rpc_name_respond> *writer) override;
+		       ::rpc_common_respond *response);
 
-    Status rpc_mkdir(::grpc::ServerContext *context, const ::rpc_mkdir_request *request,
-		     ::rpc_mkdir_respond *response) override;
+    /* One batch of a listing, returns whether there are more */
+    bool rpc_readdir(::grpc::ServerContext *context, const ::rpc_readdir_request *request,
+		     readdir_cursor &cursor, ::rpc_readdir_respond *response);
 
     Status rpc_rmdir_top(::grpc::ServerContext *context, const ::rpc_rmdir_request *request,
-		     ::rpc_common_respond *response) override;
+		     ::rpc_common_respond *response);
 
     Status rpc_rmdir_down(::grpc::ServerContext *context, const ::rpc_rmdir_request *request,
-		     ::rpc_common_respond *response) override;
-
-    Status rpc_symlink(::grpc::ServerContext *context, const ::rpc_symlink_request *request,
-		       ::rpc_common_respond *response) override;
+		     ::rpc_common_respond *response);
 
     Status rpc_readlink(::grpc::ServerContext *context, const ::rpc_readlink_request *request,
-			::rpc_name_respond *response) override;
+			::rpc_name_respond *response);
 
     Status rpc_rename_same_parent(::grpc::ServerContext *context, const ::rpc_rename_same_parent_request *request,
-				  ::rpc_common_respond *response) override;
+				  ::rpc_common_respond *response);
 
     Status rpc_rename_not_same_parent_src(::grpc::ServerContext *context, const ::rpc_rename_not_same_parent_src_request *request,
-				      ::rpc_rename_not_same_parent_src_respond *response) override;
+				      ::rpc_rename_not_same_parent_src_respond *response);
 
     Status rpc_rename_not_same_parent_dst(::grpc::ServerContext *context, const ::rpc_rename_not_same_parent_dst_request *request,
-					  ::rpc_common_respond *response) override;
+					  ::rpc_common_respond *response);
 
     Status rpc_open(::grpc::ServerContext *context, const ::rpc_open_opendir_request *request,
-		    ::rpc_common_respond *response) override;
-
-    Status rpc_create(::grpc::ServerContext *context, const ::rpc_create_request *request,
-		      ::rpc_create_respond *response) override;
-
-    Status rpc_unlink(::grpc::ServerContext *context, const ::rpc_unlink_request *request,
-		      ::rpc_common_respond *response) override;
+		    ::rpc_open_respond *response);
 
     Status rpc_write(::grpc::ServerContext *context, const ::rpc_write_request *request,
-		     ::rpc_write_respond *response) override;
+		     ::rpc_write_respond *response);
 
-    Status rpc_chmod(::grpc::ServerContext *context, const ::rpc_chmod_request *request,
-		     ::rpc_common_respond *response) override;
+    Status rpc_truncate(::grpc::ServerContext *context, const ::rpc_truncate_request *request,
+			::rpc_truncate_respond *response);
 
-    Status rpc_chown(::grpc::ServerContext *context, const ::rpc_chown_request *request,
-		     ::rpc_common_respond *response) override;
+    Status rpc_fallocate(::grpc::ServerContext *context, const ::rpc_fallocate_request *request,
+			 ::rpc_fallocate_respond *response);
 
-    Status rpc_utimens(::grpc::ServerContext *context, const ::rpc_utimens_request *request,
-		       ::rpc_common_respond *response) override;
+    /* The operations run under one hold of dentry_table_mutex and go into one journal transaction */
+    Status rpc_compound(::grpc::ServerContext *context, const ::rpc_compound_request *request,
+			::rpc_compound_respond *response);
 
-    Status rpc_truncate(::grpc::ServerContext *context, const ::rpc_truncate_request *request,
-			::rpc_common_respond *response) override;
+    Status rpc_delegate_creates(::grpc::ServerContext *context, const ::rpc_delegate_creates_request *request,
+				::rpc_delegate_creates_respond *response);
 
 };
 
-
 #endif //NMFS_RPC_SERVER_HPP
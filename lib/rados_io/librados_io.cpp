@@ -0,0 +1,174 @@
+#include "librados_io.hpp"
+#include "../logger/logger.hpp"
+
+#include <cstring>
+
+librados_io::aio_completion::aio_completion(char *buf, size_t len) : comp(librados::Rados::aio_create_completion()), buf(buf)
+{
+	bl = librados::bufferlist::static_from_mem(buf, len);
+}
+
+librados_io::aio_completion::~aio_completion(void)
+{
+	/* The request may still refer to the caller's buffer. */
+	if (comp) {
+		comp->wait_for_complete();
+		comp->release();
+	}
+}
+
+int librados_io::aio_completion::wait(void)
+{
+	comp->wait_for_complete();
+	int ret = comp->get_return_value();
+	comp->release();
+	comp = nullptr;
+
+	/* librados doesn't always read into the given buffer. Its own buffers are copied out
+	   segment by segment, c_str() would first gather them into another one. */
+	if (buf && ret > 0 && !bl.is_provided_buffer(buf))
+		bl.begin().copy(ret, buf);
+
+	return ret;
+}
+
+std::unique_ptr<rados_io::obj_completion> librados_io::aio_read_obj(const string &key, char *value, size_t len, off_t offset)
+{
+	global_logger.log(rados_io_ops,"Called librados_io::aio_read_obj()");
+	global_logger.log(rados_io_ops,"key : " + key + " length : " + std::to_string(len) + " offset : " + std::to_string(offset));
+
+	auto c = std::make_unique<aio_completion>(value, len);
+	int ret = ioctx.aio_read(key, c->comp, &c->bl, len, offset);
+	if (ret < 0) {
+		/* Never submitted, so there is nothing to wait for */
+		c->comp->release();
+		c->comp = nullptr;
+		return std::make_unique<done_completion>(ret);
+	}
+
+	return c;
+}
+
+std::unique_ptr<rados_io::obj_completion> librados_io::aio_write_obj(const string &key, const char *value, size_t len, off_t offset)
+{
+	global_logger.log(rados_io_ops,"Called librados_io::aio_write_obj()");
+	global_logger.log(rados_io_ops,"key : " + key + " length : " + std::to_string(len) + " offset : " + std::to_string(offset));
+
+	auto c = std::make_unique<aio_completion>(const_cast<char *>(value), len);
+	c->buf = nullptr;
+	int ret = ioctx.aio_write(key, c->comp, c->bl, len, offset);
+	if (ret < 0) {
+		/* Never submitted, so there is nothing to wait for */
+		c->comp->release();
+		c->comp = nullptr;
+		return std::make_unique<done_completion>(ret);
+	}
+
+	return c;
+}
+
+int librados_io::stat_obj(const string &key, uint64_t &size)
+{
+	time_t mtime;
+
+	return ioctx.stat(key, &size, &mtime);
+}
+
+int librados_io::remove_obj(const string &key)
+{
+	return ioctx.remove(key);
+}
+
+int librados_io::truncate_obj(const string &key, uint64_t size)
+{
+	return ioctx.trunc(key, size);
+}
+
+int librados_io::zero_obj(const string &key, off_t offset, size_t len)
+{
+	librados::ObjectWriteOperation op;
+	op.assert_exists();
+	op.zero(offset, len);
+
+	return ioctx.operate(key, &op);
+}
+
+int librados_io::omap_update_obj(const string &key, const std::map<string, string> &kvs, const std::set<string> &rm)
+{
+	librados::ObjectWriteOperation op;
+	op.create(false);
+
+	if (!rm.empty())
+		op.omap_rm_keys(rm);
+
+	if (!kvs.empty()) {
+		std::map<string, librados::bufferlist> bl_kvs;
+		for (auto &kv : kvs)
+			bl_kvs[kv.first].append(kv.second);
+		op.omap_set(bl_kvs);
+	}
+
+	return ioctx.operate(key, &op);
+}
+
+int librados_io::omap_get_obj(const string &key, const string &start_after, size_t max, std::map<string, string> &kvs, bool &more)
+{
+	librados::ObjectReadOperation op;
+	std::map<string, librados::bufferlist> bl_kvs;
+	int prval = 0;
+
+	op.omap_get_vals2(start_after, max, &bl_kvs, &more, &prval);
+
+	int ret = ioctx.operate(key, &op, nullptr);
+	if (ret < 0)
+		return ret;
+	if (prval < 0)
+		return prval;
+
+	for (auto &kv : bl_kvs)
+		kvs[kv.first] = kv.second.to_str();
+
+	return 0;
+}
+
+librados_io::librados_io(const conn_info &ci, const string &pool, size_t max_inflight) : rados_io(max_inflight)
+{
+	int ret;
+
+	if ((ret = cluster.init2(ci.user.c_str(), ci.cluster.c_str(), ci.flags)) < 0) {
+		throw runtime_error("librados_io::librados_io() failed "
+				"(couldn't initialize the cluster handle)");
+	}
+	global_logger.log(rados_io_ops, "Initialized the cluster handle. (user: \"" + ci.user + "\", cluster: \"" + ci.cluster + "\")");
+
+	if ((ret = cluster.conf_read_file("/etc/ceph/ceph.conf")) < 0) {
+		cluster.shutdown();
+		throw runtime_error("librados_io::librados_io() failed "
+				"(couldn't read the Ceph configuration file)");
+	}
+	global_logger.log(rados_io_ops, "Read a Ceph configuration file.");
+
+	if ((ret = cluster.connect()) < 0) {
+		cluster.shutdown();
+		throw runtime_error("librados_io::librados_io() failed "
+				"(couldn't connect to cluster)");
+	}
+	global_logger.log(rados_io_ops, "Connected to the cluster.");
+
+	if ((ret = cluster.ioctx_create(pool.c_str(), ioctx)) < 0) {
+		cluster.shutdown();
+		throw runtime_error("librados_io::librados_io() failed "
+				"(couldn't set up ioctx)");
+	}
+	global_logger.log(rados_io_ops, "Created an I/O context. "
+			"(pool: \"" + pool + "\")");
+}
+
+librados_io::~librados_io(void)
+{
+	ioctx.close();
+	global_logger.log(rados_io_ops, "Closed the connection.");
+
+	cluster.shutdown();
+	global_logger.log(rados_io_ops, "Shut down the handle.");
+}
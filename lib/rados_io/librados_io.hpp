@@ -0,0 +1,42 @@
+#ifndef _LIBRADOS_IO_HPP_
+#define _LIBRADOS_IO_HPP_
+
+#include <rados/librados.hpp>
+
+#include "rados_io.hpp"
+
+/* Object store on a Ceph cluster */
+class librados_io : public rados_io {
+private:
+	librados::Rados cluster;
+	librados::IoCtx ioctx;
+
+	class aio_completion : public obj_completion {
+	public:
+		librados::AioCompletion *comp;
+		librados::bufferlist bl;
+		/* destination of a read */
+		char *buf;
+
+		aio_completion(char *buf, size_t len);
+		~aio_completion(void) override;
+
+		int wait(void) override;
+	};
+
+protected:
+	std::unique_ptr<obj_completion> aio_read_obj(const string &key, char *value, size_t len, off_t offset) override;
+	std::unique_ptr<obj_completion> aio_write_obj(const string &key, const char *value, size_t len, off_t offset) override;
+	int stat_obj(const string &key, uint64_t &size) override;
+	int remove_obj(const string &key) override;
+	int truncate_obj(const string &key, uint64_t size) override;
+	int zero_obj(const string &key, off_t offset, size_t len) override;
+	int omap_update_obj(const string &key, const std::map<string, string> &kvs, const std::set<string> &rm) override;
+	int omap_get_obj(const string &key, const string &start_after, size_t max, std::map<string, string> &kvs, bool &more) override;
+
+public:
+	librados_io(const conn_info &ci, const string &pool, size_t max_inflight = MAX_INFLIGHT_AIO);
+	~librados_io(void) override;
+};
+
+#endif /* _LIBRADOS_IO_HPP_ */
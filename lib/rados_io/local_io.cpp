@@ -0,0 +1,288 @@
+#include "local_io.hpp"
+#include "../logger/logger.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <filesystem>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+string local_io::get_path(const string &key)
+{
+	string name = key;
+
+	/* An object key is a single file name */
+	for (char &c : name)
+		if (c == '/')
+			c = '%';
+
+	return dir + "/" + name;
+}
+
+string local_io::get_omap_path(const string &key)
+{
+	return get_path(key) + ".omap";
+}
+
+/* An omap key may be any string, make it a valid file name */
+static string escape_omap_key(const string &omap_key)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	string name;
+
+	for (size_t i = 0; i < omap_key.size(); i++) {
+		unsigned char c = omap_key[i];
+
+		if (c == '%' || c == '/' || c == '\0' || (i == 0 && c == '.')) {
+			name.push_back('%');
+			name.push_back(hex[c >> 4]);
+			name.push_back(hex[c & 0xf]);
+		} else {
+			name.push_back(static_cast<char>(c));
+		}
+	}
+
+	return name;
+}
+
+static string unescape_omap_key(const string &name)
+{
+	string omap_key;
+
+	for (size_t i = 0; i < name.size(); i++) {
+		if (name[i] == '%' && i + 2 < name.size()) {
+			omap_key.push_back(static_cast<char>(std::stoi(name.substr(i + 1, 2), nullptr, 16)));
+			i += 2;
+		} else {
+			omap_key.push_back(name[i]);
+		}
+	}
+
+	return omap_key;
+}
+
+static int read_whole_file(const string &path, string &value)
+{
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return -errno;
+
+	char buf[4096];
+	ssize_t ret;
+	value.clear();
+	while ((ret = ::read(fd, buf, sizeof(buf))) > 0)
+		value.append(buf, ret);
+	int err = (ret < 0) ? -errno : 0;
+	::close(fd);
+
+	return err;
+}
+
+static int write_whole_file(const string &path, const string &value)
+{
+	int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return -errno;
+
+	size_t sum = 0;
+	while (sum < value.size()) {
+		ssize_t ret = ::write(fd, value.data() + sum, value.size() - sum);
+		if (ret < 0) {
+			int err = errno;
+			::close(fd);
+			return -err;
+		}
+		sum += ret;
+	}
+	::close(fd);
+
+	return 0;
+}
+
+std::unique_ptr<rados_io::obj_completion> local_io::aio_read_obj(const string &key, char *value, size_t len, off_t offset)
+{
+	global_logger.log(rados_io_ops,"Called local_io::aio_read_obj()");
+
+	int fd = ::open(get_path(key).c_str(), O_RDONLY);
+	if (fd < 0)
+		return std::make_unique<done_completion>(-errno);
+
+	size_t sum = 0;
+	while (sum < len) {
+		ssize_t ret = ::pread(fd, value + sum, len - sum, offset + sum);
+		if (ret < 0) {
+			int err = errno;
+			::close(fd);
+			return std::make_unique<done_completion>(-err);
+		}
+		if (ret == 0)
+			break;
+		sum += ret;
+	}
+	::close(fd);
+
+	return std::make_unique<done_completion>(static_cast<int>(sum));
+}
+
+std::unique_ptr<rados_io::obj_completion> local_io::aio_write_obj(const string &key, const char *value, size_t len, off_t offset)
+{
+	global_logger.log(rados_io_ops,"Called local_io::aio_write_obj()");
+
+	int fd = ::open(get_path(key).c_str(), O_WRONLY | O_CREAT, 0644);
+	if (fd < 0)
+		return std::make_unique<done_completion>(-errno);
+
+	size_t sum = 0;
+	while (sum < len) {
+		ssize_t ret = ::pwrite(fd, value + sum, len - sum, offset + sum);
+		if (ret < 0) {
+			int err = errno;
+			::close(fd);
+			return std::make_unique<done_completion>(-err);
+		}
+		sum += ret;
+	}
+	::close(fd);
+
+	return std::make_unique<done_completion>(0);
+}
+
+int local_io::stat_obj(const string &key, uint64_t &size)
+{
+	struct stat st;
+
+	if (::stat(get_path(key).c_str(), &st) < 0)
+		return -errno;
+
+	size = st.st_size;
+	return 0;
+}
+
+int local_io::remove_obj(const string &key)
+{
+	if (::unlink(get_path(key).c_str()) < 0)
+		return -errno;
+
+	std::error_code ec;
+	std::filesystem::remove_all(get_omap_path(key), ec);
+	if (ec)
+		return -ec.value();
+
+	return 0;
+}
+
+int local_io::truncate_obj(const string &key, uint64_t size)
+{
+	if (::truncate(get_path(key).c_str(), size) < 0)
+		return -errno;
+
+	return 0;
+}
+
+int local_io::zero_obj(const string &key, off_t offset, size_t len)
+{
+	int fd = ::open(get_path(key).c_str(), O_WRONLY);
+	if (fd < 0)
+		return -errno;
+
+	struct stat st;
+	if (::fstat(fd, &st) < 0) {
+		int err = errno;
+		::close(fd);
+		return -err;
+	}
+
+	/* The range past the end is already a hole */
+	if (offset < st.st_size) {
+		size_t zero_len = std::min(len, static_cast<size_t>(st.st_size - offset));
+		std::vector<char> zeros(zero_len, 0);
+
+		if (::pwrite(fd, zeros.data(), zero_len, offset) < 0) {
+			int err = errno;
+			::close(fd);
+			return -err;
+		}
+	}
+	::close(fd);
+
+	return 0;
+}
+
+int local_io::omap_update_obj(const string &key, const std::map<string, string> &kvs, const std::set<string> &rm)
+{
+	/* The object itself has to exist as with RADOS */
+	int fd = ::open(get_path(key).c_str(), O_WRONLY | O_CREAT, 0644);
+	if (fd < 0)
+		return -errno;
+	::close(fd);
+
+	string omap_path = get_omap_path(key);
+	std::error_code ec;
+	std::filesystem::create_directories(omap_path, ec);
+	if (ec)
+		return -ec.value();
+
+	for (auto &k : rm)
+		if (::unlink((omap_path + "/" + escape_omap_key(k)).c_str()) < 0 && errno != ENOENT)
+			return -errno;
+
+	for (auto &kv : kvs) {
+		int ret = write_whole_file(omap_path + "/" + escape_omap_key(kv.first), kv.second);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+int local_io::omap_get_obj(const string &key, const string &start_after, size_t max, std::map<string, string> &kvs, bool &more)
+{
+	struct stat st;
+	if (::stat(get_path(key).c_str(), &st) < 0)
+		return -errno;
+
+	string omap_path = get_omap_path(key);
+	std::error_code ec;
+	more = false;
+
+	if (!std::filesystem::exists(omap_path, ec))
+		return 0;
+
+	/* The directory isn't sorted, pick the keys in order first */
+	std::set<string> omap_keys;
+	for (auto &entry : std::filesystem::directory_iterator(omap_path, ec)) {
+		string omap_key = unescape_omap_key(entry.path().filename().string());
+		if (omap_key > start_after)
+			omap_keys.insert(std::move(omap_key));
+	}
+	if (ec)
+		return -ec.value();
+
+	size_t n = 0;
+	for (auto &omap_key : omap_keys) {
+		if (n++ == max) {
+			more = true;
+			break;
+		}
+
+		int ret = read_whole_file(omap_path + "/" + escape_omap_key(omap_key), kvs[omap_key]);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+local_io::local_io(const string &root, const string &pool, size_t max_inflight) : rados_io(max_inflight), dir(root + "/" + pool)
+{
+	std::error_code ec;
+
+	std::filesystem::create_directories(dir, ec);
+	if (ec)
+		throw runtime_error("local_io::local_io() failed (couldn't create \"" + dir + "\")");
+
+	global_logger.log(rados_io_ops, "Opened a local object store. (directory: \"" + dir + "\")");
+}
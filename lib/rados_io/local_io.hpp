@@ -0,0 +1,30 @@
+#ifndef _LOCAL_IO_HPP_
+#define _LOCAL_IO_HPP_
+
+#include "rados_io.hpp"
+
+/* Object store on a local directory, one file per object */
+class local_io : public rados_io {
+private:
+	string dir;
+
+	string get_path(const string &key);
+	/* The omap of an object is a directory with a file per omap key */
+	string get_omap_path(const string &key);
+
+protected:
+	std::unique_ptr<obj_completion> aio_read_obj(const string &key, char *value, size_t len, off_t offset) override;
+	std::unique_ptr<obj_completion> aio_write_obj(const string &key, const char *value, size_t len, off_t offset) override;
+	int stat_obj(const string &key, uint64_t &size) override;
+	int remove_obj(const string &key) override;
+	int truncate_obj(const string &key, uint64_t size) override;
+	int zero_obj(const string &key, off_t offset, size_t len) override;
+	int omap_update_obj(const string &key, const std::map<string, string> &kvs, const std::set<string> &rm) override;
+	int omap_get_obj(const string &key, const string &start_after, size_t max, std::map<string, string> &kvs, bool &more) override;
+
+public:
+	/* The objects of a pool are kept in <root>/<pool> */
+	local_io(const string &root, const string &pool, size_t max_inflight = MAX_INFLIGHT_AIO);
+};
+
+#endif /* _LOCAL_IO_HPP_ */
@@ -0,0 +1,135 @@
+#include "memory_io.hpp"
+#include "../logger/logger.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <mutex>
+
+memory_io::shard &memory_io::get_shard(const string &key)
+{
+	return shards[std::hash<string>{}(key) % NUM_MEMORY_IO_SHARDS];
+}
+
+std::unique_ptr<rados_io::obj_completion> memory_io::aio_read_obj(const string &key, char *value, size_t len, off_t offset)
+{
+	global_logger.log(rados_io_ops,"Called memory_io::aio_read_obj()");
+	shard &s = get_shard(key);
+	std::shared_lock lock(s.mutex);
+
+	auto it = s.objs.find(key);
+	if (it == s.objs.end())
+		return std::make_unique<done_completion>(-ENOENT);
+
+	const string &obj = it->second.data;
+	if (static_cast<size_t>(offset) >= obj.size())
+		return std::make_unique<done_completion>(0);
+
+	size_t read_len = std::min(len, obj.size() - offset);
+	memcpy(value, obj.data() + offset, read_len);
+
+	return std::make_unique<done_completion>(static_cast<int>(read_len));
+}
+
+std::unique_ptr<rados_io::obj_completion> memory_io::aio_write_obj(const string &key, const char *value, size_t len, off_t offset)
+{
+	global_logger.log(rados_io_ops,"Called memory_io::aio_write_obj()");
+	shard &s = get_shard(key);
+	std::unique_lock lock(s.mutex);
+
+	string &obj = s.objs[key].data;
+	/* A gap before the offset reads back as zeros */
+	if (obj.size() < offset + len)
+		obj.resize(offset + len, '\0');
+	memcpy(obj.data() + offset, value, len);
+
+	return std::make_unique<done_completion>(0);
+}
+
+int memory_io::stat_obj(const string &key, uint64_t &size)
+{
+	shard &s = get_shard(key);
+	std::shared_lock lock(s.mutex);
+
+	auto it = s.objs.find(key);
+	if (it == s.objs.end())
+		return -ENOENT;
+
+	size = it->second.data.size();
+	return 0;
+}
+
+int memory_io::remove_obj(const string &key)
+{
+	shard &s = get_shard(key);
+	std::unique_lock lock(s.mutex);
+
+	return s.objs.erase(key) ? 0 : -ENOENT;
+}
+
+int memory_io::truncate_obj(const string &key, uint64_t size)
+{
+	shard &s = get_shard(key);
+	std::unique_lock lock(s.mutex);
+
+	auto it = s.objs.find(key);
+	if (it == s.objs.end())
+		return -ENOENT;
+
+	it.value().data.resize(size, '\0');
+	return 0;
+}
+
+int memory_io::zero_obj(const string &key, off_t offset, size_t len)
+{
+	shard &s = get_shard(key);
+	std::unique_lock lock(s.mutex);
+
+	auto it = s.objs.find(key);
+	if (it == s.objs.end())
+		return -ENOENT;
+
+	/* The range past the end is already a hole */
+	string &obj = it.value().data;
+	if (static_cast<size_t>(offset) < obj.size())
+		memset(obj.data() + offset, 0, std::min(len, obj.size() - offset));
+
+	return 0;
+}
+
+int memory_io::omap_update_obj(const string &key, const std::map<string, string> &kvs, const std::set<string> &rm)
+{
+	shard &s = get_shard(key);
+	std::unique_lock lock(s.mutex);
+
+	std::map<string, string> &omap = s.objs[key].omap;
+	for (auto &k : rm)
+		omap.erase(k);
+	for (auto &kv : kvs)
+		omap[kv.first] = kv.second;
+
+	return 0;
+}
+
+int memory_io::omap_get_obj(const string &key, const string &start_after, size_t max, std::map<string, string> &kvs, bool &more)
+{
+	shard &s = get_shard(key);
+	std::shared_lock lock(s.mutex);
+
+	auto it = s.objs.find(key);
+	if (it == s.objs.end())
+		return -ENOENT;
+
+	const std::map<string, string> &omap = it->second.omap;
+	auto kv = omap.upper_bound(start_after);
+	for (size_t n = 0; kv != omap.end() && n < max; kv++, n++)
+		kvs.insert(*kv);
+	more = (kv != omap.end());
+
+	return 0;
+}
+
+memory_io::memory_io(size_t max_inflight) : rados_io(max_inflight)
+{
+	global_logger.log(rados_io_ops, "Created an in-memory object store.");
+}
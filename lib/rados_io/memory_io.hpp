@@ -0,0 +1,43 @@
+#ifndef _MEMORY_IO_HPP_
+#define _MEMORY_IO_HPP_
+
+#include <shared_mutex>
+
+#include <tsl/robin_map.h>
+
+#include "rados_io.hpp"
+
+#define NUM_MEMORY_IO_SHARDS	(64)
+
+/* Volatile object store kept in a sharded hash map, for tests and benchmarks */
+class memory_io : public rados_io {
+private:
+	struct object {
+		string data;
+		std::map<string, string> omap;
+	};
+
+	struct shard {
+		std::shared_mutex mutex;
+		tsl::robin_map<string, object> objs;
+	};
+
+	shard shards[NUM_MEMORY_IO_SHARDS];
+
+	shard &get_shard(const string &key);
+
+protected:
+	std::unique_ptr<obj_completion> aio_read_obj(const string &key, char *value, size_t len, off_t offset) override;
+	std::unique_ptr<obj_completion> aio_write_obj(const string &key, const char *value, size_t len, off_t offset) override;
+	int stat_obj(const string &key, uint64_t &size) override;
+	int remove_obj(const string &key) override;
+	int truncate_obj(const string &key, uint64_t size) override;
+	int zero_obj(const string &key, off_t offset, size_t len) override;
+	int omap_update_obj(const string &key, const std::map<string, string> &kvs, const std::set<string> &rm) override;
+	int omap_get_obj(const string &key, const string &start_after, size_t max, std::map<string, string> &kvs, bool &more) override;
+
+public:
+	explicit memory_io(size_t max_inflight = MAX_INFLIGHT_AIO);
+};
+
+#endif /* _MEMORY_IO_HPP_ */
@@ -1,6 +1,11 @@
 #include "rados_io.hpp"
+#include "librados_io.hpp"
+#include "memory_io.hpp"
+#include "local_io.hpp"
 #include "../logger/logger.hpp"
 
+#include <cstring>
+
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
@@ -27,52 +32,117 @@ static string get_postfix(uint64_t num)
 	return "#" + std::to_string(num);
 }
 
-size_t rados_io::read_obj(const string &key, char *value, size_t len, off_t offset)
-{
-	global_logger.log(rados_io_ops,"Called rados_io::read_obj()");
-	global_logger.log(rados_io_ops,"key : " + key + " length : " + std::to_string(len) + " offset : " + std::to_string(offset));
-	uint64_t size;
-	time_t mtime;
+void rados_io::cut_obj(const string &key, uint64_t cut_size) {
+	global_logger.log(rados_io_ops,"Called rados_io::cut_obj()");
+	global_logger.log(rados_io_ops,"key : " + key + " cut_size : " + std::to_string(cut_size));
 	int ret;
 
-	librados::bufferlist bl = librados::bufferlist::static_from_mem(value, len);
-	ret = ioctx.read(key, bl, len, offset);
+	/* Nothing is left in the object, a hole is cheaper than an empty object. */
+	if (cut_size == 0)
+		ret = remove_obj(key);
+	else
+		ret = truncate_obj(key, cut_size);
 
-	if (ret >= 0) {
-		global_logger.log(rados_io_ops,"Read an object. (key: \"" + key + "\")");
+	if (ret == 0) {
+		global_logger.log(rados_io_ops, "Truncate an object. (key: \"" + key + "\")");
 	} else if (ret == -ENOENT) {
-		throw no_such_object("rados_io::read_obj() failed (key: \"" + key + "\")");
+		global_logger.log(rados_io_ops, "Tried to truncate a hole. (key: \"" + key + "\")");
 	} else {
-		throw runtime_error("rados_io::read_obj() failed");
+		throw runtime_error("rados_io::cut_obj() failed");
 	}
+}
+
+rados_io::no_such_object::no_such_object(const string &msg, size_t nb) : runtime_error(msg), num_bytes(nb)
+{
+}
+
+const char *rados_io::no_such_object::what(void)
+{
+	return runtime_error::what();
+}
 
-	memcpy(value, bl.c_str(), ret);
+rados_io::done_completion::done_completion(int ret) : ret(ret)
+{
+}
 
+int rados_io::done_completion::wait(void)
+{
 	return ret;
 }
 
-size_t rados_io::write_obj(const string &key, const char *value, size_t len, off_t offset)
+rados_io::aio_handle::aio_handle(rados_io *io, bool is_write, bool sparse, size_t max_inflight) : io(io), is_write(is_write), sparse(sparse), max_inflight(MAX(max_inflight, 1)), issued(0), waited(0), done(false), result(0), error(0)
 {
-	global_logger.log(rados_io_ops,"Called rados_io::write_obj()");
-	global_logger.log(rados_io_ops,"key : " + key + " length : " + std::to_string(len) + " offset : " + std::to_string(offset));
-	int ret;
+}
 
-	librados::bufferlist bl = librados::bufferlist::static_from_mem(const_cast<char *>(value), len);
-	ret = ioctx.write(key, bl, len, offset);
+void rados_io::aio_handle::issue(void)
+{
+	sub_request &sub = subs[issued++];
 
-	if (ret >= 0) {
-		global_logger.log(rados_io_ops, "Wrote an object. (key: \"" + key + "\")");
-	} else {
-		throw runtime_error("rados_io::write_obj() failed");
+	if (is_write)
+		sub.comp = io->aio_write_obj(sub.obj_key, sub.buf, sub.len, sub.obj_off);
+	else
+		sub.comp = io->aio_read_obj(sub.obj_key, sub.buf, sub.len, sub.obj_off);
+}
+
+size_t rados_io::aio_handle::wait(void)
+{
+	global_logger.log(rados_io_ops, "Called rados_io::aio_handle::wait()");
+
+	while (waited < subs.size()) {
+		sub_request &sub = subs[waited++];
+
+		sub.ret = sub.comp->wait();
+		sub.comp.reset();
+
+		/* A slot is free, issue the next sub-request. */
+		if (issued < subs.size())
+			issue();
 	}
 
-	return len;
+	if (!done) {
+		done = true;
+
+		for (sub_request &sub : subs) {
+			if (sparse && sub.ret == -ENOENT) {
+				memset(sub.buf, 0, sub.len);
+				result += sub.len;
+				continue;
+			}
+
+			if (sub.ret < 0) {
+				error = sub.ret;
+				global_logger.log(rados_io_ops, "Failed to access an object. (key: \"" + sub.obj_key + "\")");
+				break;
+			}
+
+			if (is_write) {
+				result += sub.len;
+				continue;
+			}
+
+			if (sparse) {
+				memset(sub.buf + sub.ret, 0, sub.len - sub.ret);
+				result += sub.len;
+				continue;
+			}
+			result += sub.ret;
+
+			/* A short object means the end of the data. */
+			if (static_cast<size_t>(sub.ret) < sub.len)
+				break;
+		}
+	}
+
+	if (error == -ENOENT && !is_write)
+		throw no_such_object("rados_io::aio_handle::wait() failed (no such object)", result);
+	else if (error < 0)
+		throw runtime_error("rados_io::aio_handle::wait() failed");
+
+	return result;
 }
 
-void rados_io::zerofill(obj_category category, const string &key, size_t len, off_t offset)
+void rados_io::stripe(aio_handle &handle, obj_category category, const string &key, char *value, size_t len, off_t offset)
 {
-	char *zeros = new char[MIN(len, OBJ_SIZE)]();
-
 	string p_key = get_prefix(category) + key;
 
 	off_t cursor = offset;
@@ -81,81 +151,37 @@ void rados_io::zerofill(obj_category category, const string &key, size_t len, of
 
 	while (cursor < stop) {
 		uint64_t obj_num = cursor >> OBJ_BITS;
-		string obj_key = p_key + get_postfix(obj_num);
 
 		off_t next_bound = (cursor & OBJ_MASK) + OBJ_SIZE;
 		size_t sub_len = MIN(next_bound - cursor, stop - cursor);
 
-		write_obj(obj_key, zeros, sub_len, cursor & (~OBJ_MASK));
+		handle.subs.push_back({p_key + get_postfix(obj_num), value + sum, sub_len, cursor & (~OBJ_MASK), nullptr, 0});
 
+		sum += sub_len;
 		cursor = next_bound;
 	}
 
-	delete []zeros;
-}
-
-void rados_io::truncate_obj(const string &key, uint64_t cut_size) {
-	global_logger.log(rados_io_ops,"Called rados_io::write_obj()");
-	global_logger.log(rados_io_ops,"key : " + key + " cut_size : " + std::to_string(cut_size));
-	int ret;
-	ret = ioctx.trunc(key, cut_size);
-
-	if (ret == 0) {
-		global_logger.log(rados_io_ops, "Truncate an object. (key: \"" + key + "\")");
-	} else {
-		throw runtime_error("rados_io::truncate_obj() failed");
-	}
-}
-
-rados_io::no_such_object::no_such_object(const string &msg, size_t nb) : runtime_error(msg), num_bytes(nb)
-{
-}
-
-const char *rados_io::no_such_object::what(void)
-{
-	return runtime_error::what();
+	/* Send out the first window at once */
+	while (handle.issued < handle.subs.size() && handle.issued < handle.max_inflight)
+		handle.issue();
 }
 
-rados_io::rados_io(const conn_info &ci, string pool)
+std::shared_ptr<rados_io> rados_io::create(const string &backend, const conn_info &ci, const string &pool, size_t max_inflight)
 {
-	int ret;
-
-	if ((ret = cluster.init2(ci.user.c_str(), ci.cluster.c_str(), ci.flags)) < 0) {
-		throw runtime_error("rados_io::rados_io() failed "
-				"(couldn't initialize the cluster handle)");
-	}
-	global_logger.log(rados_io_ops, "Initialized the cluster handle. (user: \"" + ci.user + "\", cluster: \"" + ci.cluster + "\")");
-
-	if ((ret = cluster.conf_read_file("/etc/ceph/ceph.conf")) < 0) {
-		cluster.shutdown();
-		throw runtime_error("rados_io::rados_io() failed "
-				"(couldn't read the Ceph configuration file)");
-	}
-	global_logger.log(rados_io_ops, "Read a Ceph configuration file.");
+	global_logger.log(rados_io_ops, "Called rados_io::create(" + backend + ", " + pool + ")");
 
-	if ((ret = cluster.connect()) < 0) {
-		cluster.shutdown();
-		throw runtime_error("rados_io::rados_io() failed "
-				"(couldn't connect to cluster)");
-	}
-	global_logger.log(rados_io_ops, "Connected to the cluster.");
+	if (backend == "rados")
+		return std::make_shared<librados_io>(ci, pool, max_inflight);
+	else if (backend == "memory")
+		return std::make_shared<memory_io>(max_inflight);
+	else if (backend.rfind("local:", 0) == 0)
+		return std::make_shared<local_io>(backend.substr(6), pool, max_inflight);
 
-	if ((ret = cluster.ioctx_create(pool.c_str(), ioctx)) < 0) {
-		cluster.shutdown();
-		throw runtime_error("rados_io::rados_io() failed "
-				"(couldn't set up ioctx)");
-	}
-	global_logger.log(rados_io_ops, "Created an I/O context. "
-			"(pool: \"" + pool + "\")");
+	throw runtime_error("rados_io::create() failed (unknown backend \"" + backend + "\")");
 }
 
-rados_io::~rados_io(void)
+rados_io::rados_io(size_t max_inflight) : max_inflight(max_inflight)
 {
-	ioctx.close();
-	global_logger.log(rados_io_ops, "Closed the connection.");
-
-	cluster.shutdown();
-	global_logger.log(rados_io_ops, "Shut down the handle.");
 }
 
 size_t rados_io::read(obj_category category, const string &key, char *value, size_t len, off_t offset)
@@ -163,29 +189,15 @@ size_t rados_io::read(obj_category category, const string &key, char *value, siz
 	global_logger.log(rados_io_ops, "Called rados_io::read()");
 	global_logger.log(rados_io_ops, "key : " + key + " length : " + std::to_string(len) + " offset : " + std::to_string(offset));
 
-	string p_key = get_prefix(category) + key;
-
-	off_t cursor = offset;
-	off_t stop = offset + len;
-	size_t sum = 0;
-
-	while (cursor < stop) {
-		uint64_t obj_num = cursor >> OBJ_BITS;
-		string obj_key = p_key + get_postfix(obj_num);
-
-		off_t next_bound = (cursor & OBJ_MASK) + OBJ_SIZE;
-		size_t sub_len = MIN(next_bound - cursor, stop - cursor);
-
-		try {
-			sum += read_obj(obj_key,value + sum, sub_len, cursor & (~OBJ_MASK));
-		} catch (no_such_object &e) {
-			throw no_such_object(e.what(), sum);
-		}
+	return aio_read(category, key, value, len, offset)->wait();
+}
 
-		cursor = next_bound;
-	}
+size_t rados_io::read(obj_category category, const string &key, char *value, size_t len, off_t offset, size_t file_size)
+{
+	global_logger.log(rados_io_ops, "Called rados_io::read()");
+	global_logger.log(rados_io_ops, "key : " + key + " length : " + std::to_string(len) + " offset : " + std::to_string(offset) + " file_size : " + std::to_string(file_size));
 
-	return sum;
+	return aio_read(category, key, value, len, offset, file_size)->wait();
 }
 
 size_t rados_io::write(obj_category category, const string &key, const char *value, size_t len, off_t offset)
@@ -193,55 +205,47 @@ size_t rados_io::write(obj_category category, const string &key, const char *val
 	global_logger.log(rados_io_ops, "Called rados_io::write()");
 	global_logger.log(rados_io_ops, "key : " + key + " length : " + std::to_string(len) + " offset : " + std::to_string(offset));
 
-	string p_key = get_prefix(category) + key;
-
-	/* Fill the "hole" with zeros if the given offset is greater than the file size.
-	   To do this, get the file size and do zerofill via zerofill(). */
-	int ret;
-	size_t lb_file_size;
-
-	for (int64_t prev_obj_num = offset >> OBJ_BITS; prev_obj_num >= 0; prev_obj_num--) {
-		uint64_t size;
-		time_t mtime;
+	/* A hole before the offset is left as it is, it reads back as zeros. */
+	return aio_write(category, key, value, len, offset)->wait();
+}
 
-		string prev_obj_key = p_key + get_postfix(prev_obj_num);
+std::shared_ptr<rados_io::aio_handle> rados_io::aio_read(obj_category category, const string &key, char *value, size_t len, off_t offset)
+{
+	global_logger.log(rados_io_ops, "Called rados_io::aio_read()");
+	global_logger.log(rados_io_ops, "key : " + key + " length : " + std::to_string(len) + " offset : " + std::to_string(offset));
 
-		ret = ioctx.stat(prev_obj_key, &size, &mtime);
-		if (ret >= 0) {
-			lb_file_size = (prev_obj_num << OBJ_BITS) + size;
-			break;
-		} else if (ret != -ENOENT) {
-			throw runtime_error("rados_io::write() failed (stat() failed)");
-		}
-	}
+	std::shared_ptr<aio_handle> handle(new aio_handle(this, false, false, max_inflight));
+	stripe(*handle, category, key, value, len, offset);
 
-	/* There are no such RADOS objects. */
-	if (ret == -ENOENT)
-		lb_file_size = 0;
+	return handle;
+}
 
-	/* Do zerofill */
-	/* If lb_file_size < offset, lb_file_size is equal to the file size */
-	if (lb_file_size < offset)
-		zerofill(category, key, offset - lb_file_size, lb_file_size);
+std::shared_ptr<rados_io::aio_handle> rados_io::aio_read(obj_category category, const string &key, char *value, size_t len, off_t offset, size_t file_size)
+{
+	global_logger.log(rados_io_ops, "Called rados_io::aio_read()");
+	global_logger.log(rados_io_ops, "key : " + key + " length : " + std::to_string(len) + " offset : " + std::to_string(offset) + " file_size : " + std::to_string(file_size));
 
-	/* Now it's time to write. */
-	off_t cursor = offset;
-	off_t stop = offset + len;
-	size_t sum = 0;
+	/* Never read past the end of the file */
+	if (offset >= static_cast<off_t>(file_size))
+		len = 0;
+	else
+		len = MIN(len, file_size - offset);
 
-	while (cursor < stop) {
-		uint64_t obj_num = cursor >> OBJ_BITS;
-		string obj_key = p_key + get_postfix(obj_num);
+	std::shared_ptr<aio_handle> handle(new aio_handle(this, false, true, max_inflight));
+	stripe(*handle, category, key, value, len, offset);
 
-		off_t next_bound = (cursor & OBJ_MASK) + OBJ_SIZE;
-		size_t sub_len = MIN(next_bound - cursor, stop - cursor);
+	return handle;
+}
 
-		sum += write_obj(obj_key,value + sum, sub_len, cursor & (~OBJ_MASK));
+std::shared_ptr<rados_io::aio_handle> rados_io::aio_write(obj_category category, const string &key, const char *value, size_t len, off_t offset)
+{
+	global_logger.log(rados_io_ops, "Called rados_io::aio_write()");
+	global_logger.log(rados_io_ops, "key : " + key + " length : " + std::to_string(len) + " offset : " + std::to_string(offset));
 
-		cursor = next_bound;
-	}
+	std::shared_ptr<aio_handle> handle(new aio_handle(this, true, false, max_inflight));
+	stripe(*handle, category, key, const_cast<char *>(value), len, offset);
 
-	return sum;
+	return handle;
 }
 
 bool rados_io::exist(obj_category category, const string &key)
@@ -254,9 +258,8 @@ bool rados_io::exist(obj_category category, const string &key)
 
 	int ret;
 	uint64_t size;
-	time_t mtime;
 
-	ret = ioctx.stat(obj_key, &size, &mtime);
+	ret = stat_obj(obj_key, size);
 	if (ret >= 0) {
 		global_logger.log(rados_io_ops, "The object with key \""+ key + "\" exists.");
 		return true;
@@ -278,11 +281,10 @@ bool rados_io::stat(obj_category category, const string &key, size_t &size)
 	size = 0;
 	int ret;
 	uint64_t obj_size;
-	time_t mtime;
 
 	/* We need to check all the RADOS objects */
 	for (uint64_t obj_num = 0; ; obj_num++) {
-		ret = ioctx.stat(p_key + get_postfix(obj_num), &obj_size, &mtime);
+		ret = stat_obj(p_key + get_postfix(obj_num), obj_size);
 
 		if (ret == -ENOENT && obj_num == 0) {
 			global_logger.log(rados_io_ops, "The object with key \"" + key + "\" doesn't exist.");
@@ -308,7 +310,7 @@ void rados_io::remove(obj_category category, const string &key)
 	int ret;
 
 	for (uint64_t obj_num = 0; ; obj_num++) {
-		ret = ioctx.remove(p_key + get_postfix(obj_num));
+		ret = remove_obj(p_key + get_postfix(obj_num));
 
 		if (ret == -ENOENT && obj_num == 0) {
 			global_logger.log(rados_io_ops, "Tried to remove a non-existent object. (key: \"" + key + "\")");
@@ -322,65 +324,104 @@ void rados_io::remove(obj_category category, const string &key)
 	}
 }
 
-int rados_io::truncate(obj_category category, const string &key, size_t offset){
-	global_logger.log(rados_io_ops, "Called rados_io::truncate()");
-	global_logger.log(rados_io_ops, "key : " + key);
+void rados_io::remove(obj_category category, const string &key, size_t size)
+{
+	global_logger.log(rados_io_ops, "Called rados_io::remove()");
+	global_logger.log(rados_io_ops, "key : " + key + " size : " + std::to_string(size));
 
 	string p_key = get_prefix(category) + key;
+	uint64_t num_objs = size ? ((size - 1) >> OBJ_BITS) + 1 : 1;
 
-	int ret;
-	size_t lb_file_size;
-
-	for (int64_t prev_obj_num = offset >> OBJ_BITS; prev_obj_num >= 0; prev_obj_num--) {
-		uint64_t size;
-		time_t mtime;
-
-		string prev_obj_key = p_key + get_postfix(prev_obj_num);
-
-		ret = ioctx.stat(prev_obj_key, &size, &mtime);
-		if (ret >= 0) {
-			lb_file_size = (prev_obj_num << OBJ_BITS) + size;
-			break;
-		} else if (ret != -ENOENT) {
-			throw runtime_error("rados_io::truncate() failed (stat() failed)");
-		}
+	for (uint64_t obj_num = 0; obj_num < num_objs; obj_num++) {
+		int ret = remove_obj(p_key + get_postfix(obj_num));
+		if (ret < 0 && ret != -ENOENT)
+			throw runtime_error("rados_io::remove() failed");
 	}
+	global_logger.log(rados_io_ops, "Removed an object. (key: \"" + key + "\")");
+}
 
-	/* There are no such RADOS objects. */
-	if (ret == -ENOENT) {
-		zerofill(category, key, offset, 0);
-		return 0;
-	}
+int rados_io::truncate(obj_category category, const string &key, size_t offset, size_t file_size)
+{
+	global_logger.log(rados_io_ops, "Called rados_io::truncate()");
+	global_logger.log(rados_io_ops, "key : " + key + " offset : " + std::to_string(offset) + " file_size : " + std::to_string(file_size));
 
-	/* Do zerofill */
-	/* If lb_file_size < offset, lb_file_size is equal to the file size */
-	if (lb_file_size < offset) {
-		zerofill(category, key, offset - lb_file_size, lb_file_size);
+	string p_key = get_prefix(category) + key;
+
+	/* Growing a file only moves its size, the new range is a hole. */
+	if (file_size <= offset)
 		return 0;
-	}
 
 	/* Now it's time to truncate. */
 	uint64_t obj_num = offset >> OBJ_BITS;
-	string obj_key = p_key + get_postfix(obj_num);
+	cut_obj(p_key + get_postfix(obj_num), offset - (obj_num << OBJ_BITS));
+
+	/* Remove the objects which were entirely beyond the new size */
+	uint64_t last_obj_num = (file_size - 1) >> OBJ_BITS;
+	for (obj_num++; obj_num <= last_obj_num; obj_num++) {
+		int ret = remove_obj(p_key + get_postfix(obj_num));
+		if (ret < 0 && ret != -ENOENT)
+			throw runtime_error("rados_io::truncate() failed (remove() failed)");
+	}
+
+	return 0;
+}
+
+void rados_io::punch_hole(obj_category category, const string &key, off_t offset, size_t len)
+{
+	global_logger.log(rados_io_ops, "Called rados_io::punch_hole()");
+	global_logger.log(rados_io_ops, "key : " + key + " length : " + std::to_string(len) + " offset : " + std::to_string(offset));
 
-	size_t cut_size = (offset - (obj_num << OBJ_BITS));
-	truncate_obj(obj_key, cut_size);
+	string p_key = get_prefix(category) + key;
 
-	/* if there is remaining object, remove them */
-	while(1) {
-		uint64_t size;
-		time_t mtime;
+	off_t cursor = offset;
+	off_t stop = offset + len;
 
-		obj_num = obj_num + 1;
-		string removed_obj_key = p_key + get_postfix(obj_num);
+	while (cursor < stop) {
+		uint64_t obj_num = cursor >> OBJ_BITS;
+		string obj_key = p_key + get_postfix(obj_num);
 
-		ret = ioctx.stat(removed_obj_key, &size, &mtime);
-		if (ret >= 0) {
-			ioctx.remove(removed_obj_key);
-		} else if (ret == -ENOENT) {
-			break;
+		off_t next_bound = (cursor & OBJ_MASK) + OBJ_SIZE;
+		size_t sub_len = MIN(next_bound - cursor, stop - cursor);
+
+		/* A whole object becomes a missing object */
+		if (sub_len == OBJ_SIZE) {
+			int ret = remove_obj(obj_key);
+			if (ret < 0 && ret != -ENOENT)
+				throw runtime_error("rados_io::punch_hole() failed (remove() failed)");
+		} else {
+			int ret = zero_obj(obj_key, cursor & (~OBJ_MASK), sub_len);
+			if (ret < 0 && ret != -ENOENT)
+				throw runtime_error("rados_io::punch_hole() failed (zero_obj() failed)");
 		}
+
+		cursor = next_bound;
 	}
+}
 
-	return 0;
+void rados_io::omap_update(obj_category category, const string &key, const std::map<string, string> &kvs, const std::set<string> &rm)
+{
+	global_logger.log(rados_io_ops, "Called rados_io::omap_update()");
+	global_logger.log(rados_io_ops, "key : " + key + " set : " + std::to_string(kvs.size()) + " remove : " + std::to_string(rm.size()));
+
+	string obj_key = get_prefix(category) + key + get_postfix(0);
+
+	if (omap_update_obj(obj_key, kvs, rm) < 0)
+		throw runtime_error("rados_io::omap_update() failed");
+}
+
+bool rados_io::omap_get(obj_category category, const string &key, const string &start_after, size_t max, std::map<string, string> &kvs)
+{
+	global_logger.log(rados_io_ops, "Called rados_io::omap_get()");
+	global_logger.log(rados_io_ops, "key : " + key + " start_after : " + start_after + " max : " + std::to_string(max));
+
+	string obj_key = get_prefix(category) + key + get_postfix(0);
+	bool more = false;
+
+	int ret = omap_get_obj(obj_key, start_after, max, kvs, more);
+	if (ret == -ENOENT)
+		throw no_such_object("rados_io::omap_get() failed (no such object)");
+	else if (ret < 0)
+		throw runtime_error("rados_io::omap_get() failed");
+
+	return more;
 }
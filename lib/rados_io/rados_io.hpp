@@ -1,9 +1,12 @@
 #ifndef _RADOS_IO_HPP_
 #define _RADOS_IO_HPP_
 
+#include <map>
+#include <memory>
+#include <set>
 #include <stdexcept>
 #include <string>
-#include <rados/librados.hpp>
+#include <vector>
 
 using std::logic_error;
 using std::runtime_error;
@@ -13,6 +16,12 @@ using std::string;
 #define OBJ_BITS	(22)
 #define OBJ_MASK	((~0) << OBJ_BITS)
 
+/* Default number of per-object requests kept in flight by a single striped I/O */
+#define MAX_INFLIGHT_AIO	(16)
+
+/* Object store backend used when nothing is given at mount time */
+#define DEFAULT_BACKEND	"rados"
+
 enum class obj_category {
 	INODE,
 	DENTRY,
@@ -21,16 +30,12 @@ enum class obj_category {
 	JOURNAL,
 };
 
+/*
+ * Object store interface.
+ * Striping a key over OBJ_SIZE objects is done here,
+ * the backends (librados_io, memory_io, local_io) only provide the per-object operations.
+ */
 class rados_io {
-private:
-	librados::Rados cluster;
-	librados::IoCtx ioctx;
-
-	size_t read_obj(const string &key, char *value, size_t len, off_t offset);
-	size_t write_obj(const string &key, const char *value, size_t len, off_t offset);
-	void zerofill(obj_category category, const string &key, size_t len, off_t offset);
-	void truncate_obj(const string &key, uint64_t cut_size);
-
 public:
 	class no_such_object : public runtime_error {
 	public:
@@ -46,15 +51,109 @@ public:
 		int64_t flags;
 	};
 
-	rados_io(const conn_info &ci, string pool);
-	~rados_io(void);
+	/* An operation on a single object issued by a backend */
+	class obj_completion {
+	public:
+		virtual ~obj_completion(void) = default;
+
+		/* Returns the number of bytes read (0 for a write) or a negative error code */
+		virtual int wait(void) = 0;
+	};
+
+	/* A striped request split into per-object sub-requests.
+	   At most max_inflight sub-requests are outstanding at once;
+	   the rest are issued from wait() as the earlier ones complete.
+	   A sparse read fills missing or short objects with zeros. */
+	class aio_handle {
+		friend class rados_io;
+
+	private:
+		struct sub_request {
+			string obj_key;
+			char *buf;
+			size_t len;
+			off_t obj_off;
+			std::unique_ptr<obj_completion> comp;
+			int ret;
+		};
+
+		rados_io *io;
+		bool is_write;
+		bool sparse;
+		size_t max_inflight;
+		std::vector<sub_request> subs;
+		size_t issued;
+		size_t waited;
+
+		bool done;
+		size_t result;
+		int error;
+
+		aio_handle(rados_io *io, bool is_write, bool sparse, size_t max_inflight);
+		void issue(void);
+
+	public:
+		/* Waits for all the sub-requests and returns the number of bytes.
+		   Reads throw no_such_object when they hit a missing object. */
+		size_t wait(void);
+	};
+
+	/* backend : "rados", "memory" or "local:<directory>" */
+	static std::shared_ptr<rados_io> create(const string &backend, const conn_info &ci, const string &pool, size_t max_inflight = MAX_INFLIGHT_AIO);
+
+	explicit rados_io(size_t max_inflight = MAX_INFLIGHT_AIO);
+	virtual ~rados_io(void) = default;
+
+	std::shared_ptr<aio_handle> aio_read(obj_category category, const string &key, char *value, size_t len, off_t offset);
+	std::shared_ptr<aio_handle> aio_read(obj_category category, const string &key, char *value, size_t len, off_t offset, size_t file_size);
+	std::shared_ptr<aio_handle> aio_write(obj_category category, const string &key, const char *value, size_t len, off_t offset);
 
 	size_t read(obj_category category, const string &key, char *value, size_t len, off_t offset);
+	/* Reads a sparse object of the given size, holes read back as zeros */
+	size_t read(obj_category category, const string &key, char *value, size_t len, off_t offset, size_t file_size);
 	size_t write(obj_category category, const string &key, const char *value, size_t len, off_t offset);
 	bool exist(obj_category category, const string &key);
 	bool stat(obj_category category, const string &key, size_t &size);
 	void remove(obj_category category, const string &key);
-	int truncate(obj_category category, const string &key, size_t offset);
+	/* Removes a sparse object of the given size, holes included */
+	void remove(obj_category category, const string &key, size_t size);
+	int truncate(obj_category category, const string &key, size_t offset, size_t file_size);
+	void punch_hole(obj_category category, const string &key, off_t offset, size_t len);
+
+	/* Removes the keys in rm and then sets the pairs in kvs in a single operation.
+	   The omap lives in the first object, which is created if it doesn't exist. */
+	void omap_update(obj_category category, const string &key, const std::map<string, string> &kvs, const std::set<string> &rm);
+	/* Gets at most max pairs following start_after in key order and returns whether there are more.
+	   Throws no_such_object if the object doesn't exist. */
+	bool omap_get(obj_category category, const string &key, const string &start_after, size_t max, std::map<string, string> &kvs);
+
+protected:
+	/* A completion for the backends which finish an operation before returning it */
+	class done_completion : public obj_completion {
+	private:
+		int ret;
+
+	public:
+		explicit done_completion(int ret);
+		int wait(void) override;
+	};
+
+	/* Per-object operations, they return a negative error code (-ENOENT for a missing object) */
+	virtual std::unique_ptr<obj_completion> aio_read_obj(const string &key, char *value, size_t len, off_t offset) = 0;
+	virtual std::unique_ptr<obj_completion> aio_write_obj(const string &key, const char *value, size_t len, off_t offset) = 0;
+	virtual int stat_obj(const string &key, uint64_t &size) = 0;
+	virtual int remove_obj(const string &key) = 0;
+	virtual int truncate_obj(const string &key, uint64_t size) = 0;
+	/* Zeroes a range of an existing object without creating it */
+	virtual int zero_obj(const string &key, off_t offset, size_t len) = 0;
+	virtual int omap_update_obj(const string &key, const std::map<string, string> &kvs, const std::set<string> &rm) = 0;
+	virtual int omap_get_obj(const string &key, const string &start_after, size_t max, std::map<string, string> &kvs, bool &more) = 0;
+
+private:
+	size_t max_inflight;
+
+	void stripe(aio_handle &handle, obj_category category, const string &key, char *value, size_t len, off_t offset);
+	void cut_obj(const string &key, uint64_t cut_size);
 };
 
 #endif /* _RADOS_IO_HPP_ */
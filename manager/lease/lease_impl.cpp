@@ -18,3 +18,35 @@ Status lease_impl::acquire(ServerContext *context, const lease_request *request,
 
 	return Status::OK;
 }
+
+Status lease_impl::renew(ServerContext *context, const renew_request *request, renew_response *response)
+{
+	system_clock::time_point due;
+	std::string leader_addr;
+
+	for (auto &ino : request->inos()) {
+		int ret = table.renew(uuid_controller::splice_prefix_and_postfix(ino.ino_prefix(), ino.ino_postfix()), due, request->remote_addr(), leader_addr);
+
+		response->add_ret(ret);
+		response->add_due(due.time_since_epoch().count());
+		response->add_remote_addr(leader_addr);
+	}
+
+	return Status::OK;
+}
+
+Status lease_impl::acquire_all(ServerContext *context, const acquire_all_request *request, acquire_all_response *response)
+{
+	system_clock::time_point due;
+
+	for (auto &ino : request->inos()) {
+		std::string remote_addr = request->remote_addr();
+		int ret = table.acquire(uuid_controller::splice_prefix_and_postfix(ino.ino_prefix(), ino.ino_postfix()), due, remote_addr);
+
+		response->add_ret(ret);
+		response->add_due(due.time_since_epoch().count());
+		response->add_remote_addr(ret ? remote_addr : "");
+	}
+
+	return Status::OK;
+}
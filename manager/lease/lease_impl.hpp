@@ -20,6 +20,8 @@ private:
 	lease_table table;
 
 	Status acquire(ServerContext *context, const lease_request *request, lease_response *response) override;
+	Status renew(ServerContext *context, const renew_request *request, renew_response *response) override;
+	Status acquire_all(ServerContext *context, const acquire_all_request *request, acquire_all_response *response) override;
 };
 
 #endif /* _LEASE_IMPL_HPP_ */
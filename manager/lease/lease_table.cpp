@@ -1,68 +1,100 @@
 #include "lease_table.hpp"
 
-lease_table::lease_entry::lease_entry(system_clock::time_point &latest_due, const std::string &remote_addr) : due(system_clock::now() + milliseconds(LEASE_PERIOD_MS)), addr(remote_addr)
+lease_table::lease_table(void) : stopping(false)
 {
-	latest_due = due;
+	sweeper = std::thread(&lease_table::sweep_loop, this);
 }
 
-std::tuple<system_clock::time_point, std::string> lease_table::lease_entry::get_info(void)
+lease_table::~lease_table(void)
+{
+	{
+		std::unique_lock lock(sweeper_m);
+		stopping = true;
+	}
+	sweeper_cv.notify_all();
+	if (sweeper.joinable())
+		sweeper.join();
+}
+
+lease_table::shard &lease_table::get_shard(const uuid &ino)
 {
-	std::shared_lock lock(sm);
-	return std::make_tuple(due, addr);
+	/* The inos are random, their last byte spreads them evenly without hashing them twice */
+	return shards[ino.data[uuid::static_size() - 1] & (LEASE_TABLE_SHARDS - 1)];
 }
 
-bool lease_table::lease_entry::cas(system_clock::time_point &latest_due, std::string &remote_addr)
+int lease_table::acquire(uuid ino, system_clock::time_point &latest_due, std::string &remote_addr)
 {
-	std::unique_lock lock(sm);
+	shard &s = get_shard(ino);
+	std::unique_lock lock(s.m);
 
-	if (system_clock::now() >= due) {
-		latest_due = due = system_clock::now() + milliseconds(LEASE_PERIOD_MS);
-		addr = remote_addr;
-		return true;
-	} else if (addr == remote_addr) {
-		latest_due = due;
-		return true;
+	system_clock::time_point now = system_clock::now();
+	auto it = s.map.find(ino);
+	if (it == s.map.end()) {
+		latest_due = now + milliseconds(LEASE_PERIOD_MS);
+		s.map.insert({ino, lease_entry{latest_due, remote_addr}});
+		return 0;
+	}
+
+	lease_entry &e = it.value();
+	if (now >= e.due) {
+		latest_due = e.due = now + milliseconds(LEASE_PERIOD_MS);
+		e.addr = remote_addr;
+		return 0;
+	} else if (e.addr == remote_addr) {
+		latest_due = e.due;
+		return 0;
 	} else {
-		latest_due = due;
-		remote_addr = addr;
-		return false;
+		latest_due = e.due;
+		remote_addr = e.addr;
+		return -1;
 	}
 }
 
-lease_table::~lease_table(void)
+int lease_table::renew(uuid ino, system_clock::time_point &latest_due, const std::string &remote_addr, std::string &leader_addr)
 {
-	std::cerr << "Some thread has called ~lease_table()." << std::endl;
-	std::cerr << "Aborted." << std::endl;
-	exit(1);
-}
+	shard &s = get_shard(ino);
+	std::unique_lock lock(s.m);
 
-int lease_table::acquire(uuid ino, system_clock::time_point &latest_due, std::string &remote_addr)
-{
-	lease_entry *e;
-	std::string addr;
-	bool found = false;
+	auto it = s.map.find(ino);
+	leader_addr.clear();
+	if (it == s.map.end()) {
+		latest_due = system_clock::time_point{};
+		return -1;
+	}
 
-	{
-		std::shared_lock lock(sm);
-		auto it = map.find(uuid_to_string(ino));
-		if (it != map.end()) {
-			found = true;
-			e = it->second;
-		}
+	/* An expired lease may already be taken by someone else, it has to be acquired again */
+	lease_entry &e = it.value();
+	system_clock::time_point now = system_clock::now();
+	if (now < e.due && e.addr == remote_addr) {
+		latest_due = e.due = now + milliseconds(LEASE_PERIOD_MS);
+		return 0;
+	} else {
+		latest_due = e.due;
+		if (now < e.due)
+			leader_addr = e.addr;
+		return -1;
 	}
+}
 
-	if (found)
-		return e->cas(latest_due, remote_addr) ? 0 : -1;
+void lease_table::sweep_loop(void)
+{
+	std::unique_lock lock(sweeper_m);
+	while (!stopping) {
+		sweeper_cv.wait_for(lock, milliseconds(LEASE_SWEEP_MS), [this] { return stopping; });
+		if (stopping)
+			break;
 
-	{
-		std::unique_lock lock(sm);
-		auto ret = map.insert({uuid_to_string(ino), nullptr});
-		if (ret.second) {
-			ret.first.value() = new lease_entry(latest_due, remote_addr);
-			return 0;
-		} else {
-			std::tie(latest_due, addr) = ret.first->second->get_info();
-			return (addr == remote_addr) ? 0 : -1;
+		/* An expired lease answers just as a missing one does, it can go at once */
+		for (auto &s : shards) {
+			std::unique_lock shard_lock(s.m);
+			system_clock::time_point now = system_clock::now();
+			for (auto it = s.map.begin(); it != s.map.end();) {
+				if (now >= it->second.due) {
+					it = s.map.erase(it);
+				} else {
+					it++;
+				}
+			}
 		}
 	}
 }
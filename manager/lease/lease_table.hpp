@@ -2,54 +2,53 @@
 #define _LEASE_TABLE_HPP_
 
 #include <chrono>
-#include <shared_mutex>
+#include <condition_variable>
+#include <mutex>
 #include <string>
-#include <tuple>
+#include <thread>
 #include <tsl/robin_map.h>
+#include <boost/functional/hash.hpp>
 #include <boost/uuid/uuid.hpp>
 #include <iostream>
-#include <string>
 #include "../../client/meta/uuid_controller.hpp"
 
 using namespace std::chrono;
 using namespace boost::uuids;
 
-#define LEASE_PERIOD_MS 200000000
+/* Clients renew the leases they use before they expire, see lease_client */
+#define LEASE_PERIOD_MS 10000
+
+/* The number of independently locked parts of the table, a power of 2 */
+#define LEASE_TABLE_SHARDS 64
+/* How often the expired leases are dropped */
+#define LEASE_SWEEP_MS LEASE_PERIOD_MS
 
 class lease_table {
 private:
-	class lease_entry {
-	private:
-		std::shared_mutex sm;
+	/* Kept in place in the buckets of a shard, the address of a client fits in a short string */
+	struct lease_entry {
 		system_clock::time_point due;
 		std::string addr;
+	};
 
-	public:
-		lease_entry(system_clock::time_point &latest_due, const std::string &remote_addr);
-		~lease_entry(void) = default;
+	/* A lease is in the shard picked by its ino, whose lock covers its entry */
+	struct alignas(64) shard {
+		std::mutex m;
+		tsl::robin_map<uuid, lease_entry, boost::hash<uuid>> map;
+	};
 
-		std::tuple<system_clock::time_point, std::string> get_info(void);
+	shard shards[LEASE_TABLE_SHARDS];
 
-		/*
-		 * cas() - Try to acquire the lease atomically
-		 *
-		 * On success
-		 * - Return true
-		 * - 'latest_due' is set to the updated due
-		 *
-		 * On failure
-		 * - Return false
-		 * - 'latest_due' is set to the current due
-		 * - 'remote_addr' is changed to the address of the current leader
-		 */
-		bool cas(system_clock::time_point &latest_due, std::string &remote_addr);
-	};
+	std::mutex sweeper_m;
+	std::condition_variable sweeper_cv;
+	bool stopping;
+	std::thread sweeper;
 
-	std::shared_mutex sm;
-	tsl::robin_map<std::string, lease_entry *> map;
+	shard &get_shard(const uuid &ino);
+	void sweep_loop(void);
 
 public:
-	lease_table(void) = default;
+	lease_table(void);
 	~lease_table(void);
 
 	/*
@@ -61,9 +60,24 @@ public:
 	 *
 	 * On failure
 	 * - Return -1
+	 * - 'latest_due' is set to the current due
 	 * - 'remote_addr' is changed to the address of the current leader
 	 */
 	int acquire(uuid ino, system_clock::time_point &latest_due, std::string &remote_addr);
+
+	/*
+	 * renew() - Extend the lease held by 'remote_addr'
+	 *
+	 * On success
+	 * - Return 0
+	 * - 'latest_due' is set to the extended due
+	 *
+	 * On failure (expired, or held by another client)
+	 * - Return -1
+	 * - 'latest_due' is set to the current due
+	 * - 'leader_addr' is set to the address of the current leader, "" if there is none
+	 */
+	int renew(uuid ino, system_clock::time_point &latest_due, const std::string &remote_addr, std::string &leader_addr);
 };
 
 #endif /* _LEASE_TABLE_HPP_ */
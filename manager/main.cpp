@@ -14,12 +14,13 @@ using std::string;
 int main(int argc, char *argv[])
 {
 	if (argc < 3) {
-		std::cerr << "Usage: " << argv[0] << " <manager_ip> <manager_port>" << std::endl;
+		std::cerr << "Usage: " << argv[0] << " <manager_ip> <manager_port> [backend]" << std::endl;
 		return 1;
 	}
 
 	rados_io::conn_info ci = {"client.admin", "ceph", 0};
-	auto meta_pool = std::make_shared<rados_io>(ci, META_POOL);
+	string backend(argc > 3 ? argv[3] : DEFAULT_BACKEND);
+	auto meta_pool = rados_io::create(backend, ci, META_POOL);
 
 	string server_address(string(argv[1]) + ":" + string(argv[2]));
 	lease_impl lease_service;
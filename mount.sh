@@ -4,7 +4,9 @@ MANAGER_IP="172.31.35.141"
 MANAGER_PORT="8900"
 REMOTE_HANDLE_IP="172.31.35.141"
 REMOTE_HANDLE_PORT="8888"
+# rados, memory or local:<directory>
+BACKEND="rados"
 
-IP_ARGS=$MANAGER_IP:$MANAGER_PORT,$REMOTE_HANDLE_IP:$REMOTE_HANDLE_PORT
+IP_ARGS=$MANAGER_IP:$MANAGER_PORT,$REMOTE_HANDLE_IP:$REMOTE_HANDLE_PORT,$BACKEND
 
 sudo ./build/client/nmfs -f -o allow_other ../mnt $IP_ARGS